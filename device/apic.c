@@ -0,0 +1,122 @@
+#include "apic.h"
+#include "memory.h"
+#include "timer.h"
+#include "print.h"
+#include "debug.h"
+#include "interrupt.h"
+#include "vdso.h"
+
+/* local apic 寄存器偏移 */
+#define LAPIC_ID        0x020   /* local apic id, [24-31] */
+#define LAPIC_TPR       0x080   /* task priority */
+#define LAPIC_EOI       0x0b0   /* end of interrupt */
+#define LAPIC_SVR       0x0f0   /* spurious interrupt vector */
+#define LAPIC_ICR_LOW   0x300   /* interrupt command, [0-31] */
+#define LAPIC_ICR_HIGH  0x310   /* interrupt command, [32-63] : 目标 apic id [24-31] */
+#define LAPIC_LVT_TIMER 0x320   /* local vector table : timer */
+#define LAPIC_LVT_LINT0 0x350   /* local vector table : LINT0 */
+#define LAPIC_LVT_LINT1 0x360   /* local vector table : LINT1 */
+#define LAPIC_TIMER_ICR 0x380   /* timer initial count */
+#define LAPIC_TIMER_CCR 0x390   /* timer current count */
+#define LAPIC_TIMER_DCR 0x3e0   /* timer divide configuration */
+
+#define LAPIC_SVR_ENABLE    0x100       /* apic software enable */
+#define LAPIC_LVT_MASKED    0x10000     /* 屏蔽该中断 */
+#define LAPIC_TIMER_PERIODIC 0x20000    /* 周期模式 */
+#define LAPIC_TIMER_DIV_16  0x3
+#define LAPIC_ICR_INIT      0x4500      /* INIT, level assert */
+#define LAPIC_ICR_STARTUP   0x4600      /* STARTUP, level assert, [0-7] 为入口页号 */
+#define LAPIC_ICR_PENDING   0x1000      /* delivery status : 发送中 */
+
+/* local apic 时钟周期，与 PIT 相同为 100Hz */
+#define LAPIC_TIMER_PERIOD_US 10000
+
+uint32_t lapic_phy_addr = 0xfee00000;
+static volatile uint8_t* lapic_base = NULL;
+static uint32_t lapic_timer_count; /* 每个时钟中断周期 local apic 时钟的计数值 */
+
+static uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+static void lapic_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t*)(lapic_base + reg) = val;
+    lapic_read(LAPIC_ID); /* 读一次，等待写入完成 */
+}
+
+/* 映射并启用当前处理器的 local apic */
+void lapic_init(bool is_bsp) {
+    if(lapic_base == NULL) {
+        /* 所有处理器的 local apic 位于同一物理地址，只需 BSP 映射一次 */
+        lapic_base = mmio_map(lapic_phy_addr, 1);
+        ASSERT(lapic_base != NULL);
+    }
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0); /* 接收所有中断 */
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    if(!is_bsp) {
+        /* 8259A 只连接 BSP 的 LINT0，AP 屏蔽 LINT0、LINT1 */
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+        lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    }
+    lapic_eoi();
+}
+
+/* 当前处理器的 local apic id */
+uint8_t lapic_id(void) {
+    return (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+}
+
+/* 中断处理结束，向 local apic 发送 EOI */
+void lapic_eoi(void) {
+    *(volatile uint32_t*)(lapic_base + LAPIC_EOI) = 0;
+}
+
+/* 以 PIT 为参照测出 local apic 时钟每个时钟中断周期的计数值 */
+void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DCR, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED); /* 单次模式，不产生中断 */
+    lapic_write(LAPIC_TIMER_ICR, 0xffffffff);
+    timer_udelay(LAPIC_TIMER_PERIOD_US);
+    lapic_timer_count = 0xffffffff - lapic_read(LAPIC_TIMER_CCR);
+    lapic_write(LAPIC_TIMER_ICR, 0);
+    vdso_data->lapic_timer_count = lapic_timer_count;
+    put_str("   lapic timer count per tick: 0x");
+    put_int(lapic_timer_count);
+    put_char('\n');
+}
+
+/* 启动当前处理器的 local apic 周期时钟，频率与 PIT 相同 */
+void lapic_timer_start(void) {
+    ASSERT(lapic_timer_count != 0);
+    lapic_write(LAPIC_TIMER_DCR, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_ICR, lapic_timer_count);
+}
+
+/* 写 ICR 发送 IPI，并等待发送完成 */
+static void lapic_icr_write(uint8_t apic_id, uint32_t icr_low) {
+    /* 高低两半须连续写入，期间不能被本处理器的中断打断 */
+    enum intr_status old_stat = intr_disable();
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, icr_low);
+    while(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING);
+    intr_status_set(old_stat);
+}
+
+/* 向 apic_id 发送向量号为 vec_no 的 IPI */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec_no) {
+    lapic_icr_write(apic_id, vec_no); /* fixed, physical, edge */
+}
+
+/* 依次发送 INIT、SIPI、SIPI 启动 apic_id 对应的 AP，从物理地址 entry 处执行 */
+void lapic_startup_ap(uint8_t apic_id, uint32_t entry) {
+    ASSERT((entry & 0xfff00fff) == 0); /* 入口须 4K 对齐且位于 1MB 以内 */
+    lapic_icr_write(apic_id, LAPIC_ICR_INIT);
+    timer_udelay(10000);
+    /* Intel MP 规范要求发送两次 SIPI */
+    lapic_icr_write(apic_id, LAPIC_ICR_STARTUP | (entry >> 12));
+    timer_udelay(200);
+    lapic_icr_write(apic_id, LAPIC_ICR_STARTUP | (entry >> 12));
+    timer_udelay(200);
+}
@@ -0,0 +1,36 @@
+#ifndef __DEVICE_APIC_H
+#define __DEVICE_APIC_H
+
+#include "global.h"
+
+/* local apic 中断向量，紧跟在 8259A 的 0x20~0x2f 之后 */
+#define LAPIC_TIMER_VECTOR      0x30    /* AP 的本地时钟 */
+#define LAPIC_RESCHED_VECTOR    0x31    /* 重新调度 IPI */
+#define LAPIC_TLB_VECTOR        0x32    /* 刷新 TLB IPI */
+#define LAPIC_SPURIOUS_VECTOR   0x3f    /* 伪中断，不需要 EOI */
+
+/* local apic 的物理地址，由 MP 表给出 */
+extern uint32_t lapic_phy_addr;
+
+/* 映射并启用当前处理器的 local apic */
+void lapic_init(bool is_bsp);
+
+/* 当前处理器的 local apic id */
+uint8_t lapic_id(void);
+
+/* 中断处理结束，向 local apic 发送 EOI */
+void lapic_eoi(void);
+
+/* 以 PIT 为参照测出 local apic 时钟每个时钟中断周期的计数值 */
+void lapic_timer_calibrate(void);
+
+/* 启动当前处理器的 local apic 周期时钟，频率与 PIT 相同 */
+void lapic_timer_start(void);
+
+/* 向 apic_id 发送向量号为 vec_no 的 IPI */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec_no);
+
+/* 依次发送 INIT、SIPI、SIPI 启动 apic_id 对应的 AP，从物理地址 entry 处执行 */
+void lapic_startup_ap(uint8_t apic_id, uint32_t entry);
+
+#endif /* __DEVICE_APIC_H */
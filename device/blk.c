@@ -0,0 +1,180 @@
+#include "blk.h"
+#include "ide.h"
+#include "memory.h"
+#include "debug.h"
+
+/* 初始化请求队列 */
+void blk_queue_init(struct blk_queue* q) {
+    list_init(&q->reqs);
+    q->head_pos = 0;
+    q->next_seq = 0;
+}
+
+/* 初始化读写 hd 从 lba 起 sec_cnt 个扇区的请求，须在 buf 所属的地址空间中调用
+ * buf 不按 2 字节对齐时请求只能用 PIO 执行，派发时 DMA 会退回 PIO */
+void blk_request_init(struct blk_request* req, struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt, bool is_write) {
+    ASSERT(sec_cnt > 0 && sec_cnt <= BLK_MAX_SECS);
+    req->hd = hd;
+    req->lba = lba;
+    req->sec_cnt = sec_cnt;
+    req->is_write = is_write;
+    req->error = false;
+    req->end_io = NULL;
+    req->private = NULL;
+    req->merged_next = NULL;
+    req->merged_tail = req;
+    req->cmd_sec_cnt = sec_cnt;
+    sem_init(&req->done, 0);
+
+    /* 按页拆分缓冲区 */
+    uint32_t vaddr = (uint32_t)buf;
+    uint32_t bytes = sec_cnt * 512;
+    req->seg_cnt = 0;
+    while(bytes > 0) {
+        uint32_t len = PG_SIZE - (vaddr & 0xfff);
+        if(len > bytes) {
+            len = bytes;
+        }
+        ASSERT(req->seg_cnt < BLK_SEG_MAX);
+        req->segs[req->seg_cnt].phy_addr = addr_v2p(vaddr);
+        req->segs[req->seg_cnt].len = len;
+        req->seg_cnt++;
+        vaddr += len;
+        bytes -= len;
+    }
+}
+
+/* 指令 a 与 b 的扇区重叠且其中有写，两者必须按提交顺序执行 */
+static bool blk_conflict(const struct blk_request* a, const struct blk_request* b) {
+    if(!a->is_write && !b->is_write) {
+        return false;
+    }
+    return a->lba < b->lba + b->cmd_sec_cnt && b->lba < a->lba + a->cmd_sec_cnt;
+}
+
+/* 尝试将 req 合并到队列中方向相同、lba 相接的指令上，成功返回 true
+ * 与队列中任一指令冲突的请求不合并：合并后会随更早提交的指令一起派发，越过与之冲突的指令 */
+static bool blk_merge(struct blk_queue* q, struct blk_request* req) {
+    struct list_elem* elem = q->reqs.head.next;
+    for(; elem != &q->reqs.tail; elem = elem->next) {
+        if(blk_conflict(elem2entry(struct blk_request, queue_tag, elem), req)) {
+            return false;
+        }
+    }
+    elem = q->reqs.head.next;
+    for(; elem != &q->reqs.tail; elem = elem->next) {
+        struct blk_request* cmd = elem2entry(struct blk_request, queue_tag, elem);
+        if(cmd->is_write != req->is_write || cmd->cmd_sec_cnt + req->sec_cnt > BLK_MAX_SECS) {
+            continue;
+        }
+        if(cmd->lba + cmd->cmd_sec_cnt == req->lba) {
+            /* 接在指令末尾 */
+            cmd->merged_tail->merged_next = req;
+            cmd->merged_tail = req;
+            cmd->cmd_sec_cnt += req->sec_cnt;
+            return true;
+        }
+        if(req->lba + req->sec_cnt == cmd->lba) {
+            /* 接在指令开头：req 成为首个请求，替换 cmd 在队列中的位置 */
+            req->merged_next = cmd;
+            req->merged_tail = cmd->merged_tail;
+            req->cmd_sec_cnt = req->sec_cnt + cmd->cmd_sec_cnt;
+            req->seq = cmd->seq;
+            list_insert_before(&cmd->queue_tag, &req->queue_tag);
+            list_remove(&cmd->queue_tag);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 按 lba 升序插入队列 */
+static void blk_insert(struct blk_queue* q, struct blk_request* req) {
+    struct list_elem* elem = q->reqs.head.next;
+    for(; elem != &q->reqs.tail; elem = elem->next) {
+        if(elem2entry(struct blk_request, queue_tag, elem)->lba > req->lba) {
+            break;
+        }
+    }
+    list_insert_before(elem, &req->queue_tag);
+}
+
+/* 将请求加入所属硬盘的队列，能与队列中 lba 相接的请求合并则合并，并唤醒派发线程 */
+void blk_submit(struct blk_request* req) {
+    struct ide_channel* channel = req->hd->my_channel;
+    enum intr_status old_stat = spin_lock_intr(&channel->blk_spin);
+    req->seq = req->hd->queue.next_seq++;
+    if(!blk_merge(&req->hd->queue, req)) {
+        blk_insert(&req->hd->queue, req);
+    }
+    if(channel->dispatcher_sleeping) {
+        channel->dispatcher_sleeping = false;
+        thread_unblock(channel->dispatcher);
+    }
+    spin_unlock_intr(&channel->blk_spin, old_stat);
+}
+
+/* 异步提交：初始化并提交请求后立即返回，完成时先调用 end_io(req) 再唤醒 bio_wait 的等待者
+ * 可连续提交多个请求再逐个等待，req 及 buf 在完成前须保持有效 */
+void bio_submit(struct blk_request* req, struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt, bool is_write, bio_end_io* end_io, void* private) {
+    blk_request_init(req, hd, lba, buf, sec_cnt, is_write);
+    req->end_io = end_io;
+    req->private = private;
+    blk_submit(req);
+}
+
+/* 等待 bio_submit 提交的请求完成，返回是否成功 */
+bool bio_wait(struct blk_request* req) {
+    sem_wait(&req->done);
+    return !req->error;
+}
+
+/* 派发线程调用：按 C-SCAN 从队列中取出下一条指令（合并链的首个请求），队列为空返回 NULL。调用者持有 blk_spin */
+struct blk_request* blk_fetch(struct blk_queue* q) {
+    if(list_empty(&q->reqs)) {
+        return NULL;
+    }
+    /* 取磁头之后的第一条，磁头之后没有则回到 lba 最小处重新扫描 */
+    struct blk_request* cmd = NULL;
+    struct list_elem* elem = q->reqs.head.next;
+    for(; elem != &q->reqs.tail; elem = elem->next) {
+        struct blk_request* req = elem2entry(struct blk_request, queue_tag, elem);
+        if(req->lba >= q->head_pos) {
+            cmd = req;
+            break;
+        }
+    }
+    if(cmd == NULL) {
+        cmd = elem2entry(struct blk_request, queue_tag, q->reqs.head.next);
+    }
+    /* 与之冲突且更早提交的指令先派发，序号递减，循环必然结束 */
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(elem = q->reqs.head.next; elem != &q->reqs.tail; elem = elem->next) {
+            struct blk_request* req = elem2entry(struct blk_request, queue_tag, elem);
+            if(req != cmd && (int32_t)(req->seq - cmd->seq) < 0 && blk_conflict(req, cmd)) {
+                cmd = req;
+                changed = true;
+                break;
+            }
+        }
+    }
+    list_remove(&cmd->queue_tag);
+    q->head_pos = cmd->lba + cmd->cmd_sec_cnt;
+    return cmd;
+}
+
+/* 派发线程调用：指令 cmd 执行完毕，依次完成合并在其中的所有请求 */
+void blk_complete(struct blk_request* cmd, bool error) {
+    while(cmd != NULL) {
+        /* 唤醒后请求可能立即被提交者释放，先取出下一个 */
+        struct blk_request* next = cmd->merged_next;
+        cmd->error = error;
+        if(cmd->end_io != NULL) {
+            cmd->end_io(cmd);
+        }
+        sem_post(&cmd->done);
+        cmd = next;
+    }
+}
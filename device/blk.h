@@ -0,0 +1,76 @@
+#ifndef __DEVICE_BLK_H
+#define __DEVICE_BLK_H
+
+#include "global.h"
+#include "list.h"
+#include "sync.h"
+
+#define BLK_MAX_SECS    256 /* 一条读写指令最多操作的扇区数 */
+#define BLK_SEG_MAX     (BLK_MAX_SECS * 512 / PG_SIZE + 1) /* 256 个扇区的缓冲区最多跨越的页数 */
+
+struct disk;
+struct blk_request;
+
+/* 请求完成时在派发线程中调用，不持有大内核锁，不得阻塞，也不得释放请求本身 */
+typedef void bio_end_io(struct blk_request* req);
+
+/* 缓冲区中的一段物理内存，不跨页 */
+struct blk_seg {
+    uint32_t phy_addr;
+    uint32_t len;
+};
+
+/* 块设备请求：对一块硬盘连续扇区的一次读或写
+ * 提交时即将缓冲区换算成物理地址，派发线程不依赖提交者的地址空间 */
+struct blk_request {
+    struct disk* hd;
+    uint32_t lba;
+    uint32_t sec_cnt; /* 不超过 BLK_MAX_SECS */
+    bool is_write;
+    bool error; /* 完成后有效 */
+    bio_end_io* end_io; /* 完成回调，可为 NULL */
+    void* private; /* 供 end_io 使用 */
+    uint8_t seg_cnt;
+    struct blk_seg segs[BLK_SEG_MAX];
+
+    /* 以下由请求队列使用 */
+    struct list_elem queue_tag; /* 只有合并后的首个请求在队列中 */
+    struct blk_request* merged_next; /* 合并在本请求之后且 lba 紧接的请求 */
+    struct blk_request* merged_tail; /* 首个请求：合并链的最后一个请求 */
+    uint32_t cmd_sec_cnt; /* 首个请求：合并后整条指令的扇区数 */
+    uint32_t seq; /* 首个请求：合并链中最早提交的请求的提交序号 */
+    sem_t done; /* 完成后唤醒提交者 */
+};
+
+/* 每块硬盘的请求队列，按 lba 升序排列，由所在通道的 blk_spin 保护
+ * 扇区重叠且其中有写的指令按提交顺序派发 */
+struct blk_queue {
+    struct list reqs;
+    uint32_t head_pos; /* 上一条指令结束处的 lba，C-SCAN 只向 lba 增大的方向扫描 */
+    uint32_t next_seq; /* 下一个请求的提交序号 */
+};
+
+/* 初始化请求队列 */
+void blk_queue_init(struct blk_queue* q);
+
+/* 初始化读写 hd 从 lba 起 sec_cnt 个扇区的请求，须在 buf 所属的地址空间中调用
+ * buf 不按 2 字节对齐时请求只能用 PIO 执行 */
+void blk_request_init(struct blk_request* req, struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt, bool is_write);
+
+/* 将请求加入所属硬盘的队列，能与队列中 lba 相接且不与其他指令冲突的请求合并则合并，并唤醒派发线程 */
+void blk_submit(struct blk_request* req);
+
+/* 异步提交：初始化并提交请求后立即返回，完成时先调用 end_io(req) 再唤醒 bio_wait 的等待者
+ * 可连续提交多个请求再逐个等待，req 及 buf 在完成前须保持有效 */
+void bio_submit(struct blk_request* req, struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt, bool is_write, bio_end_io* end_io, void* private);
+
+/* 等待 bio_submit 提交的请求完成，返回是否成功 */
+bool bio_wait(struct blk_request* req);
+
+/* 派发线程调用：按 C-SCAN 从队列中取出下一条指令（合并链的首个请求），先提交的冲突指令优先，队列为空返回 NULL。调用者持有 blk_spin */
+struct blk_request* blk_fetch(struct blk_queue* q);
+
+/* 派发线程调用：指令 cmd 执行完毕，依次完成合并在其中的所有请求 */
+void blk_complete(struct blk_request* cmd, bool error);
+
+#endif /* __DEVICE_BLK_H */
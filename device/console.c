@@ -5,7 +5,7 @@ static locker_t console_locker;
 
 /* init console */
 void console_init(void) {
-    locker_init(&console_locker);
+    locker_init(&console_locker, "console");
 }
 
 /* get console */
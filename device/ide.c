@@ -4,6 +4,8 @@
 #include "io.h"
 #include "timer.h"
 #include "interrupt.h"
+#include "memory.h"
+#include "pci.h"
 
 /* 硬盘数量 */
 #define HD_CNT (*((uint8_t*)(0x475)))
@@ -24,7 +26,7 @@
 #define reg_ctl(channel)        (reg_alt_status(channel))
 
 #define BIT_STAT_BSY            0x80    /* 硬盘忙 */
-#define BIT_STAT_DRQ            0x40    /* 驱动器准备好 */
+#define BIT_STAT_DRQ            0x8     /* 数据传输准备好了 */
 
 /* reg_alt_status 寄存器的一些关键位 */
 #define BIT_ALT_STAT_BSY        0x80    /* 硬盘忙 */
@@ -36,10 +38,42 @@
 #define BIT_DEV_LBA             0x40
 #define BIT_DEV_DEV             0x10
 
+#define BIT_STAT_ERR            0x01    /* 上一条指令出错 */
+
 /* 一些硬盘操作的指令 */
 #define CMD_IDENTIFY            0xec    /* identify指令 */
 #define CMD_READ_SECTOR         0x20    /* 读扇区指令 */
 #define CMD_WRITE_SECTOR        0x30    /* 写扇区指令 */
+#define CMD_READ_DMA            0xc8    /* DMA 读扇区指令 */
+#define CMD_WRITE_DMA           0xca    /* DMA 写扇区指令 */
+#define CMD_READ_MULTIPLE       0xc4    /* 读扇区指令，每个数据块一次中断 */
+#define CMD_WRITE_MULTIPLE      0xc5    /* 写扇区指令，每个数据块一次中断 */
+#define CMD_SET_MULTIPLE        0xc6    /* 设置 READ/WRITE MULTIPLE 每块的扇区数 */
+/* 48 位 lba 的对应指令 */
+#define CMD_READ_SECTOR_EXT     0x24
+#define CMD_WRITE_SECTOR_EXT    0x34
+#define CMD_READ_DMA_EXT        0x25
+#define CMD_WRITE_DMA_EXT       0x35
+#define CMD_READ_MULTIPLE_EXT   0x29
+#define CMD_WRITE_MULTIPLE_EXT  0x39
+
+#define LBA28_SEC_CNT           0x10000000  /* 28 位 lba 可访问的扇区数 */
+
+/* bus master IDE 寄存器，每个通道 8 个端口，ide1 的位于 ide0 之后 */
+#define reg_bm_cmd(channel)     (channel->bmide_base + 0)
+#define reg_bm_status(channel)  (channel->bmide_base + 2)
+#define reg_bm_prdt(channel)    (channel->bmide_base + 4)
+
+#define BIT_BM_CMD_START        0x01    /* 开始传输，清零则停止 */
+#define BIT_BM_CMD_READ         0x08    /* 方向：硬盘写入内存 */
+#define BIT_BM_STAT_ERR         0x02    /* 传输出错，写 1 清除 */
+#define BIT_BM_STAT_INTR        0x04    /* 硬盘已发出中断，写 1 清除 */
+
+#define PRD_EOT                 0x8000  /* 最后一个 prd */
+#define PRD_MAX_CNT             (PG_SIZE / sizeof(struct prd))
+
+#define ID_CAP_DMA              0x100   /* identify 第 49 字：支持 DMA */
+#define ID_CMD_LBA48            0x400   /* identify 第 83 字：支持 48 位 lba */
 
 uint8_t channel_cnt; /* 按硬盘数计算的通道数 */
 struct ide_channel channels[2]; /* 有两个ide通道 */
@@ -54,6 +88,13 @@ uint8_t logic_no = 0;
 /* 分区队列 */
 struct list partition_list; 
 
+/* 同步读写的请求池：请求有三百多字节，不放在与 PCB 共用一页的内核栈上 */
+#define SYNC_REQ_CNT            8
+static struct blk_request sync_reqs[SYNC_REQ_CNT];
+static bool sync_req_used[SYNC_REQ_CNT];
+static sem_t sync_req_free; /* 空闲请求数 */
+static spinlock_t sync_req_spin;
+
 /* 分区表项 */
 struct partition_table_entry {
     uint8_t bootable; /* 是否可引导 */
@@ -86,12 +127,30 @@ static void select_disk(struct disk* hd) {
     outb(reg_dev(hd->my_channel), dev_operand);
 }
 
-/* 向硬盘监控器写入起始扇区地址及读取的扇区数 */
-static void select_sector(struct disk* hd, uint32_t lba, uint8_t sec_cnt) {
-    // ASSERT(lba <= MAX_LBA_CNT);
+/* 指令 cmd 访问的扇区超出 28 位 lba，需使用 EXT 指令 */
+static bool cmd_ext(struct blk_request* cmd) {
+    return cmd->lba + cmd->cmd_sec_cnt > LBA28_SEC_CNT;
+}
+
+/* 向硬盘监控器写入起始扇区地址及读取的扇区数，ext 为 true 时按 48 位 lba 写入 */
+static void select_sector(struct disk* hd, uint32_t lba, uint16_t sec_cnt, bool ext) {
     struct ide_channel* channel = hd->my_channel;
 
-    /*  1. 写入需要读取的扇区数；
+    if(ext) {
+        /* 每个寄存器先写高 8 位再写低 8 位：扇区数 16 位（0 表示 65536），lba 47-32 位为 0 */
+        outb(reg_sect_cnt(channel), sec_cnt >> 8);
+        outb(reg_lba_l(channel), lba >> 24);
+        outb(reg_lba_m(channel), 0);
+        outb(reg_lba_h(channel), 0);
+        outb(reg_sect_cnt(channel), sec_cnt);
+        outb(reg_lba_l(channel), lba);
+        outb(reg_lba_m(channel), lba >> 8);
+        outb(reg_lba_h(channel), lba >> 16);
+        outb(reg_dev(channel), BIT_DEV_MBS | BIT_DEV_LBA | (hd->dev_no == 1 ? BIT_DEV_DEV : 0x00));
+        return;
+    }
+
+    /*  1. 写入需要读取的扇区数（0 表示 256）；
         2. 写入 lba 地址，即扇区号：
             2.1 先写入低 8 位；
             2.1 写入 8-15 位；
@@ -125,7 +184,7 @@ static bool busy_wait(struct disk* hd) {
             /* busy */
             mtime_sleep(10); 
         } else {
-            return ((inb(reg_status(channel) & BIT_STAT_DRQ)));
+            return inb(reg_status(channel)) & BIT_STAT_DRQ;
         }
     }
     return false;
@@ -139,11 +198,191 @@ static void read_sectors(struct disk* hd, void* buf, uint8_t sec_cnt) {
     insw(reg_data(hd->my_channel), buf, size_in_bytes / 2);
 }
 
-/* 将 buf 中的数据写入到 hd 的 sec_cnt 个扇区 */
-static void write_sectors(struct disk* hd, void* buf, uint8_t sec_cnt) {
-    uint32_t size_in_bytes;
-    size_in_bytes = sec_cnt == 0 ? 256 * 512 : sec_cnt * 512;
-    outsw(reg_data(hd->my_channel), buf, size_in_bytes / 2);
+/* 按指令 cmd 中各请求缓冲区的物理段填写通道的 prd 表，段数超出 prd 表时返回 false */
+static bool dma_prdt_build(struct ide_channel* channel, struct blk_request* cmd) {
+    uint32_t prd_idx = 0;
+    struct blk_request* req;
+    for(req = cmd; req != NULL; req = req->merged_next) {
+        uint8_t seg_idx;
+        for(seg_idx = 0; seg_idx < req->seg_cnt; seg_idx++) {
+            /* 每段不跨页，不会跨越 64KB 边界 */
+            struct blk_seg* seg = &req->segs[seg_idx];
+            if((seg->phy_addr | seg->len) & 0x1) {
+                /* DMA 要求 2 字节对齐，不对齐的缓冲区本条指令改用 PIO */
+                return false;
+            }
+            struct prd* prev = prd_idx > 0 ? &channel->prdt[prd_idx - 1] : NULL;
+            if(prev != NULL && prev->phy_addr + prev->byte_cnt == seg->phy_addr && (seg->phy_addr & 0xffff) != 0) {
+                /* 与上一项物理连续且在同一 64KB 内，合并 */
+                prev->byte_cnt += seg->len;
+                continue;
+            }
+            if(prd_idx == PRD_MAX_CNT) {
+                return false;
+            }
+            channel->prdt[prd_idx].phy_addr = seg->phy_addr;
+            channel->prdt[prd_idx].byte_cnt = seg->len;
+            channel->prdt[prd_idx].flags = 0;
+            prd_idx++;
+        }
+    }
+    channel->prdt[prd_idx - 1].flags = PRD_EOT;
+    return true;
+}
+
+/* 用 DMA 执行指令 cmd，传输期间阻塞在 disk_done 上，失败返回 false */
+static bool dma_transfer(struct disk* hd, struct blk_request* cmd) {
+    struct ide_channel* channel = hd->my_channel;
+    if(!hd->dma || !dma_prdt_build(channel, cmd)) {
+        return false;
+    }
+    uint8_t dir = cmd->is_write ? 0 : BIT_BM_CMD_READ;
+    outb(reg_bm_cmd(channel), 0);
+    outl(reg_bm_prdt(channel), channel->prdt_phy);
+    outb(reg_bm_status(channel), BIT_BM_STAT_ERR | BIT_BM_STAT_INTR);
+    outb(reg_bm_cmd(channel), dir);
+
+    bool ext = cmd_ext(cmd);
+    select_sector(hd, cmd->lba, cmd->cmd_sec_cnt, ext);
+    if(ext) {
+        out_cmd(channel, cmd->is_write ? CMD_WRITE_DMA_EXT : CMD_READ_DMA_EXT);
+    } else {
+        out_cmd(channel, cmd->is_write ? CMD_WRITE_DMA : CMD_READ_DMA);
+    }
+    outb(reg_bm_cmd(channel), dir | BIT_BM_CMD_START);
+    /* 数据由控制器直接搬运，处理器在此期间运行其他任务 */
+    sem_wait(&channel->disk_done);
+
+    uint8_t bm_status = inb(reg_bm_status(channel));
+    outb(reg_bm_cmd(channel), 0);
+    outb(reg_bm_status(channel), BIT_BM_STAT_ERR | BIT_BM_STAT_INTR);
+    if((bm_status & BIT_BM_STAT_ERR) || (inb(reg_status(channel)) & (BIT_STAT_ERR | BIT_STAT_BSY))) {
+        /* 此后该硬盘只用 PIO */
+        printk("%s dma failed at lba %d, fall back to pio\n", hd->name, cmd->lba);
+        hd->dma = false;
+        return false;
+    }
+    return true;
+}
+
+/* 在指令 cmd 的数据中从第 skip 字节起的 bytes 字节与数据端口之间按段传输
+ * 缓冲区页框逐段换入通道的映射窗口，关中断期间只刷新本处理器的快表，不需要通知其他处理器
+ * 缓冲区不按 2 字节对齐时段长可能为奇数，跨段的字拆成两个字节，half_word 暂存上一段末尾的字节 */
+static void pio_segs_transfer(struct disk* hd, struct blk_request* cmd, uint32_t skip, uint32_t bytes) {
+    uint16_t port = reg_data(hd->my_channel);
+    void* window = hd->my_channel->pio_window;
+    bool half_pending = false;
+    uint16_t half_word = 0;
+    struct blk_request* req;
+    for(req = cmd; req != NULL && bytes > 0; req = req->merged_next) {
+        uint8_t seg_idx;
+        for(seg_idx = 0; seg_idx < req->seg_cnt && bytes > 0; seg_idx++) {
+            struct blk_seg* seg = &req->segs[seg_idx];
+            if(skip >= seg->len) {
+                skip -= seg->len;
+                continue;
+            }
+            uint32_t len = seg->len - skip < bytes ? seg->len - skip : bytes;
+            bytes -= len;
+            enum intr_status old_stat = intr_disable();
+            kmap_local(window, seg->phy_addr & 0xfffff000);
+            /* 段不跨页，skip 后仍在同一页中 */
+            uint8_t* addr = (uint8_t*)((uint32_t)window + (seg->phy_addr & 0xfff) + skip);
+            skip = 0;
+            if(half_pending && len > 0) {
+                /* 补齐上一段留下的半个字 */
+                if(cmd->is_write) {
+                    outw(port, half_word | (*addr << 8));
+                } else {
+                    *addr = half_word >> 8;
+                }
+                half_pending = false;
+                addr++;
+                len--;
+            }
+            if(cmd->is_write) {
+                outsw(port, addr, len / 2);
+            } else {
+                insw(port, addr, len / 2);
+            }
+            if(len & 1) {
+                addr += len - 1;
+                if(cmd->is_write) {
+                    half_word = *addr;
+                } else {
+                    half_word = inw(port);
+                    *addr = half_word & 0xff;
+                }
+                half_pending = true;
+            }
+            intr_status_set(old_stat);
+        }
+    }
+}
+
+/* 用 PIO 执行指令 cmd，失败返回 false
+ * 数据按块传输，每块 multiple 个扇区（不支持 READ/WRITE MULTIPLE 时为 1 个），每块一次中断 */
+static bool pio_transfer(struct disk* hd, struct blk_request* cmd) {
+    struct ide_channel* channel = hd->my_channel;
+    bool ext = cmd_ext(cmd);
+    uint8_t op;
+    if(hd->multiple != 0) {
+        op = cmd->is_write ? (ext ? CMD_WRITE_MULTIPLE_EXT : CMD_WRITE_MULTIPLE) : (ext ? CMD_READ_MULTIPLE_EXT : CMD_READ_MULTIPLE);
+    } else {
+        op = cmd->is_write ? (ext ? CMD_WRITE_SECTOR_EXT : CMD_WRITE_SECTOR) : (ext ? CMD_READ_SECTOR_EXT : CMD_READ_SECTOR);
+    }
+    uint32_t blk_secs = hd->multiple != 0 ? hd->multiple : 1;
+    select_sector(hd, cmd->lba, cmd->cmd_sec_cnt, ext);
+    out_cmd(channel, op);
+
+    uint32_t secs_done = 0;
+    while(secs_done < cmd->cmd_sec_cnt) {
+        uint32_t secs = cmd->cmd_sec_cnt - secs_done < blk_secs ? cmd->cmd_sec_cnt - secs_done : blk_secs;
+        if(cmd->is_write) {
+            /* 写：硬盘请求数据后写入一块，该块写入磁盘后中断 */
+            if(!busy_wait(hd)) {
+                channel->expecting_intr = false;
+                return false;
+            }
+            channel->expecting_intr = true;
+            pio_segs_transfer(hd, cmd, secs_done * 512, secs * 512);
+            sem_wait(&channel->disk_done);
+        } else {
+            /* 读：每块数据准备好后中断，读走最后一块前不会再有中断 */
+            sem_wait(&channel->disk_done);
+            if(!busy_wait(hd)) {
+                return false;
+            }
+            channel->expecting_intr = secs_done + secs < cmd->cmd_sec_cnt;
+            pio_segs_transfer(hd, cmd, secs_done * 512, secs * 512);
+        }
+        secs_done += secs;
+    }
+    return !(inb(reg_status(channel)) & BIT_STAT_ERR);
+}
+
+/* 通道的派发线程：轮流从两块硬盘的请求队列中取出指令执行，指令完成由硬盘中断唤醒，队列都为空则阻塞 */
+static void ide_dispatch(void* arg) {
+    struct ide_channel* channel = arg;
+    uint8_t dev_no = 0;
+    while(1) {
+        enum intr_status old_stat = spin_lock_intr(&channel->blk_spin);
+        struct blk_request* cmd;
+        while((cmd = blk_fetch(&channel->devices[dev_no].queue)) == NULL \
+            && (cmd = blk_fetch(&channel->devices[dev_no ^ 1].queue)) == NULL) {
+            channel->dispatcher_sleeping = true;
+            thread_block_release(TASK_BLOCKED, &channel->blk_spin);
+            spin_lock(&channel->blk_spin);
+        }
+        spin_unlock_intr(&channel->blk_spin, old_stat);
+
+        struct disk* hd = cmd->hd;
+        dev_no = hd->dev_no ^ 1; /* 下次先看另一块硬盘 */
+        select_disk(hd);
+        /* 超出硬盘容量的指令直接失败 */
+        bool ok = cmd->lba + cmd->cmd_sec_cnt <= hd->sectors && (dma_transfer(hd, cmd) || pio_transfer(hd, cmd));
+        blk_complete(cmd, !ok);
+    }
 }
 
 /* 将 src 中 len 个相邻字节（0和1，2和3...）交换位置后存入 dest */
@@ -186,9 +425,31 @@ static void identify_disk(struct disk* hd) {
     swap_pairs_bytes(&id_info[md_start], buf, md_len);
     printk("    MODULE : %s\n ", buf);
     
-    uint32_t sectors = *(uint32_t*)&id_info [60 * 2] ;
-    printk("    SECTORS : %d\n", sectors);
-    printk("    CAPACITY : %dMB\n", sectors* 512 / 1024 / 1024);
+    hd->dma = hd->my_channel->bmide_base != 0 && (*(uint16_t*)&id_info[49 * 2] & ID_CAP_DMA);
+    printk("    DMA : %s\n", hd->dma ? "yes" : "no");
+
+    /* 第 60、61 字为 28 位 lba 的扇区数；支持 48 位 lba 时第 100-103 字为扇区数，只取低 32 位（2TB） */
+    hd->lba48 = *(uint16_t*)&id_info[83 * 2] & ID_CMD_LBA48;
+    hd->sectors = *(uint32_t*)&id_info[60 * 2];
+    if(hd->lba48) {
+        hd->sectors = *(uint32_t*)&id_info[102 * 2] != 0 ? 0xffffffff : *(uint32_t*)&id_info[100 * 2];
+    }
+    printk("    SECTORS : %d\n", hd->sectors);
+    printk("    CAPACITY : %dMB\n", hd->sectors / 2048);
+    printk("    LBA48 : %s\n", hd->lba48 ? "yes" : "no");
+
+    /* 第 47 字低 8 位为 READ/WRITE MULTIPLE 每块最多的扇区数，0 表示不支持 */
+    hd->multiple = 0;
+    uint8_t max_multiple = *(uint16_t*)&id_info[47 * 2] & 0xff;
+    if(max_multiple > 1) {
+        outb(reg_sect_cnt(hd->my_channel), max_multiple);
+        out_cmd(hd->my_channel, CMD_SET_MULTIPLE);
+        sem_wait(&hd->my_channel->disk_done);
+        if(!(inb(reg_status(hd->my_channel)) & BIT_STAT_ERR)) {
+            hd->multiple = max_multiple;
+        }
+    }
+    printk("    MULTIPLE : %d\n", hd->multiple);
 }
 
 /* 扫描硬盘 hd 中地址为 ext_lba 的扇区中所有的分区 */
@@ -248,69 +509,66 @@ static bool print_partition_info(struct list_elem* pelem, void* arg UNUSED) {
     return false;
 }
 
+/* 从请求池取一个请求，没有空闲时阻塞 */
+static struct blk_request* sync_req_get(void) {
+    sem_wait(&sync_req_free);
+    enum intr_status old_stat = spin_lock_intr(&sync_req_spin);
+    uint32_t idx = 0;
+    while(sync_req_used[idx]) {
+        idx++;
+    }
+    ASSERT(idx < SYNC_REQ_CNT);
+    sync_req_used[idx] = true;
+    spin_unlock_intr(&sync_req_spin, old_stat);
+    return &sync_reqs[idx];
+}
+
+/* 将请求归还请求池 */
+static void sync_req_put(struct blk_request* req) {
+    enum intr_status old_stat = spin_lock_intr(&sync_req_spin);
+    sync_req_used[req - sync_reqs] = false;
+    spin_unlock_intr(&sync_req_spin, old_stat);
+    sem_post(&sync_req_free);
+}
+
 /* 从硬盘 hd 读取从 lba 扇区地址开始的 sec_cnt 个扇区到 buf */
 void ide_read(struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt) {
-    // printk("%x %x\n", lba, MAX_LBA_CNT);
-    /* 该操作需要加锁，以保证一次只操作同意通道上的一块硬盘 */
-    // ASSERT(lba <= MAX_LBA_CNT);
     ASSERT(sec_cnt > 0);
-    locker_lock(&hd->my_channel->locker);
-    
-    /*  1. 选择操作的硬盘；
-        2. 选择待读入的扇区数和起始的扇区号；
-        3. 向 reg_cmd 寄存器写入读扇区的指令， 并阻塞当前线程；
-        4. 检测硬盘是否可读，失败则弹出错误信息
-        5. 把数据从硬盘的缓冲区读出；
-    */
-    select_disk(hd);
+    /* 同步读写是 bio_submit 加 bio_wait：由通道的派发线程执行，与其他任务的相邻请求合并 */
+    struct blk_request* req = sync_req_get();
     uint32_t secs_op = 0; /* 本次读取的扇区总数 */
     uint32_t secs_done = 0; /* 已经处理的扇区总数 */
     /* sec_cnt 大于 256 时需要多次操作（一次最多操作 256 个扇区） */
     while(secs_done < sec_cnt) {
-        /* 剩余的扇区数大于 256 则本次读取 256，否则读取剩下所有扇区 */
-        secs_op = secs_done + 256 <= sec_cnt ? 256 : sec_cnt - secs_done;
-
-        select_sector(hd, lba + secs_done, secs_op);
-
-        out_cmd(hd->my_channel, CMD_READ_SECTOR);
-        sem_wait(&hd->my_channel->disk_done);
-
-        if(busy_wait(hd)) { /* 成功 */
-            read_sectors(hd, (void*)((uint32_t)buf + (secs_done * 512)), secs_op);
-            secs_done += secs_op;
-        } else { /* 失败 */
+        secs_op = secs_done + BLK_MAX_SECS <= sec_cnt ? BLK_MAX_SECS : sec_cnt - secs_done;
+        bio_submit(req, hd, lba + secs_done, (void*)((uint32_t)buf + (secs_done * 512)), secs_op, false, NULL, NULL);
+        if(!bio_wait(req)) {
             char error[64];
             sprintf(error, "%s read sector %d failed!!!\n", hd->name, lba);
             PANIC(error);
         }
+        secs_done += secs_op;
     }
-    locker_unlock(&hd->my_channel->locker);
+    sync_req_put(req);
 }
 
 /* 将 buf 中 sec_cnt 个扇区的数据写入到从硬盘 hd 从 lba 扇区地址开始的扇区 */
 void ide_write(struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt) {
-    ASSERT(lba <= MAX_LBA_CNT);
     ASSERT(sec_cnt > 0);
-    locker_lock(&hd->my_channel->locker);
-    select_disk(hd);
+    struct blk_request* req = sync_req_get();
     uint32_t secs_op = 0;
     uint32_t secs_done = 0;
     while(secs_done < sec_cnt) {
-        secs_op = secs_done + 256 <= sec_cnt ? 256 : sec_cnt - secs_done;
-        select_sector(hd, lba + secs_done, secs_op);
-        out_cmd(hd->my_channel, CMD_WRITE_SECTOR);
-        busy_wait(hd);
-        if(1) { /* 成功 */
-            write_sectors(hd, (void*)((uint32_t)buf + (secs_done * 512)), secs_op);
-            sem_wait(&hd->my_channel->disk_done);
-            secs_done += secs_op;
-        } else { /* 失败 */
+        secs_op = secs_done + BLK_MAX_SECS <= sec_cnt ? BLK_MAX_SECS : sec_cnt - secs_done;
+        bio_submit(req, hd, lba + secs_done, (void*)((uint32_t)buf + (secs_done * 512)), secs_op, true, NULL, NULL);
+        if(!bio_wait(req)) {
             char error[64];
             sprintf(error, "%s write sector %d failed!!!\n", hd->name, lba);
             PANIC(error);
         }
+        secs_done += secs_op;
     }
-    locker_unlock(&hd->my_channel->locker);
+    sync_req_put(req);
 }
 
 /* hardware interrupt handler */
@@ -333,11 +591,24 @@ void hd_intr_handler(uint8_t irq_no) {
 void ide_init(void) {
     printk("ide_init start\n");
     list_init(&partition_list);
+    sem_init(&sync_req_free, SYNC_REQ_CNT);
+    spin_init(&sync_req_spin);
 
     /* 获取硬盘数量及通道数 */
     ASSERT(HD_CNT > 0);
     channel_cnt = DIV_ROUND_UP(HD_CNT, 2);
 
+    /* 兼容模式的 PCI IDE 控制器提供 bus master DMA，BAR4 为其寄存器的起始端口 */
+    uint16_t bmide_base = 0;
+    struct pci_dev ide_pci;
+    if(pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &ide_pci) && (ide_pci.prog_if & 0x80) && !(ide_pci.prog_if & 0x05)) {
+        bmide_base = pci_config_read(&ide_pci, PCI_BAR4) & 0xfffc;
+        /* 只写 command，status 中的位写 1 会被清除 */
+        uint32_t cmd = pci_config_read(&ide_pci, PCI_COMMAND) & 0xffff;
+        pci_config_write(&ide_pci, PCI_COMMAND, cmd | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+        printk("   bus master ide at 0x%x\n", bmide_base);
+    }
+
     /* 处理每个通道的硬盘 */
     struct ide_channel* channel;
     uint8_t channel_no = 0;
@@ -366,7 +637,21 @@ void ide_init(void) {
             }
         }
         channel->expecting_intr = false;
-        locker_init(&channel->locker);
+        channel->bmide_base = 0;
+        if(bmide_base != 0) {
+            channel->prdt = get_kernel_pages(1);
+            if(channel->prdt != NULL) {
+                channel->bmide_base = bmide_base + channel_no * 8;
+                channel->prdt_phy = addr_v2p((uint32_t)channel->prdt);
+            }
+        }
+        channel->pio_window = kmap_window();
+        ASSERT(channel->pio_window != NULL);
+        spin_init(&channel->blk_spin);
+        channel->dispatcher_sleeping = false;
+        blk_queue_init(&channel->devices[0].queue);
+        blk_queue_init(&channel->devices[1].queue);
+        channel->dispatcher = thread_start(channel->name, THREAD_PRIORITY_DEFAULT, ide_dispatch, channel);
         /* 初始化为 0，目的是向硬盘控制器请求数据后，硬盘驱动信号量阻塞线程，硬盘完成后发出中断，唤醒线程 */
         sem_init(&channel->disk_done, 0);
         /* register hd interrupt handler */
@@ -4,14 +4,12 @@
 #include "global.h"
 #include "sync.h"
 #include "super_block.h"
+#include "blk.h"
 
 #define MAX_PARTITION_PRIMARY_CNT   0x04    /* 最多主分区 */
 #define MAX_PARTITION_LOGIC_CNT     0x08    /* 最多逻辑分区 */
 #define MAX_PARTITION_CNT           MAX_PARTITION_PRIMARY_CNT + MAX_PARTITION_LOGIC_CNT 
 
-/* 定义可读写的最大扇区数， 调试用的 */
-#define MAX_LBA_CNT             ((80*1024*1024/512) - 1) /* 只支持80MB 硬盘 */
-
 /* partition struct */
 struct partition {
     uint32_t lba_start; /* 起始扇区 */
@@ -25,11 +23,23 @@ struct partition {
     struct list open_inodes; /* 本分区打开的 inode 节点队列 */
 };
 
+/* physical region descriptor : DMA 传输的一段物理内存，不能跨越 64KB 边界 */
+struct prd {
+    uint32_t phy_addr; /* 物理地址，须 2 字节对齐 */
+    uint16_t byte_cnt; /* 字节数，0 表示 64KB */
+    uint16_t flags; /* 最高位为 1 表示最后一项 */
+} __attribute__((packed));
+
 /* disk struct */
 struct disk {
     char name[8]; /* disk name */
     struct ide_channel* my_channel; /* 此硬盘属于哪个 ide 通道 */
     uint8_t dev_no; /* master 0 slave 1 */
+    bool dma; /* 硬盘支持 DMA 且所在通道有 bus master，DMA 出错后置为 false 改用 PIO */
+    bool lba48; /* 支持 48 位 lba，超出 28 位的扇区用 EXT 指令读写 */
+    uint8_t multiple; /* READ/WRITE MULTIPLE 每个数据块的扇区数，每块一次中断，0 表示每扇区一次中断 */
+    uint32_t sectors; /* 扇区总数，超出 32 位的部分不使用 */
+    struct blk_queue queue; /* 请求队列 */
     struct partition prim_parts[4]; /* 最多 4 个主分区 */
     struct partition logic_parts[8]; /* 最多允许 8 个逻辑分区（实际上可以无限） */
 };
@@ -39,16 +49,22 @@ struct ide_channel {
     char name[8]; /* ata 通道名 */
     uint16_t port_base; /* 通道的起始端口号 */
     uint8_t irq_no; /* IRQ number */
-    locker_t locker; /* channel locker */
+    spinlock_t blk_spin; /* 保护两块硬盘的请求队列及 dispatcher_sleeping */
+    struct task_struct* dispatcher; /* 派发线程，通道上的读写指令只由它发出 */
+    bool dispatcher_sleeping; /* 派发线程因队列为空而阻塞 */
     bool expecting_intr; /* 等待硬盘中断 */
     sem_t disk_done; /* 阻塞或唤醒驱动程序 */
+    uint16_t bmide_base; /* bus master IDE 寄存器的起始端口号，0 表示不支持 DMA */
+    struct prd* prdt; /* DMA 的物理区域描述符表，占一页 */
+    uint32_t prdt_phy; /* prdt 的物理地址 */
+    void* pio_window; /* PIO 传输时映射缓冲区页框的内核窗口，只由派发线程使用 */
     struct disk devices[2]; /* 连接主从两个硬盘 */
 };
 
-/* 从硬盘 hd 读取从 lba 扇区地址开始的 sec_cnt 个扇区到 buf */
+/* 从硬盘 hd 读取从 lba 扇区地址开始的 sec_cnt 个扇区到 buf，提交请求并等待完成 */
 void ide_read(struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt);
 
-/* 将 buf 中 sec_cnt 个扇区的数据写入到从硬盘 hd 从 lba 扇区地址开始的扇区 */
+/* 将 buf 中 sec_cnt 个扇区的数据写入到从硬盘 hd 从 lba 扇区地址开始的扇区，提交请求并等待完成 */
 void ide_write(struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt);
 
 /* hardware interrupt handler */
@@ -1,89 +1,240 @@
 #include "ioqueue.h"
 #include "debug.h"
 #include "interrupt.h"
+#include "string.h"
 
-/* init io queue ioq */
-void ioq_init(ioqueue_t *ioq) {
-    ASSERT(ioq != NULL);
-    locker_init(&ioq->locker);
-    ioq->producer = NULL;
-    ioq->consumer = NULL;
+/* 全屏障：生产者发布数据后检查等待者，与等待者登记后检查数据，两侧都需要 store-load 顺序 */
+static void ioq_mb(void) {
+    asm volatile("lock; addl $0, 0(%%esp)" : : : "memory");
+}
+
+/* init io queue ioq with buffer buf of size bytes, size must be power of 2 */
+void ioq_init(ioqueue_t *ioq, char *buf, uint32_t size) {
+    ASSERT(ioq != NULL && buf != NULL);
+    ASSERT(size != 0 && (size & (size - 1)) == 0);
+    ioq->buf = buf;
+    ioq->size = size;
     ioq->head = 0;
     ioq->tail = 0;
+    ioq->rd_wake = 1;
+    ioq->wr_wake = 1;
+    ioq->rd_need = 0;
+    ioq->wr_need = 0;
+    spin_init(&ioq->spin);
+    ioq->producer = NULL;
+    ioq->consumer = NULL;
+    locker_init(&ioq->rd_locker, "ioq_rd");
+    locker_init(&ioq->wr_locker, "ioq_wr");
+    ioq->rd_closed = false;
+    ioq->wr_closed = false;
+    wait_queue_init(&ioq->pollq);
+}
+
+/* unregister statistics of ioq's lockers before its memory freed */
+void ioq_destroy(ioqueue_t *ioq) {
+    locker_destroy(&ioq->rd_locker);
+    locker_destroy(&ioq->wr_locker);
+}
+
+/* set wakeup thresholds of consumer & producer */
+void ioq_threshold_set(ioqueue_t *ioq, uint32_t rd_wake, uint32_t wr_wake) {
+    ASSERT(rd_wake > 0 && rd_wake <= ioq->size && wr_wake > 0 && wr_wake <= ioq->size);
+    ioq->rd_wake = rd_wake;
+    ioq->wr_wake = wr_wake;
+}
+
+/* bytes can be read */
+uint32_t ioq_len(ioqueue_t *ioq) {
+    return ioq->head - ioq->tail;
 }
 
-/* get next position in buffer */
-static int32_t ioq_next_pos(int32_t pos) {
-    return ((pos + 1) % IO_QUEUE_BUFFER_SIZE);
+/* bytes can be written */
+uint32_t ioq_space(ioqueue_t *ioq) {
+    return ioq->size - (ioq->head - ioq->tail);
 }
 
 /* ioq is or not full : 1 full 0 not */
 bool ioq_full(ioqueue_t *ioq) {
     ASSERT(ioq != NULL);
-    ASSERT(intr_status_get() == INTR_OFF);
-    return (ioq_next_pos(ioq->head) == ioq->tail ? true : false);
+    return ioq_space(ioq) == 0;
 }
 
 /* ioq is or not empty : 1 empty 0 not */
 bool ioq_empty(ioqueue_t *ioq) {
     ASSERT(ioq != NULL);
-    ASSERT(intr_status_get() == INTR_OFF);
-    return (ioq->head == ioq->tail ? true : false);
+    return ioq_len(ioq) == 0;
 }
 
-/* 使当前生产者或消费者在此缓冲区等待，并记录该等待者 */
-static void ioq_wait(struct task_struct **waiter) {
-    ASSERT(*waiter == NULL && waiter != NULL);
-    *waiter = thread_running();
-    thread_block(TASK_BLOCKED);
+/* 可读（可写）字节数达到 *need 时唤醒等待的 *waiter */
+static void ioq_wakeup(ioqueue_t *ioq, struct task_struct **waiter, uint32_t *need, bool wait_data) {
+    ioq_mb();
+    wait_queue_wake(&ioq->pollq);
+    if(*waiter == NULL) {
+        return; /* 快速路径：没有等待者，不加锁 */
+    }
+    enum intr_status old_stat = spin_lock_intr(&ioq->spin);
+    uint32_t ready = wait_data ? ioq_len(ioq) : ioq_space(ioq);
+    if(*waiter != NULL && ready >= *need) {
+        thread_unblock(*waiter);
+        *waiter = NULL;
+    }
+    spin_unlock_intr(&ioq->spin, old_stat);
 }
 
-/* wakeup waiter */
-static void ioq_wakeup(struct task_struct **waiter) {
-    ASSERT(*waiter != NULL);
-    thread_unblock(*waiter);
-    *waiter = NULL;
+/* 对端是否已关闭，关闭后不会再有数据（空间） */
+static bool ioq_peer_closed(ioqueue_t *ioq, bool wait_data) {
+    return wait_data ? ioq->wr_closed : ioq->rd_closed;
 }
 
-/* produce a byte in ioq */
-void ioq_putchar(ioqueue_t *ioq, char byte) {
-    ASSERT(ioq != NULL);
-    ASSERT(intr_status_get() == INTR_OFF);
-
-    while(ioq_full(ioq)) {
-        locker_lock(&ioq->locker);
-        ioq_wait(&ioq->producer);
-        locker_unlock(&ioq->locker);
+/* 登记为等待者并阻塞，直到可读（可写）字节数达到 need 或对端关闭 */
+static void ioq_wait(ioqueue_t *ioq, struct task_struct **waiter, uint32_t *need_slot, uint32_t need, bool wait_data) {
+    enum intr_status old_stat = spin_lock_intr(&ioq->spin);
+    ASSERT(*waiter == NULL);
+    *need_slot = need;
+    *waiter = thread_running();
+    ioq_mb();
+    /* 登记之后再检查一次，对端在登记之前发布的数据不会被错过 */
+    uint32_t ready = wait_data ? ioq_len(ioq) : ioq_space(ioq);
+    if(ready >= need || ioq_peer_closed(ioq, wait_data)) {
+        *waiter = NULL;
+        spin_unlock_intr(&ioq->spin, old_stat);
+        return;
     }
+    thread_block_release(TASK_BLOCKED, &ioq->spin);
+    intr_status_set(old_stat);
+}
 
-    /* ioq is not full */
-    ioq->buf[ioq->head] = byte;
-    ioq->head = ioq_next_pos(ioq->head);
+/* produce at most len bytes without blocking, return bytes produced. interrupt handler can call */
+uint32_t ioq_put(ioqueue_t *ioq, const char *buf, uint32_t len) {
+    uint32_t head = ioq->head;
+    uint32_t space = ioq->size - (head - ioq->tail);
+    if(len > space) {
+        len = space;
+    }
+    if(len == 0) {
+        return 0;
+    }
+    /* 分回绕前后两段复制 */
+    uint32_t pos = head & (ioq->size - 1);
+    uint32_t first = ioq->size - pos < len ? ioq->size - pos : len;
+    memcpy(ioq->buf + pos, buf, first);
+    memcpy(ioq->buf, buf + first, len - first);
+    /* 数据写入之后才发布 head */
+    asm volatile("" : : : "memory");
+    ioq->head = head + len;
+    ioq_wakeup(ioq, &ioq->consumer, &ioq->rd_need, true);
+    return len;
+}
 
-    if(ioq->consumer != NULL) {
-        /* wakeup consumer */
-        ioq_wakeup(&ioq->consumer);
+/* consume at most len bytes without blocking, return bytes consumed */
+uint32_t ioq_get(ioqueue_t *ioq, char *buf, uint32_t len) {
+    uint32_t tail = ioq->tail;
+    uint32_t avail = ioq->head - tail;
+    if(len > avail) {
+        len = avail;
     }
+    if(len == 0) {
+        return 0;
+    }
+    asm volatile("" : : : "memory");
+    uint32_t pos = tail & (ioq->size - 1);
+    uint32_t first = ioq->size - pos < len ? ioq->size - pos : len;
+    memcpy(buf, ioq->buf + pos, first);
+    memcpy(buf + first, ioq->buf, len - first);
+    /* 数据读出之后才释放空间 */
+    asm volatile("" : : : "memory");
+    ioq->tail = tail + len;
+    ioq_wakeup(ioq, &ioq->producer, &ioq->wr_need, false);
+    return len;
 }
 
-/* consume a byte in ioq */
-char ioq_getchar(ioqueue_t *ioq) {
+/* produce len bytes, block while ioq is full, stop early if consumer side closed. return bytes produced */
+uint32_t ioq_write(ioqueue_t *ioq, const char *buf, uint32_t len) {
     ASSERT(ioq != NULL);
-    ASSERT(intr_status_get() == INTR_OFF);
+    uint32_t done = 0;
+    locker_lock(&ioq->wr_locker);
+    while(done < len && !ioq->rd_closed) {
+        done += ioq_put(ioq, buf + done, len - done);
+        if(done < len) {
+            /* 空闲空间达到阈值（或足够写完）再被唤醒，成块写入 */
+            uint32_t left = len - done;
+            ioq_wait(ioq, &ioq->producer, &ioq->wr_need, left < ioq->wr_wake ? left : ioq->wr_wake, false);
+        }
+    }
+    locker_unlock(&ioq->wr_locker);
+    return done;
+}
 
-    while(ioq_empty(ioq)) {
-        locker_lock(&ioq->locker);
-        ioq_wait(&ioq->consumer);
-        locker_unlock(&ioq->locker);
+/* 读出 len 字节，至少读到 min 字节才返回，生产端关闭且读空时提前返回 */
+static uint32_t ioq_read_min(ioqueue_t *ioq, char *buf, uint32_t len, uint32_t min) {
+    ASSERT(ioq != NULL);
+    uint32_t done = 0;
+    locker_lock(&ioq->rd_locker);
+    while(done < len) {
+        done += ioq_get(ioq, buf + done, len - done);
+        if(done >= min || (ioq->wr_closed && ioq_empty(ioq))) {
+            break;
+        }
+        uint32_t left = min - done;
+        ioq_wait(ioq, &ioq->consumer, &ioq->rd_need, left < ioq->rd_wake ? left : ioq->rd_wake, true);
     }
+    locker_unlock(&ioq->rd_locker);
+    return done;
+}
+
+/* consume len bytes, block while ioq is empty, stop early if producer side closed. return bytes consumed */
+uint32_t ioq_read(ioqueue_t *ioq, char *buf, uint32_t len) {
+    return ioq_read_min(ioq, buf, len, len);
+}
+
+/* consume at most len bytes, block only while ioq is empty. return 0 if empty and producer side closed */
+uint32_t ioq_read_some(ioqueue_t *ioq, char *buf, uint32_t len) {
+    return ioq_read_min(ioq, buf, len, len == 0 ? 0 : 1);
+}
+
+/* consume at most len bytes without waiting for data, serialized with other consumers */
+uint32_t ioq_try_read(ioqueue_t *ioq, char *buf, uint32_t len) {
+    locker_lock(&ioq->rd_locker);
+    uint32_t got = ioq_get(ioq, buf, len);
+    locker_unlock(&ioq->rd_locker);
+    return got;
+}
 
-    /* ioq is not empty */
-    char byte = ioq->buf[ioq->tail];
-    ioq->tail = ioq_next_pos(ioq->tail);
+/* produce at most len bytes without waiting for space, serialized with other producers */
+uint32_t ioq_try_write(ioqueue_t *ioq, const char *buf, uint32_t len) {
+    locker_lock(&ioq->wr_locker);
+    uint32_t put = ioq_put(ioq, buf, len);
+    locker_unlock(&ioq->wr_locker);
+    return put;
+}
 
-    if(ioq->producer != NULL) {
-        /* wake up produce */
-        ioq_wakeup(&ioq->producer);
+/* close consumer side (rd_side true) or producer side, wake up waiter of the other side */
+void ioq_close(ioqueue_t *ioq, bool rd_side) {
+    if(rd_side) {
+        ioq->rd_closed = true;
+    } else {
+        ioq->wr_closed = true;
+    }
+    ioq_mb();
+    wait_queue_wake(&ioq->pollq);
+    /* 对端等待的条件已不可能满足，无条件唤醒 */
+    struct task_struct **waiter = rd_side ? &ioq->producer : &ioq->consumer;
+    enum intr_status old_stat = spin_lock_intr(&ioq->spin);
+    if(*waiter != NULL) {
+        thread_unblock(*waiter);
+        *waiter = NULL;
     }
+    spin_unlock_intr(&ioq->spin, old_stat);
+}
+
+/* produce a byte in ioq */
+void ioq_putchar(ioqueue_t *ioq, char byte) {
+    ioq_write(ioq, &byte, 1);
+}
+
+/* consume a byte in ioq */
+char ioq_getchar(ioqueue_t *ioq) {
+    char byte;
+    ioq_read(ioq, &byte, 1);
     return byte;
-}
\ No newline at end of file
+}
@@ -4,23 +4,52 @@
 #include "stdint.h"
 #include "thread.h"
 #include "sync.h"
+#include "waitqueue.h"
 
-#define IO_QUEUE_BUFFER_SIZE 64
-
-/* cycle queue */
+/*
+ * 单生产者单消费者环形缓冲区，容量为 2 的幂
+ * head、tail 为一直递增的字节计数，只分别由生产者、消费者修改，读写数据不需要加锁也不需要关中断，
+ * 键盘中断作为生产者时与消费者可以同时进行。自旋锁只用于登记及唤醒等待者
+ * 同一端有多个任务时（如多个进程读同一个缓冲区）由该端的 locker 串行化
+ */
 typedef struct {
-    locker_t locker;
-    /* producer & consumer */
-    struct task_struct *producer;
-    struct task_struct *consumer;
-
-    char buf[IO_QUEUE_BUFFER_SIZE];
-    int32_t head; /* index of buffer */
-    int32_t tail;
+    char *buf;
+    uint32_t size; /* 容量，2 的幂 */
+    volatile uint32_t head; /* 已写入的字节数，只由生产者修改 */
+    volatile uint32_t tail; /* 已读出的字节数，只由消费者修改 */
+
+    /* 唤醒阈值：可读字节数（空闲空间）达到阈值才唤醒等待的消费者（生产者），减少唤醒次数 */
+    uint32_t rd_wake;
+    uint32_t wr_wake;
+    uint32_t rd_need; /* 本次等待的消费者需要的字节数 */
+    uint32_t wr_need;
+
+    spinlock_t spin; /* 保护等待者 */
+    struct task_struct *producer; /* 等待空间的生产者 */
+    struct task_struct *consumer; /* 等待数据的消费者 */
+    locker_t rd_locker; /* 串行化多个消费者 */
+    locker_t wr_locker; /* 串行化多个生产者，中断中的生产者不使用 */
+
+    volatile bool rd_closed; /* 消费端已关闭，生产者不再等待（管道读端全部关闭） */
+    volatile bool wr_closed; /* 生产端已关闭，消费者读空后不再等待（管道写端全部关闭） */
+
+    wait_queue_t pollq; /* poll 的等待者，每次读写、关闭都会唤醒 */
 }ioqueue_t;
 
-/* init io queue ioq */
-void ioq_init(ioqueue_t *ioq);
+/* init io queue ioq with buffer buf of size bytes, size must be power of 2 */
+void ioq_init(ioqueue_t *ioq, char *buf, uint32_t size);
+
+/* unregister statistics of ioq's lockers before its memory freed */
+void ioq_destroy(ioqueue_t *ioq);
+
+/* set wakeup thresholds of consumer & producer */
+void ioq_threshold_set(ioqueue_t *ioq, uint32_t rd_wake, uint32_t wr_wake);
+
+/* bytes can be read */
+uint32_t ioq_len(ioqueue_t *ioq);
+
+/* bytes can be written */
+uint32_t ioq_space(ioqueue_t *ioq);
 
 /* ioq is or not full : 1 full 0 not */
 bool ioq_full(ioqueue_t *ioq);
@@ -28,10 +57,34 @@ bool ioq_full(ioqueue_t *ioq);
 /* ioq is or not empty : 1 empty 0 not */
 bool ioq_empty(ioqueue_t *ioq);
 
+/* produce at most len bytes without blocking, return bytes produced. interrupt handler can call */
+uint32_t ioq_put(ioqueue_t *ioq, const char *buf, uint32_t len);
+
+/* consume at most len bytes without blocking, return bytes consumed */
+uint32_t ioq_get(ioqueue_t *ioq, char *buf, uint32_t len);
+
+/* produce len bytes, block while ioq is full, stop early if consumer side closed. return bytes produced */
+uint32_t ioq_write(ioqueue_t *ioq, const char *buf, uint32_t len);
+
+/* consume len bytes, block while ioq is empty, stop early if producer side closed. return bytes consumed */
+uint32_t ioq_read(ioqueue_t *ioq, char *buf, uint32_t len);
+
+/* consume at most len bytes, block only while ioq is empty. return 0 if empty and producer side closed */
+uint32_t ioq_read_some(ioqueue_t *ioq, char *buf, uint32_t len);
+
+/* consume at most len bytes without waiting for data, serialized with other consumers */
+uint32_t ioq_try_read(ioqueue_t *ioq, char *buf, uint32_t len);
+
+/* produce at most len bytes without waiting for space, serialized with other producers */
+uint32_t ioq_try_write(ioqueue_t *ioq, const char *buf, uint32_t len);
+
+/* close consumer side (rd_side true) or producer side, wake up waiter of the other side */
+void ioq_close(ioqueue_t *ioq, bool rd_side);
+
 /* produce a byte in ioq */
 void ioq_putchar(ioqueue_t *ioq, char byte);
 
 /* consume a byte in ioq */
 char ioq_getchar(ioqueue_t *ioq);
 
-#endif
\ No newline at end of file
+#endif
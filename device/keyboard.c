@@ -7,6 +7,7 @@
 #include "ioqueue.h"
 
 #define KBD_BUF_PORT 0x60 /* keyboard R/W buffer register port is 0x60 */
+#define KBD_BUF_SIZE 64 /* keyboard ring buffer size, power of 2 */
 #define K_ERROR_CODE 0x00 /* keyboard error code */
 
 /* control char */
@@ -37,6 +38,7 @@
 #define K_CAPSLOCK_MAKECODE 0x3a
 
 ioqueue_t __kbd_buf; /* keyboard buffer */
+static char kbd_buf_data[KBD_BUF_SIZE];
 
 /* 1 is push down, 0 is pop on. As for extern_status, 1 is extern key(begin with 0xe0). */
 static bool ctrl_status, shift_status, alt_status, capslock_status, extern_scancode;
@@ -206,9 +208,8 @@ static void intr_keyboard_handler(void) {
                             break;
                     }
                 }
-                if(!ioq_full(&__kbd_buf)) {
-                    ioq_putchar(&__kbd_buf, cur_char);
-                }
+                /* 缓冲区满则丢弃，中断中不能阻塞 */
+                ioq_put(&__kbd_buf, &cur_char, 1);
                 return;
             }
             switch (scancode) {
@@ -246,7 +247,7 @@ static void intr_keyboard_handler(void) {
 /* keyboard init */
 void keyboard_init(void) {
     put_str("keyboard init start\n");
-    ioq_init(&__kbd_buf);
+    ioq_init(&__kbd_buf, kbd_buf_data, KBD_BUF_SIZE);
     put_str("   ");
     intr_handler_register(0x21, intr_keyboard_handler);
     put_str("keyboard init done\n");
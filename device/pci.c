@@ -0,0 +1,67 @@
+#include "pci.h"
+#include "io.h"
+
+/* 配置机制 1：向地址端口写入 总线/设备/功能/寄存器，再从数据端口读写 */
+#define PCI_CONFIG_ADDR     0xcf8
+#define PCI_CONFIG_DATA     0xcfc
+#define PCI_CONFIG_ENABLE   0x80000000
+
+#define PCI_MAX_BUS     256
+#define PCI_MAX_DEV     32
+#define PCI_MAX_FUNC    8
+
+static uint32_t pci_config_addr(uint8_t bus, uint8_t dev, uint8_t func, uint8_t offset) {
+    return PCI_CONFIG_ENABLE | ((uint32_t)bus << 16) | ((uint32_t)dev << 11) | ((uint32_t)func << 8) | (offset & 0xfc);
+}
+
+static uint32_t pci_read(uint8_t bus, uint8_t dev, uint8_t func, uint8_t offset) {
+    outl(PCI_CONFIG_ADDR, pci_config_addr(bus, dev, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+/* 读取设备 pdev 配置空间 offset 处的 32 位值，offset 须 4 字节对齐 */
+uint32_t pci_config_read(struct pci_dev* pdev, uint8_t offset) {
+    return pci_read(pdev->bus, pdev->dev, pdev->func, offset);
+}
+
+/* 写入设备 pdev 配置空间 offset 处的 32 位值，offset 须 4 字节对齐 */
+void pci_config_write(struct pci_dev* pdev, uint8_t offset, uint32_t val) {
+    outl(PCI_CONFIG_ADDR, pci_config_addr(pdev->bus, pdev->dev, pdev->func, offset));
+    outl(PCI_CONFIG_DATA, val);
+}
+
+/* 扫描所有总线，找到第一个类别为 class_code、子类为 subclass 的设备存入 pdev，找到返回 true */
+bool pci_find_class(uint8_t class_code, uint8_t subclass, struct pci_dev* pdev) {
+    uint32_t bus, dev, func;
+    for(bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for(dev = 0; dev < PCI_MAX_DEV; dev++) {
+            for(func = 0; func < PCI_MAX_FUNC; func++) {
+                uint32_t id = pci_read(bus, dev, func, PCI_VENDOR_ID);
+                if((id & 0xffff) == 0xffff) {
+                    /* 功能 0 不存在则整个设备不存在 */
+                    if(func == 0) {
+                        break;
+                    }
+                    continue;
+                }
+                uint32_t class = pci_read(bus, dev, func, PCI_CLASS);
+                if((class >> 24) == class_code && ((class >> 16) & 0xff) == subclass) {
+                    pdev->bus = bus;
+                    pdev->dev = dev;
+                    pdev->func = func;
+                    pdev->vendor_id = id & 0xffff;
+                    pdev->device_id = id >> 16;
+                    pdev->class_code = class_code;
+                    pdev->subclass = subclass;
+                    pdev->prog_if = (class >> 8) & 0xff;
+                    return true;
+                }
+                /* 单功能设备只有功能 0 */
+                if(func == 0 && !(pci_read(bus, dev, func, PCI_HEADER_TYPE) & 0x800000)) {
+                    break;
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,40 @@
+#ifndef __DEVICE_PCI_H
+#define __DEVICE_PCI_H
+
+#include "global.h"
+
+/* 配置空间寄存器偏移 */
+#define PCI_VENDOR_ID       0x00    /* [0-15] vendor id, [16-31] device id */
+#define PCI_COMMAND         0x04    /* [0-15] command, [16-31] status */
+#define PCI_CLASS           0x08    /* [8-15] prog if, [16-23] subclass, [24-31] class */
+#define PCI_HEADER_TYPE     0x0c    /* [16-23] header type, bit 7 表示多功能设备 */
+#define PCI_BAR4            0x20
+
+#define PCI_COMMAND_IO      0x1     /* 响应 I/O 空间访问 */
+#define PCI_COMMAND_MASTER  0x4     /* 允许总线主控（DMA） */
+
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+
+/* 一个 PCI 设备功能 */
+struct pci_dev {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t func;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+};
+
+/* 读取设备 pdev 配置空间 offset 处的 32 位值，offset 须 4 字节对齐 */
+uint32_t pci_config_read(struct pci_dev* pdev, uint8_t offset);
+
+/* 写入设备 pdev 配置空间 offset 处的 32 位值，offset 须 4 字节对齐 */
+void pci_config_write(struct pci_dev* pdev, uint8_t offset, uint32_t val);
+
+/* 扫描所有总线，找到第一个类别为 class_code、子类为 subclass 的设备存入 pdev，找到返回 true */
+bool pci_find_class(uint8_t class_code, uint8_t subclass, struct pci_dev* pdev);
+
+#endif /* __DEVICE_PCI_H */
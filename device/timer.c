@@ -4,6 +4,8 @@
 #include "thread.h"
 #include "debug.h"
 #include "interrupt.h"
+#include "workqueue.h"
+#include "vdso.h"
 
 #define IRQ0_FREQUENCY      100
 
@@ -16,10 +18,13 @@
 #define COUNTER1_NO         1
 #define COUNTER2_NO         2
 #define READ_WRITE_LATCH    3
+#define COUNTER_MODE_0      0
 #define COUNTER_MODE_2      2
 #define PIT_BCD_0           0
 #define PIT_BCD_1           1
 #define PIT_CONTROL_PORT    0x43
+/* 8042 port B : bit 0 通道 2 门控，bit 1 扬声器，bit 5 通道 2 输出 */
+#define PIT_GATE_PORT       0x61
 
 /* 多少 ms 发生一次中断 */
 #define MIL_SECONDS_PER_INTR (1000 / IRQ0_FREQUENCY)
@@ -49,37 +54,50 @@ static void set_frequency(uint8_t counter_port,
     outb(counter_port, (uint8_t)(counter_value >> 8)); /* high 8 bit */
 }
 
-/* timer interrupt handler */
+/* timer interrupt handler, PIT 只连接到 BSP，AP 的时间片由 local apic 时钟驱动 */
 static void timer_intr_handler(void) {
-    struct task_struct* cur_thread = thread_running();
-    
-    /* 判断栈是否溢出 */
-    ASSERT(0x19990926 == cur_thread->stack_magic);
-    
-    cur_thread->elapsed_ticks++;
     ticks++;
-    /* 时间片用完则开始新的调度 */
-    if(cur_thread->ticks == 0) {
-        schedule();
-    } else {
-        cur_thread->ticks--;
-    }
+    vdso_data->ticks = ticks;
+    thread_sleep_tick(ticks);
+    workqueue_tick(ticks);
+    thread_tick();
 }
 
-/* 以 tick 为单位的 sleep， 任何时间形式的 sleep 都会转化为 ticks 形式 */
-static void ticks_to_sleep(uint32_t sleep_ticks) {
-    uint32_t tick_start = ticks;
-    /* 间隔时长不够则让出 CPU */
-    while(ticks - tick_start < sleep_ticks) {
-        thread_yield();
+/* 以 PIT 通道 2 忙等 u_seconds 微秒，不依赖时钟中断，用于启动 AP、校准 local apic 时钟 */
+void timer_udelay(uint32_t u_seconds) {
+    while(u_seconds > 0) {
+        /* 16 位计数器一次最多约 54ms */
+        uint32_t chunk = u_seconds > 50000 ? 50000 : u_seconds;
+        uint16_t count = (uint16_t)(INPUT_FREQUENCY / 1000 * chunk / 1000);
+        if(count == 0) {
+            count = 1;
+        }
+        /* 关门控及扬声器，写入计数值后打开门控开始计数，计满时通道 2 输出变高 */
+        outb(PIT_GATE_PORT, inb(PIT_GATE_PORT) & ~0x03);
+        set_ctl_mode(PIT_CONTROL_PORT, COUNTER2_NO, READ_WRITE_LATCH, COUNTER_MODE_0, PIT_BCD_0);
+        set_frequency(COUNTER2_PORT, count);
+        outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+        while(!(inb(PIT_GATE_PORT) & 0x20));
+        u_seconds -= chunk;
     }
 }
 
-/* 以毫秒为单位的 sleep， 1s = 1000ms */
+/* 毫秒数换算为时钟中断数，不足一个按一个计 */
+uint32_t mtime_to_ticks(uint32_t m_seconds) {
+    uint32_t m_ticks = DIV_ROUND_UP(m_seconds, MIL_SECONDS_PER_INTR);
+    return m_ticks == 0 ? 1 : m_ticks;
+}
+
+/* 时钟中断数换算为毫秒数 */
+uint32_t ticks_to_mtime(uint32_t m_ticks) {
+    return m_ticks * MIL_SECONDS_PER_INTR;
+}
+
+/* 以毫秒为单位的 sleep， 1s = 1000ms，任何时间形式的 sleep 都会转化为 ticks 形式，由调度器在到期时唤醒 */
 void mtime_sleep(uint32_t m_seconds) {
     uint32_t sleep_ticks = DIV_ROUND_UP(m_seconds, MIL_SECONDS_PER_INTR);
     ASSERT(sleep_ticks > 0);
-    ticks_to_sleep(sleep_ticks);
+    thread_sleep(sleep_ticks);
 }
 
 /* init PIT */
@@ -87,6 +105,11 @@ void timer_init(void) {
     put_str("timer_init start\n");
     set_ctl_mode(PIT_CONTROL_PORT, COUNTER0_NO, READ_WRITE_LATCH, COUNTER_MODE_2, PIT_BCD_0);
     set_frequency(COUNTER0_PORT, COUNTER0_VALUE);
+    /* 时钟参数供用户进程通过 vdso 数据页读取 */
+    vdso_data->hz = IRQ0_FREQUENCY;
+    vdso_data->mtime_per_tick = MIL_SECONDS_PER_INTR;
+    vdso_data->pit_input_freq = INPUT_FREQUENCY;
+    vdso_data->pit_counter0 = COUNTER0_VALUE;
     put_str("   "); /* intent(no meanning) */
     intr_handler_register(0x20, timer_intr_handler);
     put_str("timer_init done\n");
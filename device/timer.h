@@ -3,9 +3,18 @@
 
 #include "global.h"
 
+/* 毫秒数换算为时钟中断数，不足一个按一个计 */
+uint32_t mtime_to_ticks(uint32_t m_seconds);
+
+/* 时钟中断数换算为毫秒数 */
+uint32_t ticks_to_mtime(uint32_t m_ticks);
+
 /* 以毫秒为单位的 sleep， 1s = 1000ms */
 void mtime_sleep(uint32_t m_seconds);
 
+/* 以 PIT 通道 2 忙等 u_seconds 微秒，不依赖时钟中断，用于启动 AP、校准 local apic 时钟 */
+void timer_udelay(uint32_t u_seconds);
+
 /* init PIT */
 void timer_init(void);
 
@@ -0,0 +1,342 @@
+#include "bcache.h"
+#include "ide.h"
+#include "fs.h"
+#include "file.h"
+#include "pipe.h"
+#include "memory.h"
+#include "string.h"
+#include "timer.h"
+#include "workqueue.h"
+#include "debug.h"
+#include "stdio_kernel.h"
+
+extern struct file __file_table[MAX_FILE_OPEN]; /* 文件表 */
+
+static struct buffer_head* bcache_bufs; /* 所有缓存 */
+static struct list bcache_hash[BCACHE_HASH_NR]; /* 已使用的缓存按 (hd, lba) 散列 */
+static struct list bcache_lru; /* 引用为 0 的缓存，队首最久未使用 */
+static struct list bcache_ra; /* 已提交预读尚未被等待的缓存 */
+static spinlock_t bcache_spin; /* 保护哈希表、lru 及 ra 队列、refcnt、reading 及 hd、lba */
+
+static struct list* bcache_bucket(struct disk* hd, uint32_t lba) {
+    return &bcache_hash[((uint32_t)hd / sizeof(struct disk) + lba) % BCACHE_HASH_NR];
+}
+
+/* (hd, lba) 的排序关键字比较：按硬盘再按 lba 升序，持有多个缓存的锁时按此顺序加锁 */
+static bool bcache_before(struct buffer_head* a, struct buffer_head* b) {
+    return a->hd != b->hd ? (uint32_t)a->hd < (uint32_t)b->hd : a->lba < b->lba;
+}
+
+/* 释放一个引用，最后一个使用者将缓存放到 lru 队尾 */
+static void bcache_put(struct buffer_head* bh) {
+    enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+    ASSERT(bh->refcnt > 0);
+    if(--bh->refcnt == 0) {
+        list_push_back(&bcache_lru, &bh->lru_tag);
+    }
+    spin_unlock_intr(&bcache_spin, old_stat);
+}
+
+/* 持有 bh->lock 时调用：等待 bh 上未完成的预读并释放预读持有的引用，失败时 bh 保持无效 */
+static void bcache_ra_finish(struct buffer_head* bh) {
+    if(!bh->reading) {
+        return;
+    }
+    bh->valid = bio_wait(&bh->req);
+    enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+    list_remove(&bh->ra_tag);
+    bh->reading = false;
+    ASSERT(bh->refcnt > 1); /* 调用者也持有引用 */
+    bh->refcnt--;
+    spin_unlock_intr(&bcache_spin, old_stat);
+}
+
+/* 回收所有未被使用的预读：等待其完成并放回 lru 队列，调用者不能持有其他缓存的锁 */
+static void bcache_ra_reap(void) {
+    while(1) {
+        enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+        if(list_empty(&bcache_ra)) {
+            spin_unlock_intr(&bcache_spin, old_stat);
+            return;
+        }
+        struct buffer_head* bh = elem2entry(struct buffer_head, ra_tag, bcache_ra.head.next);
+        bh->refcnt++; /* 预读持有引用，不在 lru 队列中 */
+        spin_unlock_intr(&bcache_spin, old_stat);
+
+        locker_lock(&bh->lock);
+        bcache_ra_finish(bh);
+        locker_unlock(&bh->lock);
+        bcache_put(bh);
+    }
+}
+
+/* 取得 (hd, lba) 的缓存并增加引用，不在缓存中则替换最久未使用的缓存，此时 valid 为 false
+ * 没有可替换的干净缓存时需要等待其他任务释放或写回脏缓存，调用者持有其他缓存的锁时 may_wait 须为 false，
+ * 此时返回 NULL，由调用者放下已持有的缓存后再取：写回要锁住脏缓存，持有锁等待会与其他写回互相等待 */
+static struct buffer_head* bcache_get(struct disk* hd, uint32_t lba, bool may_wait) {
+    struct list* bucket = bcache_bucket(hd, lba);
+    while(1) {
+        enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+        struct list_elem* elem;
+        for(elem = bucket->head.next; elem != &bucket->tail; elem = elem->next) {
+            struct buffer_head* bh = elem2entry(struct buffer_head, hash_tag, elem);
+            if(bh->hd == hd && bh->lba == lba) {
+                if(bh->refcnt++ == 0) {
+                    list_remove(&bh->lru_tag);
+                }
+                spin_unlock_intr(&bcache_spin, old_stat);
+                return bh;
+            }
+        }
+
+        if(list_empty(&bcache_lru)) {
+            /* 所有缓存都在使用中：先回收预读占用的缓存，没有则等待其他任务释放 */
+            bool ra_pending = !list_empty(&bcache_ra);
+            spin_unlock_intr(&bcache_spin, old_stat);
+            if(!may_wait) {
+                return NULL;
+            }
+            if(ra_pending) {
+                bcache_ra_reap();
+            } else {
+                thread_yield();
+            }
+            continue;
+        }
+        /* 优先替换干净的缓存 */
+        struct buffer_head* victim = NULL;
+        for(elem = bcache_lru.head.next; elem != &bcache_lru.tail; elem = elem->next) {
+            struct buffer_head* bh = elem2entry(struct buffer_head, lru_tag, elem);
+            if(!bh->dirty) {
+                victim = bh;
+                break;
+            }
+        }
+        if(victim == NULL) {
+            /* 全是脏缓存：成批写回后重新查找 */
+            spin_unlock_intr(&bcache_spin, old_stat);
+            if(!may_wait) {
+                return NULL;
+            }
+            bcache_sync(NULL);
+            continue;
+        }
+
+        list_remove(&victim->lru_tag);
+        if(victim->hd != NULL) {
+            list_remove(&victim->hash_tag);
+        }
+        victim->hd = hd;
+        victim->lba = lba;
+        victim->refcnt = 1;
+        victim->valid = false;
+        list_push_front(bucket, &victim->hash_tag);
+        spin_unlock_intr(&bcache_spin, old_stat);
+        return victim;
+    }
+}
+
+/* 从硬盘 hd 读取从 lba 起 sec_cnt 个扇区到 buf，未命中的扇区同时提交后一起等待 */
+void bcache_read(struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt) {
+    struct buffer_head* bhs[BCACHE_BATCH];
+    bool reading[BCACHE_BATCH];
+    uint32_t secs_done = 0;
+    while(secs_done < sec_cnt) {
+        uint32_t cnt = sec_cnt - secs_done < BCACHE_BATCH ? sec_cnt - secs_done : BCACHE_BATCH;
+        uint32_t idx;
+        /* 1 按 lba 升序锁住本批扇区，未读入的提交读请求，相邻的请求在队列中合并为一条指令
+         *   已持有本批扇区时取不到缓存则本批到此为止，放下后下一批再等待 */
+        for(idx = 0; idx < cnt; idx++) {
+            struct buffer_head* bh = bcache_get(hd, lba + secs_done + idx, idx == 0);
+            if(bh == NULL) {
+                cnt = idx;
+                break;
+            }
+            locker_lock(&bh->lock);
+            bcache_ra_finish(bh);
+            bhs[idx] = bh;
+            reading[idx] = !bh->valid;
+            if(reading[idx]) {
+                bio_submit(&bh->req, hd, bh->lba, bh->data, 1, false, NULL, NULL);
+            }
+        }
+        /* 2 等待读入完成并复制给调用者 */
+        for(idx = 0; idx < cnt; idx++) {
+            struct buffer_head* bh = bhs[idx];
+            if(reading[idx]) {
+                if(!bio_wait(&bh->req)) {
+                    char error[64];
+                    sprintf(error, "%s read sector %d failed!!!\n", hd->name, bh->lba);
+                    PANIC(error);
+                }
+                bh->valid = true;
+            }
+            memcpy((uint8_t*)buf + (secs_done + idx) * SECTOR_SIZE, bh->data, SECTOR_SIZE);
+            locker_unlock(&bh->lock);
+            bcache_put(bh);
+        }
+        secs_done += cnt;
+    }
+}
+
+/* 异步预读硬盘 hd 上 lbas 中的 cnt 个扇区，提交后立即返回，由之后的 bcache_read 等待完成
+ * 预读不为腾出缓存而写回或让出处理器，取不到缓存的扇区不预读 */
+void bcache_readahead(struct disk* hd, const uint32_t* lbas, uint32_t cnt) {
+    uint32_t idx;
+    for(idx = 0; idx < cnt; idx++) {
+        struct buffer_head* bh = bcache_get(hd, lbas[idx], false);
+        if(bh == NULL) {
+            continue;
+        }
+        locker_lock(&bh->lock);
+        if(!bh->valid && !bh->reading) {
+            /* 引用留给预读，直到使用者或回收时等待完成 */
+            enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+            bh->reading = true;
+            bh->refcnt++;
+            list_push_back(&bcache_ra, &bh->ra_tag);
+            spin_unlock_intr(&bcache_spin, old_stat);
+            bio_submit(&bh->req, hd, bh->lba, bh->data, 1, false, NULL, NULL);
+        }
+        locker_unlock(&bh->lock);
+        bcache_put(bh);
+    }
+}
+
+/* 预读可使用的扇区数：可替换缓存的一半，为其他文件及元数据留出余量 */
+uint32_t bcache_ra_budget(void) {
+    enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+    uint32_t budget = list_len(&bcache_lru) / 2;
+    spin_unlock_intr(&bcache_spin, old_stat);
+    return budget;
+}
+
+/* 将 buf 中 sec_cnt 个扇区写入缓存中 hd 从 lba 起的扇区，由周期性的写回工作或 sync 写到磁盘 */
+void bcache_write(struct disk* hd, uint32_t lba, const void* buf, uint32_t sec_cnt) {
+    uint32_t idx;
+    for(idx = 0; idx < sec_cnt; idx++) {
+        /* 整扇区写入，不需要先读入 */
+        struct buffer_head* bh = bcache_get(hd, lba + idx, true);
+        locker_lock(&bh->lock);
+        bcache_ra_finish(bh); /* 不能让预读覆盖新写入的数据 */
+        memcpy(bh->data, (const uint8_t*)buf + idx * SECTOR_SIZE, SECTOR_SIZE);
+        bh->valid = true;
+        bh->dirty = true;
+        locker_unlock(&bh->lock);
+        bcache_put(bh);
+    }
+}
+
+/* 将硬盘 hd（NULL 表示所有硬盘）的脏扇区写回并等待完成 */
+void bcache_sync(struct disk* hd) {
+    struct buffer_head* bhs[BCACHE_BATCH];
+    bool writing[BCACHE_BATCH];
+    while(1) {
+        /* 1 选出 (hd, lba) 最小的一批脏缓存并增加引用，写回后即干净，下一轮选出其余的 */
+        uint32_t cnt = 0;
+        uint32_t idx;
+        enum intr_status old_stat = spin_lock_intr(&bcache_spin);
+        for(idx = 0; idx < BCACHE_NR; idx++) {
+            struct buffer_head* bh = &bcache_bufs[idx];
+            if(!bh->dirty || (hd != NULL && bh->hd != hd)) {
+                continue;
+            }
+            if(cnt == BCACHE_BATCH && !bcache_before(bh, bhs[cnt - 1])) {
+                continue;
+            }
+            uint32_t pos = cnt < BCACHE_BATCH ? cnt++ : cnt - 1;
+            while(pos > 0 && bcache_before(bh, bhs[pos - 1])) {
+                bhs[pos] = bhs[pos - 1];
+                pos--;
+            }
+            bhs[pos] = bh;
+        }
+        for(idx = 0; idx < cnt; idx++) {
+            if(bhs[idx]->refcnt++ == 0) {
+                list_remove(&bhs[idx]->lru_tag);
+            }
+        }
+        spin_unlock_intr(&bcache_spin, old_stat);
+        if(cnt == 0) {
+            return;
+        }
+
+        /* 2 按序加锁并提交写请求，相邻扇区在队列中合并 */
+        for(idx = 0; idx < cnt; idx++) {
+            locker_lock(&bhs[idx]->lock);
+            writing[idx] = bhs[idx]->dirty;
+            if(writing[idx]) {
+                bio_submit(&bhs[idx]->req, bhs[idx]->hd, bhs[idx]->lba, bhs[idx]->data, 1, true, NULL, NULL);
+            }
+        }
+        /* 3 等待完成 */
+        for(idx = 0; idx < cnt; idx++) {
+            if(writing[idx]) {
+                if(!bio_wait(&bhs[idx]->req)) {
+                    PANIC("bcache_sync: write sector failed");
+                }
+                bhs[idx]->dirty = false;
+            }
+            locker_unlock(&bhs[idx]->lock);
+            bcache_put(bhs[idx]);
+        }
+    }
+}
+
+/* 将所有脏扇区写回磁盘 */
+void sys_sync(void) {
+    bcache_sync(NULL);
+}
+
+/* 将所有脏扇区写回磁盘，fd 无效返回 -1，成功返回 0
+ * 文件的数据块、间接块及 inode 可能分布在任意位置，不单独区分，整个缓存一起写回 */
+int32_t sys_fsync(int32_t fd) {
+    int32_t gfd = fd_local2global(fd);
+    if(gfd == -1 || __file_table[gfd].fd_inode == NULL || is_pipe(&__file_table[gfd])) {
+        return -1;
+    }
+    bcache_sync(NULL);
+    return 0;
+}
+
+static delayed_work_t bcache_flush_work;
+
+/* 周期性的写回工作：写回所有脏扇区，回收一直没有被读取的预读，再安排下一次 */
+static void bcache_flush(void* arg UNUSED) {
+    bcache_sync(NULL);
+    bcache_ra_reap();
+    queue_delayed_work(system_wq, &bcache_flush_work, mtime_to_ticks(BCACHE_WRITEBACK_MS));
+}
+
+/* 分配缓存并安排周期性的写回工作 */
+void bcache_init(void) {
+    printk("bcache_init start\n");
+    spin_init(&bcache_spin);
+    list_init(&bcache_lru);
+    list_init(&bcache_ra);
+    uint32_t idx;
+    for(idx = 0; idx < BCACHE_HASH_NR; idx++) {
+        list_init(&bcache_hash[idx]);
+    }
+    /* 在内核线程中调用，缓存位于内核空间，派发线程在任意地址空间都可访问 */
+    bcache_bufs = sys_malloc(BCACHE_NR * sizeof(struct buffer_head));
+    uint8_t* data = get_kernel_pages(DIV_ROUND_UP(BCACHE_NR * SECTOR_SIZE, PG_SIZE));
+    if(bcache_bufs == NULL || data == NULL) {
+        PANIC("bcache_init: allocate memory failed!");
+    }
+    for(idx = 0; idx < BCACHE_NR; idx++) {
+        struct buffer_head* bh = &bcache_bufs[idx];
+        bh->hd = NULL;
+        bh->lba = 0;
+        bh->refcnt = 0;
+        bh->valid = false;
+        bh->dirty = false;
+        bh->reading = false;
+        locker_init(&bh->lock, NULL);
+        bh->data = data + idx * SECTOR_SIZE;
+        list_push_back(&bcache_lru, &bh->lru_tag);
+    }
+    delayed_work_init(&bcache_flush_work, bcache_flush, NULL);
+    queue_delayed_work(system_wq, &bcache_flush_work, mtime_to_ticks(BCACHE_WRITEBACK_MS));
+    printk("bcache_init done\n");
+}
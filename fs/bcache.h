@@ -0,0 +1,56 @@
+#ifndef __FS_BCACHE_H
+#define __FS_BCACHE_H
+
+#include "global.h"
+#include "list.h"
+#include "sync.h"
+#include "blk.h"
+
+#define BCACHE_NR           256     /* 缓存的扇区数 */
+#define BCACHE_HASH_NR      64      /* 哈希桶数 */
+#define BCACHE_BATCH        32      /* 一次同时读入或写回的最多扇区数，请求在队列中合并 */
+#define BCACHE_WRITEBACK_MS 5000    /* 写回工作的周期，脏扇区最多在内存中停留这么久 */
+
+struct disk;
+
+/* 一个扇区的缓存 */
+struct buffer_head {
+    struct disk* hd; /* NULL 表示尚未使用 */
+    uint32_t lba;
+    uint32_t refcnt; /* 使用者数，为 0 时在 lru 队列中，可被替换 */
+    bool valid; /* data 已读入或已被整扇区写入 */
+    bool dirty; /* data 比磁盘新，需要写回 */
+    bool reading; /* 已提交预读尚未被等待，预读持有一个引用，此时在 ra 队列中 */
+    locker_t lock; /* 读入、写回及复制 data 期间持有 */
+    struct list_elem hash_tag;
+    struct list_elem lru_tag;
+    struct list_elem ra_tag;
+    struct blk_request req; /* 读入、写回时提交的请求 */
+    uint8_t* data; /* SECTOR_SIZE 字节，位于内核空间 */
+};
+
+/* 从硬盘 hd 读取从 lba 起 sec_cnt 个扇区到 buf，未命中的扇区同时提交后一起等待 */
+void bcache_read(struct disk* hd, uint32_t lba, void* buf, uint32_t sec_cnt);
+
+/* 异步预读硬盘 hd 上 lbas 中的 cnt 个扇区，提交后立即返回，由之后的 bcache_read 等待完成，取不到缓存的扇区不预读 */
+void bcache_readahead(struct disk* hd, const uint32_t* lbas, uint32_t cnt);
+
+/* 预读可使用的扇区数，可替换的缓存越少越小 */
+uint32_t bcache_ra_budget(void);
+
+/* 将 buf 中 sec_cnt 个扇区写入缓存中 hd 从 lba 起的扇区，由周期性的写回工作或 sync 写到磁盘 */
+void bcache_write(struct disk* hd, uint32_t lba, const void* buf, uint32_t sec_cnt);
+
+/* 将硬盘 hd（NULL 表示所有硬盘）的脏扇区写回并等待完成 */
+void bcache_sync(struct disk* hd);
+
+/* 将所有脏扇区写回磁盘 */
+void sys_sync(void);
+
+/* 将所有脏扇区写回磁盘（文件的数据及元数据可能在任意位置，不单独区分），fd 无效返回 -1，成功返回 0 */
+int32_t sys_fsync(int32_t fd);
+
+/* 分配缓存并安排周期性的写回工作 */
+void bcache_init(void);
+
+#endif /* __FS_BCACHE_H */
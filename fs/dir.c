@@ -1,4 +1,5 @@
 #include "dir.h"
+#include "bcache.h"
 
 extern struct partition* __cur_part; /* 当前操作分区（全局变量） */
 
@@ -40,7 +41,7 @@ bool dentry_search(struct partition* part, struct dir* pdir, const char* name, s
     }
     
     if(pdir->d_inode->i_sectors[12] != 0) {
-        ide_read(part->my_disk, pdir->d_inode->i_sectors[12], all_bcks + 12, 1);
+        bcache_read(part->my_disk, pdir->d_inode->i_sectors[12], all_bcks + 12, 1);
     }
     
     struct dentry* dentry = (struct dentry*)sys_malloc(SECTOR_SIZE);
@@ -51,7 +52,7 @@ bool dentry_search(struct partition* part, struct dir* pdir, const char* name, s
     bck_idx = 0;
     while(bck_idx < bck_cnt) {
         if(all_bcks[bck_idx] != 0) {
-            ide_read(part->my_disk, all_bcks[bck_idx], dentry, 1);
+            bcache_read(part->my_disk, all_bcks[bck_idx], dentry, 1);
             uint32_t dentry_idx = 0;
             while(dentry_idx < dentry_cnt) {
                 if(strcmp(name, (dentry + dentry_idx)->d_filename) == 0) {
@@ -144,27 +145,27 @@ bool dentry_sync(struct dir* parent_dir, struct dentry* dentry,void* io_buf) {
                     bitmap_sync(__cur_part, bck_btmp_idx, BLOCK_BITMAP);
 
                     all_bcks[bck_idx] = bck_lba;
-                    ide_write(__cur_part->my_disk, parent_dir->d_inode->i_sectors[bck_idx], all_bcks + bck_idx, 1);
+                    bcache_write(__cur_part->my_disk, parent_dir->d_inode->i_sectors[bck_idx], all_bcks + bck_idx, 1);
                 }
             } else {
                 all_bcks[bck_idx] = bck_lba;
-                ide_write(__cur_part->my_disk, parent_dir->d_inode->i_sectors[12], all_bcks + 12, 1);
+                bcache_write(__cur_part->my_disk, parent_dir->d_inode->i_sectors[12], all_bcks + 12, 1);
             }
             memset(io_buf, 0, SECTOR_SIZE);
             memcpy(io_buf, dentry, sizeof(struct dentry));
-            ide_write(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
+            bcache_write(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
             parent_dir->d_inode->i_size += sizeof(struct dentry);
             
             // printk("%d: %d + %d\n", parent_dir->d_inode->i_no, parent_dir->d_inode->i_size, sizeof(struct dentry));
             return true;
         } else {
             /* 该 block 已存在，直接读入内存，然后在里面寻找空目录项 */
-            ide_read(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
+            bcache_read(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
             uint8_t dentry_idx = 0;
             while(dentry_idx < (SECTOR_SIZE / sizeof(struct dentry))) {
                 if(FT_UNKNOWN == (dentry_ptr + dentry_idx)->d_ftype) {
                     memcpy(dentry_ptr + dentry_idx, dentry, sizeof(struct dentry));
-                    ide_write(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
+                    bcache_write(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
                     parent_dir->d_inode->i_size += sizeof(struct dentry);
 
                     // printk("%d: %d + %d\n", parent_dir->d_inode->i_no, parent_dir->d_inode->i_size, sizeof(struct dentry));
@@ -192,7 +193,7 @@ struct dentry* dir_read(struct dir* dir) {
         bck_idx++;
     }
     if(dinode->i_sectors[12] != 0) {
-        ide_read(__cur_part->my_disk, dinode->i_sectors[12], all_bcks + 12, 1);
+        bcache_read(__cur_part->my_disk, dinode->i_sectors[12], all_bcks + 12, 1);
         bck_cnt = 140;
     }
 
@@ -209,7 +210,7 @@ struct dentry* dir_read(struct dir* dir) {
 
         if(all_bcks[bck_idx] != 0) {
             bzero(dentry_table, SECTOR_SIZE);
-            ide_read(__cur_part->my_disk, all_bcks[bck_idx], dentry_table, 1);
+            bcache_read(__cur_part->my_disk, all_bcks[bck_idx], dentry_table, 1);
             /* 遍历每个扇区的目录项 */
             dentry_idx = 0;
             while(dentry_idx < dentry_per_sec) {
@@ -243,7 +244,7 @@ bool dentry_delete(struct partition* part, struct dir* parent_dir, uint32_t inod
         bck_idx++;
     }
     if(parent_dir->d_inode->i_sectors[12] != 0) {
-        ide_read(__cur_part->my_disk, parent_dir->d_inode->i_sectors[12], all_bcks + 12, 1);
+        bcache_read(__cur_part->my_disk, parent_dir->d_inode->i_sectors[12], all_bcks + 12, 1);
         bck_cnt = 140;
     }
     bool is_dir_first_bck = false;
@@ -255,7 +256,7 @@ bool dentry_delete(struct partition* part, struct dir* parent_dir, uint32_t inod
         if(all_bcks[0] != 0) {
             /* 读取当前块（一个扇区）的内容 */
             bzero(io_buf, SECTOR_SIZE);
-            ide_read(__cur_part->my_disk, all_bcks[0], io_buf, 1);
+            bcache_read(__cur_part->my_disk, all_bcks[0], io_buf, 1);
 
             for(dentry_idx = 0; dentry_idx < (SECTOR_SIZE / sizeof(struct dentry)); dentry_idx++) {
                 if(FT_UNKNOWN != (dentry_table + dentry_idx)->d_ftype) {
@@ -297,7 +298,7 @@ bool dentry_delete(struct partition* part, struct dir* parent_dir, uint32_t inod
                     if(ext_bck_cnt > 1) {
                         /* 包含多个间接块，仅擦除当前块 */
                         all_bcks[bck_idx] = 0;
-                        ide_write(part->my_disk, parent_dir->d_inode->i_sectors[12], all_bcks + 12, 1);
+                        bcache_write(part->my_disk, parent_dir->d_inode->i_sectors[12], all_bcks + 12, 1);
                     } else {
                         /* 仅包含一个间接块，擦除当前块，且擦除间接索引表地址 */
                         bck_btmp_idx = parent_dir->d_inode->i_sectors[12] - part->sb->data_lba_start;
@@ -310,7 +311,7 @@ bool dentry_delete(struct partition* part, struct dir* parent_dir, uint32_t inod
             } else {
                 /* 仅清楚当前目录项 */
                 bzero(dentry_obj, sizeof(struct dentry));
-                ide_write(part->my_disk, all_bcks[bck_idx], io_buf, 1);
+                bcache_write(part->my_disk, all_bcks[bck_idx], io_buf, 1);
             }
 
             /* 更新到硬盘 */
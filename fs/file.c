@@ -6,6 +6,7 @@
 #include "interrupt.h"
 #include "debug.h"
 #include "fs.h"
+#include "bcache.h"
 
 extern struct partition* __cur_part; /* 当前操作分区（全局变量） */
 
@@ -16,7 +17,7 @@ int32_t get_free_slot_in_global(void) {
     uint32_t fd_idx = 3;
     while(fd_idx < MAX_FILE_OPEN) {
         if(__file_table[fd_idx].fd_inode == NULL) {
-            return (fd_idx - 1);
+            return fd_idx;
         }
         fd_idx++;
     }
@@ -31,8 +32,8 @@ int32_t pcb_fd_install(int32_t global_fd_idx) {
     struct task_struct* cur_thread = thread_running();
     uint8_t local_fd_idx = 3;
     while(local_fd_idx < MAX_FILES_OPEN_PER_PROC) {
-        if(cur_thread->fd_table[local_fd_idx] == -1) {
-            cur_thread->fd_table[local_fd_idx] = global_fd_idx;
+        if(cur_thread->group_leader->fd_table[local_fd_idx] == -1) {
+            cur_thread->group_leader->fd_table[local_fd_idx] = global_fd_idx;
             return local_fd_idx;
         }
         local_fd_idx++;
@@ -88,7 +89,14 @@ void bitmap_sync(struct partition* part, uint32_t bit_idx, uint8_t btmp) {
             break;
         }
     }
-    ide_write(part->my_disk, sec_lba, btmp_off, 1);
+    bcache_write(part->my_disk, sec_lba, btmp_off, 1);
+}
+
+/* 清除 file 的预读状态，从偏移 0 开始读取视为顺序读取 */
+void file_ra_reset(struct file* file) {
+    file->fd_ra_pos = 0;
+    file->fd_ra_start = 0;
+    file->fd_ra_size = 0;
 }
 
 /* 打开编号为 inode_no 的 inode 对应的文件 */
@@ -104,6 +112,8 @@ int32_t file_open(uint32_t inode_no, uint8_t flag) {
     __file_table[fd_idx].fd_inode = inode_open(__cur_part, inode_no);
     __file_table[fd_idx].fd_offset = 0; /* 每次打开让偏移置0 */
     __file_table[fd_idx].fd_flag = flag;
+    __file_table[fd_idx].fd_refs = 1;
+    file_ra_reset(&__file_table[fd_idx]);
 
     bool* write_deny = &__file_table[fd_idx].fd_inode->i_write;
 
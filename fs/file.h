@@ -9,6 +9,10 @@ struct file {
     uint32_t fd_offset; /* 文件内偏移 0 - (filesize-1) */
     uint32_t fd_flag;
     struct inode* fd_inode;
+    uint32_t fd_refs; /* 指向本表项的文件描述符数，fork、dup2 共享表项时增加 */
+    uint32_t fd_ra_pos; /* 上次读取结束的偏移，本次从此处开始读视为顺序读取 */
+    uint32_t fd_ra_start; /* 预读窗口的起始块号 */
+    uint32_t fd_ra_size; /* 预读窗口的块数，0 表示未开启预读 */
 };
 
 enum std_fd {
@@ -25,6 +29,9 @@ enum bitmap_type {
 
 #define MAX_FILE_OPEN 32 /* 系统可打开的最大文件数 */
 
+#define FILE_RA_MIN 4   /* 开始顺序读取时的预读块数 */
+#define FILE_RA_MAX 64  /* 预读窗口最多块数，每读到一个窗口翻倍直到此值 */
+
 /* 从文件表 file_table 中获取一个空闲位，成功返回下表，失败返回 -1 */
 int32_t get_free_slot_in_global(void);
 
@@ -40,6 +47,9 @@ int32_t block_bitmap_alloc(struct partition* part);
 /* 将内存中 bitmap 第 bit_idx 位所在的 512 字节同步到硬盘 */
 void bitmap_sync(struct partition* part, uint32_t bit_idx, uint8_t btmp);
 
+/* 清除 file 的预读状态，从偏移 0 开始读取视为顺序读取 */
+void file_ra_reset(struct file* file);
+
 /* 打开编号为 inode_no 的 inode 对应的文件 */
 int32_t file_open(uint32_t inode_no, uint8_t flag);
 
@@ -7,6 +7,9 @@
 #include "inode.h"
 #include "string.h"
 #include "keyboard.h"
+#include "pipe.h"
+#include "exec.h"
+#include "bcache.h"
 
 extern uint8_t channel_cnt; /* 按硬盘数计算的通道数 */
 extern struct ide_channel channels[2]; /* 有两个ide通道 */
@@ -74,7 +77,7 @@ static void partition_format(struct partition* part) {
     
     /* 1. 将超级块写入本分区的 1 号扇区(0 号扇区为引导扇区） */
     struct disk* cur_hd = part->my_disk;
-    ide_write(cur_hd, part->lba_start + 1, &sb, 1);
+    bcache_write(cur_hd, part->lba_start + 1, &sb, 1);
     printk("    super_block_lba:0x%x\n", part->lba_start + 1);
 
     /* 找到数据中占用扇区最大的值 * SECTOR_SIZE (字节) 作为缓冲区大小 */
@@ -99,14 +102,14 @@ static void partition_format(struct partition* part) {
     /* 将位图所能表示范围之外的字节全部置为1 */
     memset(buf + bck_btmp_last_byte + 1, 0xff, last_sec_rest_size);
     /* 将初始化好的内容写入对应扇区 */
-    ide_write(cur_hd, sb.bck_btmp_lba_base, buf, sb.bck_btmp_sec_cnt);
+    bcache_write(cur_hd, sb.bck_btmp_lba_base, buf, sb.bck_btmp_sec_cnt);
 
     /* 3. 初始化 inode 位图并写入对应扇区 */
     /* 清空缓冲 */
     memset(buf, 0, buf_size);
     /* inode 位图刚好为 1 扇区(4096位） */
     buf[0] |= 0x01; /* 根目录位置，占位 */
-    ide_write(cur_hd, sb.inode_btmp_lba_base, buf, sb.inode_btmp_sec_cnt);
+    bcache_write(cur_hd, sb.inode_btmp_lba_base, buf, sb.inode_btmp_sec_cnt);
 
     /* 4. 将 inode 数组初始化并写入对应扇区*/
     /* 清空缓冲 */
@@ -117,7 +120,7 @@ static void partition_format(struct partition* part) {
     idx_node->i_no = 0;
     /* i_sectors 已经被清除为0 */
     idx_node->i_sectors[0] = sb.data_lba_start;
-    ide_write(cur_hd, sb.inode_table_lba_base, buf, sb.inode_table_sec_cnt);
+    bcache_write(cur_hd, sb.inode_table_lba_base, buf, sb.inode_table_sec_cnt);
 
     /* 5. 将根目录写入空闲数据的起始扇区 sb.data_lba_start */
     /* 清空缓冲 */
@@ -135,7 +138,7 @@ static void partition_format(struct partition* part) {
     dir_entry->d_inode_no = 0;
     dir_entry->d_ftype = FT_DIRECTORY;
 
-    ide_write(cur_hd, sb.data_lba_start, buf, 1);
+    bcache_write(cur_hd, sb.data_lba_start, buf, 1);
 
     printk("    root_dir_lba:0x%x\n", sb.data_lba_start);
     printk("%s format done\n", part->name);
@@ -152,7 +155,7 @@ static bool mount_partition(struct list_elem* pelem, void* arg) {
         struct disk* hd = part->my_disk;
         struct super_block* sb_buf = (struct super_block*)sys_malloc(SECTOR_SIZE);
         memset(sb_buf, 0, SECTOR_SIZE);
-        ide_read(hd, part->lba_start + 1, sb_buf, 1);
+        bcache_read(hd, part->lba_start + 1, sb_buf, 1);
 
         part->sb = (struct super_block*)sys_malloc(sizeof(struct super_block));
         if(part->sb == NULL) {
@@ -167,7 +170,7 @@ static bool mount_partition(struct list_elem* pelem, void* arg) {
             PANIC("allocate memory failed!");
         }
         part->bck_btmp.btmp_bytes_len = sb_buf->bck_btmp_sec_cnt * SECTOR_SIZE;
-        ide_read(hd, sb_buf->bck_btmp_lba_base, part->bck_btmp.bits, sb_buf->bck_btmp_sec_cnt);
+        bcache_read(hd, sb_buf->bck_btmp_lba_base, part->bck_btmp.bits, sb_buf->bck_btmp_sec_cnt);
 
         /* 3 读入 inode 位图到内存 */
         part->inode_btmp.bits = (uint8_t*)sys_malloc(sb_buf->inode_btmp_sec_cnt * SECTOR_SIZE);
@@ -175,7 +178,7 @@ static bool mount_partition(struct list_elem* pelem, void* arg) {
             PANIC("allocate memory failed!");
         }
         part->inode_btmp.btmp_bytes_len = sb_buf->inode_btmp_sec_cnt * SECTOR_SIZE;
-        ide_read(hd, sb_buf->inode_btmp_lba_base, part->inode_btmp.bits, sb_buf->inode_btmp_sec_cnt);
+        bcache_read(hd, sb_buf->inode_btmp_lba_base, part->inode_btmp.bits, sb_buf->inode_btmp_sec_cnt);
 
         list_init(&part->open_inodes);
         printk("mount %s done!\n", part->name);
@@ -307,6 +310,8 @@ int32_t file_create(struct dir* parent_dir, char* filename, uint8_t flags) {
     __file_table[fd_idx].fd_inode = new_file_inode;
     __file_table[fd_idx].fd_offset = 0;
     __file_table[fd_idx].fd_flag = flags;
+    __file_table[fd_idx].fd_refs = 1;
+    file_ra_reset(&__file_table[fd_idx]);
     __file_table[fd_idx].fd_inode->i_write = false;
 
     /* 创建目录项 */
@@ -403,7 +408,7 @@ ssize_t file_write(struct file* file, const void* buf, size_t count) {
         } else {
             /* 读入间接块地址 */
             ASSERT(file->fd_inode->i_sectors[12] != 0);
-            ide_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
+            bcache_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
         }
     } else { /* 需要增加块 */
         if(file_will_use_bcks < 13) {
@@ -452,12 +457,12 @@ ssize_t file_write(struct file* file, const void* buf, size_t count) {
                 bitmap_sync(__cur_part, bck_lba - __cur_part->sb->data_lba_start, BLOCK_BITMAP);
                 bck_idx++;
             }
-            ide_write(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
+            bcache_write(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
         } else if(file_used_bcks > 12) {
             /* 情况3：旧数据已经使用过间接块 */
             ASSERT(file->fd_inode->i_sectors[12] != 0);
             /* 读入所有间接块内容到 all_bcks */
-            ide_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
+            bcache_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
             bck_idx = file_used_bcks;
             while(bck_idx < file_will_use_bcks) {
                 bck_lba = block_bitmap_alloc(__cur_part);
@@ -469,7 +474,7 @@ ssize_t file_write(struct file* file, const void* buf, size_t count) {
                 bitmap_sync(__cur_part, bck_lba - __cur_part->sb->data_lba_start, BLOCK_BITMAP);
                 bck_idx++;
             }
-            ide_write(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
+            bcache_write(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
         }
     }
     
@@ -492,11 +497,11 @@ ssize_t file_write(struct file* file, const void* buf, size_t count) {
 
         chunk_size = bytes_rest < sec_bytes_rest ? bytes_rest : sec_bytes_rest;
         if(first_write_bck) {
-            ide_read(__cur_part->my_disk, sec_lba, io_buf, 1);
+            bcache_read(__cur_part->my_disk, sec_lba, io_buf, 1);
             first_write_bck = false;
         }
         memcpy(io_buf + sec_bytes_off, src, chunk_size);
-        ide_write(__cur_part->my_disk, sec_lba, io_buf, 1);
+        bcache_write(__cur_part->my_disk, sec_lba, io_buf, 1);
 
         src += chunk_size;
         file->fd_inode->i_size += chunk_size;
@@ -513,6 +518,44 @@ ssize_t file_write(struct file* file, const void* buf, size_t count) {
     return bytes_written;
 }
 
+/* 异步提交 file 的块 [idx_start, idx_last] 及预读窗口，之后逐块读取时在缓存中等待完成
+ * 从上次结束处继续读取视为顺序读取：读到预读窗口时在其后提交下一个窗口，窗口翻倍直到 FILE_RA_MAX；
+ * 随机读取则关闭预读。提交的块数不超过缓存余量，避免预读挤掉尚未读取的预读块 */
+static void file_readahead(struct file* file, const uint32_t* all_bcks, uint32_t bck_cnt, uint32_t idx_start, uint32_t idx_last) {
+    struct disk* hd = __cur_part->my_disk;
+    uint32_t budget = bcache_ra_budget();
+    if(idx_last > idx_start) {
+        /* 本次读取多块，一起提交，相邻扇区在队列中合并 */
+        uint32_t cnt = idx_last - idx_start + 1;
+        cnt = cnt < budget ? cnt : budget;
+        bcache_readahead(hd, all_bcks + idx_start, cnt);
+        budget -= cnt;
+    }
+
+    if(file->fd_offset != file->fd_ra_pos) {
+        file->fd_ra_start = 0;
+        file->fd_ra_size = 0;
+        return;
+    }
+    if(file->fd_ra_size != 0 && idx_last < file->fd_ra_start) {
+        return; /* 尚未读到当前窗口 */
+    }
+    uint32_t ra_end = file->fd_ra_start + file->fd_ra_size;
+    file->fd_ra_start = idx_last + 1 > ra_end ? idx_last + 1 : ra_end;
+    file->fd_ra_size = file->fd_ra_size == 0 ? FILE_RA_MIN : file->fd_ra_size * 2;
+    if(file->fd_ra_size > FILE_RA_MAX) {
+        file->fd_ra_size = FILE_RA_MAX;
+    }
+    if(file->fd_ra_size > budget) {
+        file->fd_ra_size = budget; /* 缓存紧张时缩小窗口，为 0 时下次重新开始 */
+    }
+    if(file->fd_ra_start < bck_cnt) {
+        uint32_t cnt = bck_cnt - file->fd_ra_start;
+        cnt = cnt < file->fd_ra_size ? cnt : file->fd_ra_size;
+        bcache_readahead(hd, all_bcks + file->fd_ra_start, cnt);
+    }
+}
+
 /* 从 file 连续读取 count 个字节到 buf, 成功则返回读到的字节数，失败或到达文件末尾则返回 -1 */
     /* 如果读取的字节数 count 超过剩余字节数，返回剩余的全部字节数，若到达文件末尾，返回-1 */
 ssize_t file_read(struct file* file, void* buf, size_t count) {
@@ -535,36 +578,19 @@ ssize_t file_read(struct file* file, void* buf, size_t count) {
         return -1;
     }
 
-    /* 判断本次读入数据是否跨扇区 */
+    /* 收集文件所有块的地址：直接块，以及存在时的间接块（通常已在缓存中），预读时需要后续块的地址 */
     uint32_t bck_idx_start = file->fd_offset / BLOCK_SIZE;
-    uint32_t bck_idx_end = (file->fd_offset + size) / BLOCK_SIZE;
-    uint32_t bck_idx = 0;
-    if(bck_idx_start == bck_idx_end) { /* 数据不跨扇区 */
-       if(bck_idx_start < 12) { /* 直接块 */
-            bck_idx = bck_idx_start;
-            all_bcks[bck_idx] = file->fd_inode->i_sectors[bck_idx];
-       } else { /* 1级间接块 */
-            ide_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
-       } 
-    } else {
-        if(bck_idx_end < 12) {
-            /* 1 数据仍都在直接块 */
-            for(bck_idx = bck_idx_start; bck_idx <= bck_idx_end; bck_idx++) {
-                all_bcks[bck_idx] = file->fd_inode->i_sectors[bck_idx];
-            }
-        } else if(bck_idx_start < 12 && bck_idx_end >= 12) {
-            /* 2 数据在直接块和间接块 */
-            for(bck_idx = bck_idx_start; bck_idx <= 12; bck_idx++) {
-                all_bcks[bck_idx] = file->fd_inode->i_sectors[bck_idx];
-            }
-            ASSERT(file->fd_inode->i_sectors[12] != 0);
-            ide_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
-        }else {
-            /* 3 数据在间接块 */
-            ASSERT(file->fd_inode->i_sectors[12] != 0);
-            ide_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
-        }
+    uint32_t bck_idx_last = (file->fd_offset + size - 1) / BLOCK_SIZE; /* 本次读取的最后一块 */
+    uint32_t bck_cnt = DIV_ROUND_UP(file->fd_inode->i_size, BLOCK_SIZE);
+    uint32_t bck_idx;
+    for(bck_idx = 0; bck_idx < 12; bck_idx++) {
+        all_bcks[bck_idx] = file->fd_inode->i_sectors[bck_idx];
+    }
+    if(bck_cnt > 12) {
+        ASSERT(file->fd_inode->i_sectors[12] != 0);
+        bcache_read(__cur_part->my_disk, file->fd_inode->i_sectors[12], all_bcks + 12, 1);
     }
+    file_readahead(file, all_bcks, bck_cnt, bck_idx_start, bck_idx_last);
 
     /* 读取数据 */
     uint32_t sec_lba; /* 扇区地址 */
@@ -584,7 +610,7 @@ ssize_t file_read(struct file* file, void* buf, size_t count) {
         chunk_size = sec_bytes_rest < byte_rest ? sec_bytes_rest : byte_rest;
 
         bzero(io_buf, BLOCK_SIZE);
-        ide_read(__cur_part->my_disk, sec_lba, io_buf, 1);
+        bcache_read(__cur_part->my_disk, sec_lba, io_buf, 1);
         memcpy(dst_buf, io_buf + sec_bytes_off, chunk_size);
 
         dst_buf += chunk_size;
@@ -592,6 +618,7 @@ ssize_t file_read(struct file* file, void* buf, size_t count) {
         byte_read += chunk_size;
         byte_rest -= chunk_size;
     }
+    file->fd_ra_pos = file->fd_offset;
     sys_free(all_bcks);
     sys_free(io_buf);
     return byte_read;
@@ -604,7 +631,7 @@ int32_t sys_open(const char* pathname, uint8_t flags) {
         return -1;
     }
     
-    ASSERT(flags <= 16);
+    ASSERT(flags <= (O_RDONLY | O_WRONLY | O_RDWR | O_CREAT | O_NONBLOCK));
     int32_t fd = -1;
 
     /*  1. 检查文件是否存在，如果中间有目录未找到则报错；
@@ -653,40 +680,83 @@ int32_t sys_open(const char* pathname, uint8_t flags) {
     return fd;
 }
 
-/* 将文件描述符转化为文件表的下标 */
-static uint32_t fd_local2global(uint32_t localfd) {
-    struct task_struct* cur_thread = thread_running();
-    int32_t globalfd = cur_thread->fd_table[localfd];
-    ASSERT(globalfd >= 0 && globalfd < MAX_FILE_OPEN);
-    return (uint32_t)globalfd;
+/* 将文件描述符转化为文件表的下标，描述符无效返回 -1 */
+int32_t fd_local2global(int32_t localfd) {
+    if(localfd < 0 || localfd >= MAX_FILES_OPEN_PER_PROC) {
+        return -1;
+    }
+    int32_t globalfd = thread_running()->group_leader->fd_table[localfd];
+    ASSERT(globalfd >= -1 && globalfd < MAX_FILE_OPEN);
+    return globalfd;
+}
+
+/* 释放一个文件表项引用，最后一个引用关闭文件（管道一端） */
+static int32_t file_put(int32_t gfd) {
+    if(gfd <= stderr_no) {
+        return 0; /* 标准输入输出不占用文件表项 */
+    }
+    struct file* file = __file_table + gfd;
+    ASSERT(file->fd_refs > 0);
+    if(--file->fd_refs > 0) {
+        return 0;
+    }
+    if(is_pipe(file)) {
+        pipe_release(file);
+        return 0;
+    }
+    return file_close(file);
 }
 
 /* 关闭文件描述符 fd 指向的文件，成功返回 0，否则返回 -1 */
 int32_t sys_close(int32_t fd) {
-    int32_t ret = -1;
-    if(fd > 2) {
-        uint32_t gfd = fd_local2global(fd);
-        ret = file_close(__file_table + gfd);
-        thread_running()->fd_table[fd] = -1;
+    int32_t gfd = fd_local2global(fd);
+    if(gfd == -1) {
+        return -1;
     }
-    return ret;
+    thread_running()->group_leader->fd_table[fd] = -1;
+    return file_put(gfd);
+}
+
+/* 让 newfd 指向 oldfd 的文件，newfd 原先打开的文件先被关闭，成功返回 newfd，失败返回 -1 */
+int32_t sys_dup2(int32_t oldfd, int32_t newfd) {
+    int32_t gfd = fd_local2global(oldfd);
+    if(gfd == -1 || newfd < 0 || newfd >= MAX_FILES_OPEN_PER_PROC) {
+        return -1;
+    }
+    if(oldfd == newfd) {
+        return newfd;
+    }
+    int32_t* fd_table = thread_running()->group_leader->fd_table;
+    if(fd_table[newfd] != -1) {
+        sys_close(newfd);
+    }
+    if(gfd > stderr_no) {
+        __file_table[gfd].fd_refs++;
+    }
+    fd_table[newfd] = gfd;
+    return newfd;
 }
 
 /* 将 buf 中连续 count 字节写入 fd，成功返回写入的字节数，失败返回 -1 */
 ssize_t sys_write(int fd, const void* buf, size_t count) {
-    if(fd < 0) {
+    /* 按文件表下标区分设备，dup2 重定向后的描述符同样适用 */
+    int32_t gfd = fd_local2global(fd);
+    if(gfd == -1 || gfd == stdin_no) {
         printk("sys_write: fd %d error\n", fd);
         return -1;
     }
-    if(fd == stdout_no) {
+    if(gfd == stdout_no || gfd == stderr_no) {
         char* str = (char*)buf;
         console_put_str(str);
         return count;
     }
     /* 通过 fd 找到全局文件表中的文件 */
-    int gfd = fd_local2global(fd);
     struct file* wr_file = __file_table + gfd;
+    if(is_pipe(wr_file)) {
+        return pipe_write(wr_file, buf, count);
+    }
     if(O_RDWR & wr_file->fd_flag || O_WRONLY & wr_file->fd_flag) {
+        exec_cache_invalidate(wr_file->fd_inode->i_no);
         return file_write(wr_file, buf, count);
     } else {
         console_put_str("sys_write: not allowed to write file without flag O_RDWR or O_WRONLY\n") ;
@@ -698,30 +768,28 @@ ssize_t sys_write(int fd, const void* buf, size_t count) {
 ssize_t sys_read(int fd, void* buf, size_t count) {
     ASSERT(buf != NULL);
     int32_t ret = -1;
-    if(fd < 0 || stdout_no == fd || stderr_no == fd) {
+    int32_t gfd = fd_local2global(fd);
+    if(gfd == -1 || stdout_no == gfd || stderr_no == gfd) {
         printk ("sys_read: fd error\n");
-    } else if(stdin_no == fd) {
-        char* buffer = (char*)buf;
-        uint32_t bytes_read = 0;
-        while(bytes_read < count) {
-            *buffer++ = ioq_getchar(&__kbd_buf);
-            bytes_read++;
-        }
-        ret = bytes_read == 0 ? -1 : (ssize_t)bytes_read;
+    } else if(stdin_no == gfd) {
+        /* 成块读出，缓冲区空时阻塞 */
+        ioq_read(&__kbd_buf, buf, count);
+        ret = count == 0 ? -1 : (ssize_t)count;
+    } else if(is_pipe(__file_table + gfd)) {
+        ret = pipe_read(__file_table + gfd, buf, count);
     } else {
-        ret = file_read(__file_table + fd_local2global(fd), buf, count);
+        ret = file_read(__file_table + gfd, buf, count);
     }
     return ret;
 }
 
 /* The  lseek()  function  repositions the offset of the open file associated with the file descriptor fd to the argument offset according to the directive whence*/
 off_t sys_lseek(int fd, off_t offset, uint8_t whence) {
-    if(fd < 0) {
+    int32_t gfd = fd_local2global(fd);
+    if(gfd <= stderr_no || is_pipe(&__file_table[gfd])) {
         printk("sys_lseek: fd error\n");
         return -1;
     }
-
-    uint32_t gfd = fd_local2global(fd);
     struct file* file = &__file_table[gfd];
     off_t new_off = 0;
     switch(whence) {
@@ -754,6 +822,8 @@ void filesys_init(void) {
     uint8_t dev_no = 0;
     uint8_t part_idx = 0;
 
+    bcache_init();
+
     /* 获取硬盘上的超级块，没有超级块则说明没有文件系统 */
     struct super_block* sb_buf = (struct super_block*)sys_malloc(SECTOR_SIZE);
     if(sb_buf == NULL) {
@@ -777,7 +847,7 @@ void filesys_init(void) {
                 }
                 if(cur_part->sec_cnt != 0) {
                     memset(sb_buf, 0, SECTOR_SIZE);
-                    ide_read(hd, cur_part->lba_start + 1, sb_buf, 1);
+                    bcache_read(hd, cur_part->lba_start + 1, sb_buf, 1);
                     // if(SUPER_BLOCK_MAGIC == sb_buf->s_magic) {
                     //     /* 已存在文件系统 */
                     //     printk("%s has file system\n", cur_part->name);
@@ -814,7 +884,7 @@ static uint32_t get_parent_dir_inode_nr(uint32_t child_inode_nr, void* io_buf) {
     struct inode* child_dir_inode = inode_open(__cur_part, child_inode_nr);
     uint32_t bck_lba = child_dir_inode->i_sectors[0];
     inode_close(child_dir_inode);
-    ide_read(__cur_part->my_disk, bck_lba, io_buf, 1);
+    bcache_read(__cur_part->my_disk, bck_lba, io_buf, 1);
 
     /* 第 0 个目录项为 '.'，第 2 个目录项为 '..' */
     struct dentry* dentry = ((struct dentry*)io_buf);
@@ -833,7 +903,7 @@ static int get_child_dir_name(uint32_t parent_inode_nr, uint32_t child_inode_nr,
         bck_idx++;
     }
     if(parent_dir_inode->i_sectors[12] != 0) {
-        ide_read(__cur_part->my_disk, parent_dir_inode->i_sectors[12], all_bcks + 12, 1);
+        bcache_read(__cur_part->my_disk, parent_dir_inode->i_sectors[12], all_bcks + 12, 1);
         bck_cnt = 140;
     }
     inode_close(parent_dir_inode);
@@ -843,7 +913,7 @@ static int get_child_dir_name(uint32_t parent_inode_nr, uint32_t child_inode_nr,
     uint32_t dentry_size_per_bck = (BLOCK_SIZE / __cur_part->sb->s_dentry_size);
     while(bck_idx < bck_cnt) {
         if(all_bcks[bck_idx] != 0) {
-            ide_read(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
+            bcache_read(__cur_part->my_disk, all_bcks[bck_idx], io_buf, 1);
             uint32_t dentry_idx = 0;
             while(dentry_idx < dentry_size_per_bck) {
                 // printk("%d %d %s\n", bck_idx, dentry->d_inode_no, dentry->d_filename);
@@ -930,7 +1000,7 @@ int sys_mkdir(const char* pathname) {
         dentry->d_ftype = FT_DIRECTORY;
         dentry->d_inode_no = searched_record.parent_dir->d_inode->i_no;
         
-        ide_write(__cur_part->my_disk, bck_lba, io_buf, 1);
+        bcache_write(__cur_part->my_disk, bck_lba, io_buf, 1);
         new_dir_inode.i_size = __cur_part->sb->s_dentry_size * 2;
 
         /* 在父目录中添加自己的目录项 */
@@ -1081,7 +1151,7 @@ int sys_unlink(const char* pathname) {
     /* 如果当前文件处于打开的状态不允许删除 */
     uint32_t file_idx = 0;
     for(; file_idx < MAX_FILE_OPEN; file_idx++) {
-        if(__file_table[file_idx].fd_inode != NULL && (uint32_t)inode_no == __file_table[file_idx].fd_inode->i_no) {
+        if(__file_table[file_idx].fd_inode != NULL && !is_pipe(&__file_table[file_idx]) && (uint32_t)inode_no == __file_table[file_idx].fd_inode->i_no) {
             dir_close(searched_record.parent_dir);
             printk("file %s is inuse, not allow to delete!\n", pathname);
             return -1;
@@ -1096,6 +1166,7 @@ int sys_unlink(const char* pathname) {
     /* 删除 */
     dentry_delete(__cur_part, searched_record.parent_dir, inode_no, io_buf);
     inode_release(__cur_part, inode_no);
+    exec_cache_invalidate(inode_no);
     sys_free(io_buf);
     dir_close(searched_record.parent_dir);
     return 0;
@@ -1110,7 +1181,7 @@ char* sys_getcwd(char* buf, size_t size) {
         return NULL;
     }
 
-    int32_t child_inode_nr = thread_running()->cwd_inode_nr;
+    int32_t child_inode_nr = thread_running()->group_leader->cwd_inode_nr;
     ASSERT(child_inode_nr >= 0 && child_inode_nr < 4096) ;
     bzero(buf, size);
     if(child_inode_nr == 0) { /* 根目录 */
@@ -1151,7 +1222,7 @@ int sys_chdir(const char* path) {
     int inode_no = file_search(path, &searched_record);
     if(inode_no != -1) {
         if(FT_DIRECTORY == searched_record.p_ftype) {
-            thread_running()->cwd_inode_nr = inode_no;
+            thread_running()->group_leader->cwd_inode_nr = inode_no;
             ret = 0;
         } else {
             printk("sys_chdir : %s is regular file or other!\n", path);
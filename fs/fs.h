@@ -23,7 +23,8 @@ enum oflags {
     O_RDONLY = 1, /* 只读 */
     O_WRONLY = 2, /* 只写 */
     O_RDWR = 4, /* 读写 */
-    O_CREAT = 8 /* 创建 */
+    O_CREAT = 8, /* 创建 */
+    O_NONBLOCK = 16 /* 非阻塞：没有数据（空间）时读写立即返回 -1，不等待 */
 };
 
 /* offset */
@@ -65,9 +66,15 @@ ssize_t file_read(struct file* file, void* buf, size_t count);
 /* 成功打开或创建文件后，返回文件描述符，否则返回 -1 */
 int32_t sys_open(const char* pathname, uint8_t flags);
 
+/* 将文件描述符转化为文件表的下标，描述符无效返回 -1 */
+int32_t fd_local2global(int32_t localfd);
+
 /* 关闭文件描述符 fd 指向的文件，成功返回 0，否则返回 -1 */
 int32_t sys_close(int32_t fd);
 
+/* 让 newfd 指向 oldfd 的文件，newfd 原先打开的文件先被关闭，成功返回 newfd，失败返回 -1 */
+int32_t sys_dup2(int32_t oldfd, int32_t newfd);
+
 /* 将 buf 中连续 count 字节写入 fd，成功返回写入的字节数，失败返回 -1 */
 ssize_t sys_write(int fd, const void* buf, size_t count);
 
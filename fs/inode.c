@@ -5,6 +5,7 @@
 #include "interrupt.h"
 #include "stdio_kernel.h"
 #include "debug.h"
+#include "bcache.h"
 
 /* 用于存储 inode 位置 */
 struct inode_position {
@@ -45,9 +46,9 @@ void inode_sync(struct partition* part, struct inode* inode, void* io_buf) {
     char* inode_buf = (char*)io_buf;
     /* 读写扇区是以扇区为单位，写入数据不足一扇区时，需将原先的内容全部读出，加入新内容后在一并写入 */
     uint8_t sec_cnt = inode_pos.sec_cnt;
-    ide_read(part->my_disk, inode_pos.sec_lba_base, inode_buf, sec_cnt);
+    bcache_read(part->my_disk, inode_pos.sec_lba_base, inode_buf, sec_cnt);
     memcpy((inode_buf + inode_pos.off_size), &pure_inode, sizeof(struct inode));
-    ide_write(part->my_disk, inode_pos.sec_lba_base, inode_buf, sec_cnt);
+    bcache_write(part->my_disk, inode_pos.sec_lba_base, inode_buf, sec_cnt);
 }
 
 /* 找到符合条件的 inode 节点 */
@@ -80,7 +81,7 @@ struct inode* inode_open(struct partition* part, uint32_t inode_no) {
         /* 从扇区读取到缓冲区，再将缓冲区数据写入 inode 节点 */
         char* inode_buf;
         inode_buf = (char*)sys_malloc(SECTOR_SIZE * inode_pos.sec_cnt);
-        ide_read(part->my_disk, inode_pos.sec_lba_base, inode_buf, inode_pos.sec_cnt);
+        bcache_read(part->my_disk, inode_pos.sec_lba_base, inode_buf, inode_pos.sec_cnt);
         memcpy(inode, inode_buf + inode_pos.off_size, sizeof(struct inode));
         sys_free(inode_buf);
 
@@ -134,9 +135,9 @@ void inode_delete(struct partition* part, uint32_t inode_no, void* io_buf) {
     ASSERT(inode_pos.sec_lba_base <= part->lba_start + part->sec_cnt);
 
     char* buf = (char*)io_buf;
-    ide_read(part->my_disk, inode_pos.sec_lba_base, buf, inode_pos.sec_cnt);
+    bcache_read(part->my_disk, inode_pos.sec_lba_base, buf, inode_pos.sec_cnt);
     bzero(buf + inode_pos.off_size, sizeof(struct inode));
-    ide_write(part->my_disk, inode_pos.sec_lba_base, buf, inode_pos.sec_cnt);
+    bcache_write(part->my_disk, inode_pos.sec_lba_base, buf, inode_pos.sec_cnt);
 }
 
 /* 回收 inode 数据块及其本身 */
@@ -156,7 +157,7 @@ void inode_release(struct partition* part, uint32_t inode_no) {
     }
     /* 1.2 如果一级间接表存在，记录 128 个间接块地址，并释放一级间接块索引表地址 */
     if(inode->i_sectors[12] != 0) {
-        ide_read(part->my_disk, inode->i_sectors[12], all_bcks + 12, 1);
+        bcache_read(part->my_disk, inode->i_sectors[12], all_bcks + 12, 1);
         bck_cnt = 140;
 
         bck_btmp_idx = inode->i_sectors[12] - part->sb->data_lba_start;
@@ -0,0 +1,103 @@
+#include "poll.h"
+#include "fs.h"
+#include "file.h"
+#include "pipe.h"
+#include "ioqueue.h"
+#include "waitqueue.h"
+#include "timer.h"
+#include "debug.h"
+
+extern struct file __file_table[MAX_FILE_OPEN]; /* 文件表 */
+extern ioqueue_t __kbd_buf; /* keyboard buffer */
+extern uint32_t ticks;
+
+/* 描述符 fd 当前的就绪状态，*pwq 返回状态变化时会被唤醒的等待队列，没有则为 NULL */
+static uint16_t fd_poll(int32_t fd, wait_queue_t** pwq) {
+    *pwq = NULL;
+    int32_t gfd = fd_local2global(fd);
+    if(gfd == -1) {
+        return POLLNVAL;
+    }
+    if(gfd == stdin_no) {
+        *pwq = &__kbd_buf.pollq;
+        return ioq_empty(&__kbd_buf) ? 0 : POLLIN;
+    }
+    if(gfd == stdout_no || gfd == stderr_no) {
+        return POLLOUT; /* 控制台总是可写 */
+    }
+    struct file* file = __file_table + gfd;
+    if(is_pipe(file)) {
+        return pipe_poll(file, pwq);
+    }
+    /* 普通文件的读写只等待硬盘，总是就绪 */
+    return POLLIN | POLLOUT;
+}
+
+/* 检查所有描述符，填写 revents，返回就绪的描述符数 */
+static int32_t poll_scan(struct pollfd* fds, uint32_t nfds, wait_queue_t** queues) {
+    int32_t ready = 0;
+    uint32_t idx;
+    for(idx = 0; idx < nfds; idx++) {
+        uint16_t mask = fd_poll(fds[idx].fd, &queues[idx]);
+        fds[idx].revents = mask & (fds[idx].events | POLLERR | POLLHUP | POLLNVAL);
+        if(fds[idx].revents != 0) {
+            ready++;
+        }
+    }
+    return ready;
+}
+
+/* 
+ * 等待 fds 中任一描述符就绪，timeout 为毫秒，-1 表示一直等待，0 表示只检查不等待
+ * 返回就绪的描述符数，超时返回 0，出错返回 -1
+ */
+int32_t sys_poll(struct pollfd* fds, uint32_t nfds, int32_t timeout) {
+    if(nfds > POLL_MAX_FDS || (fds == NULL && nfds != 0)) {
+        return -1;
+    }
+    wait_queue_t* queues[POLL_MAX_FDS];
+    int32_t ready = poll_scan(fds, nfds, queues);
+    if(ready != 0 || timeout == 0) {
+        return ready;
+    }
+
+    /* 先挂到所有等待队列上，之后的状态变化都会唤醒本任务，再重新检查 */
+    waiter_t waiter;
+    waiter_init(&waiter);
+    struct wait_entry entries[POLL_MAX_FDS];
+    wait_queue_t* registered[POLL_MAX_FDS]; /* 登记过的队列，之后的检查会改写 queues */
+    uint32_t idx;
+    for(idx = 0; idx < nfds; idx++) {
+        registered[idx] = queues[idx];
+        if(registered[idx] != NULL) {
+            wait_queue_add(registered[idx], &entries[idx], &waiter);
+        }
+    }
+
+    uint32_t timeout_ticks = timeout > 0 ? mtime_to_ticks(timeout) : 0;
+    uint32_t start = ticks;
+    while(1) {
+        waiter_prepare(&waiter);
+        ready = poll_scan(fds, nfds, queues);
+        if(ready != 0) {
+            break;
+        }
+        uint32_t remain = 0;
+        if(timeout > 0) {
+            uint32_t elapsed = ticks - start;
+            if(elapsed >= timeout_ticks) {
+                break;
+            }
+            remain = timeout_ticks - elapsed;
+        }
+        /* 唤醒可能是虚假的，醒来后重新检查 */
+        waiter_sleep(&waiter, remain);
+    }
+
+    for(idx = 0; idx < nfds; idx++) {
+        if(registered[idx] != NULL) {
+            wait_queue_del(registered[idx], &entries[idx]);
+        }
+    }
+    return ready;
+}
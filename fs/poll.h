@@ -0,0 +1,29 @@
+#ifndef __FS_POLL_H
+#define __FS_POLL_H
+
+#include "stdint.h"
+#include "global.h"
+
+/* poll 事件 */
+#define POLLIN      0x01 /* 有数据可读 */
+#define POLLOUT     0x04 /* 可以写入 */
+#define POLLERR     0x08 /* 出错，如管道读端全部关闭 */
+#define POLLHUP     0x10 /* 对端挂断，如管道写端全部关闭 */
+#define POLLNVAL    0x20 /* 描述符无效 */
+
+#define POLL_MAX_FDS 16 /* 一次 poll 最多的描述符数 */
+
+/* 要检查的描述符及事件 */
+struct pollfd {
+    int32_t fd;
+    int16_t events; /* 关心的事件 */
+    int16_t revents; /* 返回发生的事件，POLLERR、POLLHUP、POLLNVAL 总会返回 */
+};
+
+/* 
+ * 等待 fds 中任一描述符就绪，timeout 为毫秒，-1 表示一直等待，0 表示只检查不等待
+ * 返回就绪的描述符数，超时返回 0，出错返回 -1
+ */
+int32_t sys_poll(struct pollfd* fds, uint32_t nfds, int32_t timeout);
+
+#endif /* __FS_POLL_H */
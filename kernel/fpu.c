@@ -0,0 +1,137 @@
+#include "fpu.h"
+#include "interrupt.h"
+#include "print.h"
+#include "debug.h"
+#include "smp.h"
+
+#define CR0_MP      0x00000002  /* monitor coprocessor : 配合 TS 使 wait/fwait 也触发 #NM */
+#define CR0_EM      0x00000004  /* emulation : 置 1 时 FPU 指令触发 #NM，SSE 指令触发 #UD */
+#define CR0_TS      0x00000008  /* task switched */
+#define CR0_NE      0x00000020  /* x87 浮点错误以 #MF 异常报告 */
+#define CR4_OSFXSR  0x00000200  /* 支持 FXSAVE/FXRSTOR 及 SSE 指令 */
+#define CR4_OSXMMEXCPT 0x00000400 /* SSE 浮点异常以 #XF 异常报告 */
+
+#define CPUID_EDX_FXSR  (1 << 24)
+#define CPUID_EDX_SSE   (1 << 25)
+
+#define MXCSR_DEFAULT   0x1f80  /* 屏蔽全部 SSE 浮点异常，舍入到最近 */
+
+#define NM_VECTOR 7 /* #NM Device Not Available */
+
+static bool fpu_enabled = false; /* 处理器是否支持 FXSAVE */
+
+static uint32_t cr0_read(void) {
+    uint32_t cr0;
+    asm volatile("movl %%cr0, %0" : "=r" (cr0));
+    return cr0;
+}
+
+static void cr0_write(uint32_t cr0) {
+    asm volatile("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+/* clear CR0.TS */
+static void clts(void) {
+    asm volatile("clts");
+}
+
+/* set CR0.TS */
+static void stts(void) {
+    cr0_write(cr0_read() | CR0_TS);
+}
+
+static void fxsave(struct fpu_state* fpu) {
+    asm volatile("fxsave %0" : "=m" (*fpu));
+}
+
+static void fxrstor(struct fpu_state* fpu) {
+    asm volatile("fxrstor %0" : : "m" (*fpu));
+}
+
+/* #NM : 当前任务在 TS 置位时首次使用 FPU */
+static void fpu_nm_handler(void) {
+    struct task_struct* cur_thread = thread_running();
+    struct cpu* pcpu = cpu_current();
+    clts();
+
+    if(pcpu->fpu_owner == cur_thread && cur_thread->fpu_cpu == pcpu) {
+        /* 期间本处理器没有其他任务使用 FPU，寄存器中仍是本任务的状态 */
+        return;
+    }
+    if(cur_thread->fpu_used) {
+        fxrstor(&cur_thread->fpu);
+    } else {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        asm volatile("fninit; ldmxcsr %0" : : "m" (mxcsr));
+        cur_thread->fpu_used = true;
+    }
+    pcpu->fpu_owner = cur_thread;
+    cur_thread->fpu_cpu = pcpu;
+}
+
+/* 开启当前处理器的 SSE，TS 置位使首次使用 FPU 时触发 #NM */
+static void fpu_cpu_init(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    if(!(edx & CPUID_EDX_FXSR) || !(edx & CPUID_EDX_SSE)) {
+        /* 不支持则保持 EM 置位，使用 FPU 即触发异常 */
+        fpu_enabled = false;
+        cr0_write(cr0_read() | CR0_EM | CR0_TS);
+        return;
+    }
+    fpu_enabled = true;
+
+    uint32_t cr4;
+    asm volatile("movl %%cr4, %0" : "=r" (cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    asm volatile("movl %0, %%cr4" : : "r" (cr4));
+
+    cr0_write((cr0_read() & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+}
+
+/* 开启 BSP 的 SSE 并注册 #NM 处理程序 */
+void fpu_init(void) {
+    put_str("fpu_init start\n");
+    fpu_cpu_init();
+    if(fpu_enabled) {
+        intr_handler_register(NM_VECTOR, fpu_nm_handler);
+    } else {
+        put_str("   cpu has no fxsr/sse, fpu disabled\n");
+    }
+    put_str("fpu_init done\n");
+}
+
+/* 开启 AP 的 SSE */
+void fpu_ap_init(void) {
+    fpu_cpu_init();
+}
+
+/* 任务 cur 换下处理器前调用，保存其本时间片内修改过的 FPU 状态 */
+void fpu_switch_out(struct task_struct* cur) {
+    /* TS 已清除说明本时间片内触发过 #NM，寄存器中是 cur 的状态 */
+    if(!(cr0_read() & CR0_TS)) {
+        fxsave(&cur->fpu);
+        stts();
+    }
+}
+
+/* 将当前任务 FPU 寄存器中的状态写回 PCB，fork 复制 PCB 前调用 */
+void fpu_save_current(void) {
+    enum intr_status old_stat = intr_disable();
+    if(!(cr0_read() & CR0_TS)) {
+        fxsave(&thread_running()->fpu);
+    }
+    intr_status_set(old_stat);
+}
+
+/* 丢弃当前任务的 FPU 状态，exec 后的新程序从初始状态开始 */
+void fpu_reset_current(void) {
+    enum intr_status old_stat = intr_disable();
+    struct task_struct* cur_thread = thread_running();
+    if(fpu_enabled) {
+        stts();
+    }
+    cur_thread->fpu_used = false;
+    cur_thread->fpu_cpu = NULL;
+    intr_status_set(old_stat);
+}
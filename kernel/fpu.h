@@ -0,0 +1,29 @@
+#ifndef __KERNEL_FPU_H
+#define __KERNEL_FPU_H
+
+#include "global.h"
+#include "thread.h"
+
+/*
+ * FPU/SSE 延迟切换：
+ * 任务换上处理器时置 CR0.TS，首次执行 FPU/SSE 指令触发 #NM，此时才恢复该任务的 FPU 状态；
+ * 换下时仅当本时间片内使用过 FPU（TS 已清除）才 FXSAVE。从不使用 FPU 的任务没有额外开销。
+ * 内核线程同样适用，但中断处理程序中不可使用 FPU/SSE 指令。
+ */
+
+/* 开启 BSP 的 SSE 并注册 #NM 处理程序 */
+void fpu_init(void);
+
+/* 开启 AP 的 SSE */
+void fpu_ap_init(void);
+
+/* 任务 cur 换下处理器前调用，保存其本时间片内修改过的 FPU 状态 */
+void fpu_switch_out(struct task_struct* cur);
+
+/* 将当前任务 FPU 寄存器中的状态写回 PCB，fork 复制 PCB 前调用 */
+void fpu_save_current(void);
+
+/* 丢弃当前任务的 FPU 状态，exec 后的新程序从初始状态开始 */
+void fpu_reset_current(void);
+
+#endif /* __KERNEL_FPU_H */
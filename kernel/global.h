@@ -47,6 +47,10 @@ s is 1 (stored segment). s is 0(system segment);
 #define GDT_ATTR_HIGH\
     ((DESC_G_4K << 7) + ( DESC_D_32 << 6) + (DESC_L << 5) + (DESC_AVL << 4))
 
+#define GDT_CODE_ATTR_LOW_DPL0\
+    ((DESC_P << 7) + (DESC_DPL_0 << 5) + (DESC_S_CODE << 4) + DESC_TYPE_CODE)
+#define GDT_DATA_ATTR_LOW_DPL0\
+    ((DESC_P << 7) + (DESC_DPL_0 << 5) + (DESC_S_DATA << 4) + DESC_TYPE_DATA)
 #define GDT_CODE_ATTR_LOW_DPL3\
     ((DESC_P << 7) + (DESC_DPL_3 << 5) + (DESC_S_CODE << 4) + DESC_TYPE_CODE)
 #define GDT_DATA_ATTR_LOW_DPL3\
@@ -84,6 +88,13 @@ typedef struct {
 #define SELECTOR_U_DATA     ((6 << 3) + (TI_GDT << 2) + RPL3)
 #define SELECTOR_U_STACK    SELECTOR_U_CODE
 
+/* sysenter/sysexit 要求内核代码段、内核栈段、用户代码段、用户栈段在 GDT 中依次相邻，
+ * 现有布局不满足，在 AP 的 TSS 之后另设一组，kernel.S 中的定义须与此一致 */
+#define SYSENTER_DESC_IDX   11
+#define SELECTOR_SYSENTER_CS    ((SYSENTER_DESC_IDX << 3) + (TI_GDT << 2) + RPL0)
+#define SELECTOR_SYSEXIT_CS     (((SYSENTER_DESC_IDX + 2) << 3) + (TI_GDT << 2) + RPL3)
+#define SELECTOR_SYSEXIT_SS     (((SYSENTER_DESC_IDX + 3) << 3) + (TI_GDT << 2) + RPL3)
+
 /******************** Selector Attribute [end] *******************/
 
 /********************** IDT Attribute [begin] ********************/
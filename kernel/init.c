@@ -10,18 +10,32 @@
 #include "syscall_init.h"
 #include "ide.h"
 #include "fs.h"
+#include "fpu.h"
+#include "workqueue.h"
+#include "futex.h"
+#include "mqueue.h"
+#include "vdso.h"
+#include "uring.h"
+#include "exec.h"
 
 /* init all of content */
 void init_all(void) {
     put_str("init_all\n");
     idt_init(); /* init idt */
+    fpu_init(); /* enable sse & lazy fpu switch */
     mem_init(); /* init memory pool */
+    vdso_init(); /* init user visible data page */
     thread_env_init(); /* init thread environment */
     timer_init(); /* init PIT */
+    workqueue_init(); /* init workqueue & system worker thread */
     console_init(); /* init console before open interrupt */
     keyboard_init(); /* init keyboard input */
     tss_init(); /* init TSS */
     syscall_init(); /* init syscall */
+    futex_init(); /* init futex wait queues */
+    mqueue_init(); /* init message queues */
+    uring_init(); /* init submission & completion rings */
+    exec_cache_init(); /* init executable page cache */
     ide_init(); /* init hd */
     filesys_init(); /* init file system */
 }
\ No newline at end of file
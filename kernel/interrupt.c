@@ -3,6 +3,7 @@
 #include "global.h"
 #include "io.h"
 #include "print.h"
+#include "memory.h"
 
 /* intr door descriptor array */
 static struct gate_desc idt[IDT_DESC_CNT];
@@ -58,12 +59,22 @@ static void pic_init(void) {
 }
 
 static void general_intr_handler(uint8_t vec_nr) {
-    if(vec_nr == 0x27 || vec_nr == 0x2f) {
+    if(vec_nr == 0x27 || vec_nr == 0x2f || vec_nr == 0x3f) {
         /* IRQ7 & IRQ15 will produce spurious interrupt, no action */
         /* 0x2f is 8259A's last IRQ (reserved item) */
+        /* 0x3f is local apic's spurious interrupt */
         return;
     }
 
+    /* 写时复制页的写入：换上私有副本后返回，重新执行写指令 */
+    if(vec_nr == 14) {
+        uint32_t page_fault_vaddr;
+        asm("movl %%cr2, %0" : "=r" (page_fault_vaddr));
+        if(page_cow_break(page_fault_vaddr)) {
+            return;
+        }
+    }
+
     /* 光标置 0，清除一片区域为 0 */
     set_cursor(0);
     int cursor_pos = 0;
@@ -129,11 +140,15 @@ void idt_init(void) {
     exception_init(); /* init & register normal interrupt handler */
     pic_init(); /* init 8259A */
 
-    /* load idt */
+    idt_load();
+    put_str("idt_init done\n");
+}
+
+/* load idt, AP 共用 BSP 建立的 idt */
+void idt_load(void) {
     /* [address(16-47)][limit(0-15)] */
     uint64_t idt_operand = ((uint64_t)((uint32_t)idt) << 16) | (sizeof(idt) - 1);
     asm volatile("lidt %0" : : "m" (idt_operand));
-    put_str("idt_init done\n");
 }
 
 /* get current interrupt status */
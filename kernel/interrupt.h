@@ -7,6 +7,9 @@ typedef void* intr_handler;
 /* init interrupt discriptor table */
 void idt_init(void);
 
+/* load idt, AP 共用 BSP 建立的 idt */
+void idt_load(void);
+
 /* interrupt status : turn on | turn off */
 enum intr_status {
     INTR_OFF, /* turn off interrupt */
@@ -14,6 +14,7 @@
 #include "fs.h"
 #include "shell.h"
 #include "stdio_kernel.h"
+#include "smp.h"
 
 /* init process */
 void init(void);
@@ -42,6 +43,8 @@ int main(void) {
     close(fd);
     sys_free(prog_buf);
     /************写入应用程序结束*************/
+    /* 之后内核线程不再直接访问文件系统，系统调用由大内核锁保护 */
+    smp_init();
     cls_screen();
     
     print_prompt();
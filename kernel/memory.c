@@ -5,6 +5,7 @@
 #include "string.h"
 #include "sync.h"
 #include "interrupt.h"
+#include "smp.h"
 
 #define MEMORY_TOTAL_SIZE *((uint32_t*)(0xb00))
 
@@ -40,11 +41,16 @@ struct paddr_mem_pool {
     uint32_t phy_addr_start; /* 该内存池管理的物理内存起始地址 */
     uint32_t pool_size; /* 本内存池的字节容量 */
     locker_t locker; /* muetx locker */
+    spinlock_t spin; /* 保护位图，多处理器上 palloc 与 pfree 可能同时发生 */
 }kernel_phy_pool, user_phy_pool;
 /* kernel pool & user pool */
 
 /* 使用该结构为内存分类虚拟地址 */
 struct vaddr_mem_pool kernel_vir_pool; 
+static spinlock_t kernel_vir_spin; /* 保护内核虚拟地址位图 */
+static spinlock_t cow_spin; /* 写时复制的检查与替换须原子进行，同一进程的多个线程可能同时写同一页 */
+static uint16_t* user_frame_refs; /* 用户内存池每个页框的共享计数：页缓存及每个只读映射各持有一个，私有页框为 0 */
+static spinlock_t frame_ref_spin; /* 保护 user_frame_refs */
 
 /* 小内存管理结构 */
 typedef struct {
@@ -125,8 +131,13 @@ static void mem_pool_init(uint32_t all_mem) {
     kernel_vir_pool.vaddr_start = K_HEAP_START;
     bitmap_init(&kernel_vir_pool.vaddr_bitmap);
 
-    locker_init(&user_phy_pool.locker);
-    locker_init(&kernel_phy_pool.locker);
+    locker_init(&user_phy_pool.locker, "user_phy_pool");
+    locker_init(&kernel_phy_pool.locker, "kernel_phy_pool");
+    spin_init(&user_phy_pool.spin);
+    spin_init(&kernel_phy_pool.spin);
+    spin_init(&kernel_vir_spin);
+    spin_init(&cow_spin);
+    spin_init(&frame_ref_spin);
 
     put_str("   mem_pool_init done\n");
 }
@@ -140,13 +151,16 @@ static void* vaddr_get(enum mem_pool_flags mpf, uint32_t pg_cnt) {
     int bit_idx_start = -1;
     uint32_t cnt = 0;
     if(MPF_KERNEL == mpf) {
+        enum intr_status old_stat = spin_lock_intr(&kernel_vir_spin);
         bit_idx_start = bitmap_scan(&kernel_vir_pool.vaddr_bitmap, pg_cnt); 
         if(bit_idx_start == -1) {
+            spin_unlock_intr(&kernel_vir_spin, old_stat);
             return NULL;
         }
         while(cnt < pg_cnt) {
             bitmap_set(&kernel_vir_pool.vaddr_bitmap, bit_idx_start + cnt++, 1);
         }
+        spin_unlock_intr(&kernel_vir_spin, old_stat);
         vaddr_start = kernel_vir_pool.vaddr_start + bit_idx_start * PG_SIZE;
     } else {
         /* 用户内存池
@@ -156,7 +170,7 @@ static void* vaddr_get(enum mem_pool_flags mpf, uint32_t pg_cnt) {
          * 4. 返回申请到的内存的首地址（虚拟地址）；
          */
         struct task_struct* cur_thread = thread_running();
-        struct bitmap* vaddr_bitmap = &cur_thread->userprog_vaddr_mem_pool.vaddr_bitmap;
+        struct bitmap* vaddr_bitmap = &cur_thread->group_leader->userprog_vaddr_mem_pool.vaddr_bitmap;
         bit_idx_start = bitmap_scan(vaddr_bitmap, pg_cnt);
         if(bit_idx_start == -1) {
             return NULL;
@@ -164,7 +178,7 @@ static void* vaddr_get(enum mem_pool_flags mpf, uint32_t pg_cnt) {
         while(cnt < pg_cnt) {
             bitmap_set(vaddr_bitmap, bit_idx_start + cnt++, 1);
         }
-        vaddr_start = cur_thread->userprog_vaddr_mem_pool.vaddr_start + bit_idx_start * PG_SIZE;
+        vaddr_start = cur_thread->group_leader->userprog_vaddr_mem_pool.vaddr_start + bit_idx_start * PG_SIZE;
         /* (0xc0000000 - PG_SIZE ）作为用户 3 级栈已经在 start_process 被分配 */
         ASSERT((uint32_t)vaddr_start < (0xc0000000 - PG_SIZE));
     }
@@ -177,11 +191,14 @@ static void* vaddr_get(enum mem_pool_flags mpf, uint32_t pg_cnt) {
  */
 static void* palloc(struct paddr_mem_pool* mem_pool) {
     /* 扫描和设置位图需要保证原子性 */
+    enum intr_status old_stat = spin_lock_intr(&mem_pool->spin);
     int bit_idx = bitmap_scan(&mem_pool->pool_bitmap, 1);
     if(bit_idx == -1) {
+        spin_unlock_intr(&mem_pool->spin, old_stat);
         return NULL;
     }
     bitmap_set(&mem_pool->pool_bitmap, bit_idx, 1); /* mark page used */
+    spin_unlock_intr(&mem_pool->spin, old_stat);
     uint32_t page_paddr = ((bit_idx * PG_SIZE) + mem_pool->phy_addr_start);
     return (void*)page_paddr;
 }
@@ -210,9 +227,9 @@ uint32_t* pte_ptr(uint32_t vaddr) {
 }
 
 /*
- * @brief: 页表中添加虚拟地址 _vir_addr 和物理地址 _phy_addr 的映射
+ * @brief: 页表中添加虚拟地址 _vir_addr 和物理地址 _phy_addr 的映射，pte 属性为 attr
  */
-static void page_table_map(void* _vir_addr, void* _phy_addr) {
+static void page_table_map_attr(void* _vir_addr, void* _phy_addr, uint32_t attr) {
     uint32_t vir_addr = (uint32_t)_vir_addr;
     uint32_t phy_addr = (uint32_t)_phy_addr;
     uint32_t* pde = pde_ptr(vir_addr);
@@ -223,10 +240,10 @@ static void page_table_map(void* _vir_addr, void* _phy_addr) {
         ASSERT(!(PG_P_1 & *pte));
         if(!(PG_P_1 & *pte)) {
             /* 创建页表时都应该不存在 */
-            *pte = (phy_addr | PG_US_U | PG_RW_W | PG_P_1);
+            *pte = (phy_addr | attr);
         } else {
             PANIC("pte repeat");
-            *pte = (phy_addr | PG_US_U | PG_RW_W | PG_P_1);
+            *pte = (phy_addr | attr);
         }
     } else {
         /* 先创建页表，再创建页表项 */
@@ -240,10 +257,17 @@ static void page_table_map(void* _vir_addr, void* _phy_addr) {
         memset((void*)((int)pte & 0xfffff000), 0, PG_SIZE);
         
         ASSERT(!(PG_P_1 & *pte));
-        *pte = (phy_addr | PG_US_U | PG_RW_W | PG_P_1);
+        *pte = (phy_addr | attr);
     }
 }
 
+/*
+ * @brief: 页表中添加虚拟地址 _vir_addr 和物理地址 _phy_addr 的映射
+ */
+static void page_table_map(void* _vir_addr, void* _phy_addr) {
+    page_table_map_attr(_vir_addr, _phy_addr, PG_US_U | PG_RW_W | PG_P_1);
+}
+
 /*
  * @brief: 分配 pg_cnt 个页的内存空间
  *      1. 通过 vaddr_get 在虚拟内存池中申请虚拟地址；
@@ -301,8 +325,10 @@ void* get_kernel_pages(uint32_t pg_cnt) {
 void* get_user_pages(uint32_t pg_cnt) {
     locker_lock(&user_phy_pool.locker);
     void* vaddr = malloc_page(MPF_USER, pg_cnt);
-    memset(vaddr, 0, pg_cnt * PG_SIZE);
-    locker_lock(&user_phy_pool.locker);
+    if(vaddr != NULL) {
+        memset(vaddr, 0, pg_cnt * PG_SIZE);
+    }
+    locker_unlock(&user_phy_pool.locker);
     return vaddr;   
 }
 
@@ -323,14 +349,16 @@ void* get_a_page(enum mem_pool_flags mpf, uint32_t vaddr) {
 
     if(cur_thread->pgdir != NULL && mpf == MPF_USER) {
         /* user process */
-        bit_idx = (vaddr - cur_thread->userprog_vaddr_mem_pool.vaddr_start) / PG_SIZE;
+        bit_idx = (vaddr - cur_thread->group_leader->userprog_vaddr_mem_pool.vaddr_start) / PG_SIZE;
         ASSERT(bit_idx > 0);
-        bitmap_set(&cur_thread->userprog_vaddr_mem_pool.vaddr_bitmap, bit_idx, 1);
+        bitmap_set(&cur_thread->group_leader->userprog_vaddr_mem_pool.vaddr_bitmap, bit_idx, 1);
     } else if(cur_thread->pgdir == NULL && mpf == MPF_KERNEL) {
         /* kernel thread */
         bit_idx = (vaddr - kernel_vir_pool.vaddr_start) / PG_SIZE;
         ASSERT(bit_idx > 0);
+        enum intr_status old_stat = spin_lock_intr(&kernel_vir_spin);
         bitmap_set(&kernel_vir_pool.vaddr_bitmap, bit_idx, 1);
+        spin_unlock_intr(&kernel_vir_spin, old_stat);
     } else {
         /* error */
         PANIC("get_a_page:not allow kernel alloc userspace or user alloc kernelspace by get_a_page");
@@ -339,6 +367,7 @@ void* get_a_page(enum mem_pool_flags mpf, uint32_t vaddr) {
     /* 申请一页物理内存 */
     void* phy_page = palloc(mem_pool);
     if(phy_page == NULL) {
+        locker_unlock(&mem_pool->locker);
         return NULL;
     }
     page_table_map((void*)vaddr, phy_page);
@@ -354,6 +383,7 @@ void* get_a_page2(enum mem_pool_flags mpf, uint32_t vaddr) {
     /* 申请一页物理内存 */
     void* phy_page = palloc(mem_pool);
     if(phy_page == NULL) {
+        locker_unlock(&mem_pool->locker);
         return NULL;
     }
     page_table_map((void*)vaddr, phy_page);
@@ -367,6 +397,23 @@ uint32_t addr_v2p(uint32_t vaddr) {
     return (uint32_t)((*pte & (PDE_MASK | PTE_MASK)) + (vaddr & 0x00000fff));
 }
 
+/* 将物理地址 phy_addr 起始的 pg_cnt 页设备寄存器以不可缓存方式映射到内核空间，返回对应的虚拟地址 */
+void* mmio_map(uint32_t phy_addr, uint32_t pg_cnt) {
+    ASSERT((phy_addr % PG_SIZE) == 0);
+    void* vaddr_start = vaddr_get(MPF_KERNEL, pg_cnt);
+    if(vaddr_start == NULL) {
+        return NULL;
+    }
+    uint32_t vaddr = (uint32_t)vaddr_start;
+    while(pg_cnt--) {
+        /* 设备寄存器不属于任何物理内存池，只建立映射 */
+        page_table_map_attr((void*)vaddr, (void*)phy_addr, PG_PCD | PG_PWT | PG_US_S | PG_RW_W | PG_P_1);
+        vaddr += PG_SIZE;
+        phy_addr += PG_SIZE;
+    }
+    return vaddr_start;
+}
+
 /* 返回 arena 中第 idx 个内存块的地址 */
 static mem_bck_t* arena2bck(arena_t* arena, uint32_t idx) {
     return (mem_bck_t*)((uint32_t)arena + sizeof(arena_t) + idx * arena->desc->bck_size);
@@ -377,25 +424,20 @@ static arena_t* bck2arena(mem_bck_t* bck) {
     return (arena_t*)((uint32_t)bck & 0xfffff000);
 }
 
-/* 堆中申请size字节的内存 */
-void* sys_malloc(uint32_t size) {
-    enum mem_pool_flags mpf;
+/* 在 mpf 指定的堆中申请 size 字节的内存，用户堆为当前进程的堆 */
+static void* heap_alloc(enum mem_pool_flags mpf, uint32_t size) {
     struct paddr_mem_pool* mem_pool;
     uint32_t pool_size;
     mem_bck_desc_t* descs;
-    struct task_struct* cur_thread = thread_running();
 
-    /* 判断用那个内存池 */
-    if(cur_thread->pgdir == NULL) { /* kernel */
-        mpf = MPF_KERNEL;
+    if(mpf == MPF_KERNEL) {
         pool_size = kernel_phy_pool.pool_size;
         mem_pool = &kernel_phy_pool;
         descs = k_bck_descs;
     } else {
-        mpf = MPF_USER;
         pool_size = user_phy_pool.pool_size;
         mem_pool = &user_phy_pool;
-        descs = cur_thread->u_bck_descs;
+        descs = thread_running()->group_leader->u_bck_descs; /* 同一进程的线程共用堆 */
     }
     if(!(size > 0 && size < pool_size)) {
         return NULL;
@@ -474,6 +516,17 @@ void* sys_malloc(uint32_t size) {
     }
 }
 
+/* 堆中申请size字节的内存 */
+void* sys_malloc(uint32_t size) {
+    /* 判断用那个内存池 */
+    return heap_alloc(thread_running()->pgdir == NULL ? MPF_KERNEL : MPF_USER, size);
+}
+
+/* 在内核堆中申请 size 字节的内存，与当前任务是否为用户进程无关，用 kfree 释放 */
+void* kmalloc(uint32_t size) {
+    return heap_alloc(MPF_KERNEL, size);
+}
+
 /* 初始化所有规格的内存块 */
 void bck_desc_init(mem_bck_desc_t* desc_array) {
     uint16_t desc_idx;
@@ -502,7 +555,9 @@ void pfree(uint32_t pg_phy_addr) {
         mem_pool = &kernel_phy_pool;
         bit_idx = (pg_phy_addr - kernel_phy_pool.phy_addr_start) / PG_SIZE;
     }
+    enum intr_status old_stat = spin_lock_intr(&mem_pool->spin);
     bitmap_set(&mem_pool->pool_bitmap, bit_idx, 0);
+    spin_unlock_intr(&mem_pool->spin, old_stat);
 }
 
 /* 去掉页表中虚拟地址 vaddr 的映射，将 vaddr 的 pte 的 P 置为 0 */
@@ -510,7 +565,12 @@ static void page_table_unmap(uint32_t vaddr) {
     uint32_t* pte = pte_ptr(vaddr);
     *pte &= ~PG_P_1;
     /* 刷新快表 */
-    asm volatile("invlpg %0" : : "m" (vaddr) : "memory");
+    asm volatile("invlpg %0" : : "m" (*(uint8_t*)vaddr) : "memory");
+    if(vaddr >= 0xc0000000 || thread_running()->group_leader->nr_threads > 1) {
+        /* 内核空间为所有处理器共享，其他处理器不再每次切换都重新加载 cr3，需要通知其刷新；
+         * 多线程进程的用户空间可能同时加载在其他处理器上。等待刷新完成后 vaddr 才归还虚拟地址池 */
+        smp_tlb_flush_others();
+    }
 }
 
 /* 从虚拟地址池释放 _vaddr 起始的连续 pg_cnt 个虚拟页 */
@@ -521,14 +581,16 @@ static void vaddr_remove(enum mem_pool_flags mpf, void* _vaddr, uint32_t pg_cnt)
 
     if(mpf == MPF_KERNEL) {
         bit_idx_start = (vaddr - kernel_vir_pool.vaddr_start) / PG_SIZE;
+        enum intr_status old_stat = spin_lock_intr(&kernel_vir_spin);
         while(cnt < pg_cnt) {
             bitmap_set(&kernel_vir_pool.vaddr_bitmap, bit_idx_start + cnt++, 0);
         }
+        spin_unlock_intr(&kernel_vir_spin, old_stat);
     } else {
         struct task_struct* cur_thread = thread_running();
-        bit_idx_start = (vaddr - cur_thread->userprog_vaddr_mem_pool.vaddr_start) / PG_SIZE;
+        bit_idx_start = (vaddr - cur_thread->group_leader->userprog_vaddr_mem_pool.vaddr_start) / PG_SIZE;
         while(cnt < pg_cnt) {
-            bitmap_set(&cur_thread->userprog_vaddr_mem_pool.vaddr_bitmap, bit_idx_start + cnt++, 0);
+            bitmap_set(&cur_thread->group_leader->userprog_vaddr_mem_pool.vaddr_bitmap, bit_idx_start + cnt++, 0);
         }
     }
 }
@@ -553,8 +615,14 @@ void mfree_page(enum mem_pool_flags mpf, void* _vaddr, uint32_t pg_cnt) {
             pg_phy_addr = addr_v2p(vaddr);
 
             ASSERT((pg_phy_addr % PG_SIZE) == 0 && pg_phy_addr >= user_phy_pool.phy_addr_start);
-            pfree(pg_phy_addr);
-            page_table_unmap(vaddr);
+            bool shared = !(*pte_ptr(vaddr) & PG_RW_W);
+            page_table_unmap(vaddr); /* 其他处理器刷新 TLB 后页框才能重用 */
+            /* 只读映射的是共享页框，可能还被消息队列或其他进程持有 */
+            if(shared) {
+                page_frame_put(pg_phy_addr);
+            } else {
+                pfree(pg_phy_addr);
+            }
             page_cnt++;
         }
         vaddr_remove(mpf, _vaddr, pg_cnt);
@@ -565,27 +633,200 @@ void mfree_page(enum mem_pool_flags mpf, void* _vaddr, uint32_t pg_cnt) {
             pg_phy_addr = addr_v2p(vaddr);
 
             ASSERT((pg_phy_addr % PG_SIZE) == 0 && pg_phy_addr >= kernel_phy_pool.phy_addr_start && pg_phy_addr < user_phy_pool.phy_addr_start);
-            pfree(pg_phy_addr);
             page_table_unmap(vaddr);
+            pfree(pg_phy_addr);
             page_cnt++;
         }
         vaddr_remove(mpf, _vaddr, pg_cnt);
     }
 }
 
-/* 回收内存 ptr */
-void sys_free(void* ptr) {
-    ASSERT(ptr != NULL);
-    if(ptr == NULL) return;
+/* 将当前进程的 vaddr 改为映射到页框 pg_phy_addr，pte 属性为 attr，刷新快表 */
+static void page_table_remap_attr(uint32_t vaddr, uint32_t pg_phy_addr, uint32_t attr) {
+    uint32_t* pte = pte_ptr(vaddr);
+    *pte = pg_phy_addr | attr;
+    asm volatile("invlpg %0" : : "m" (*(uint8_t*)vaddr) : "memory");
+    if(thread_running()->group_leader->nr_threads > 1) {
+        smp_tlb_flush_others();
+    }
+}
+
+/* 将当前进程的 vaddr 改为映射到页框 pg_phy_addr，刷新快表 */
+static void page_table_remap(uint32_t vaddr, uint32_t pg_phy_addr) {
+    page_table_remap_attr(vaddr, pg_phy_addr, PG_US_U | PG_RW_W | PG_P_1);
+}
+
+/* 将当前进程用户空间 vaddr 处的页框改为写时复制的共享页框并为调用者增加一个持有者，返回页框物理地址，未映射返回 0
+ * 私有页框转为共享时映射本身成为一个持有者，此后哪一方先写入，哪一方换上私有副本 */
+uint32_t page_frame_share(uint32_t vaddr) {
+    ASSERT((vaddr % PG_SIZE) == 0 && vaddr < 0xc0000000);
+    if(!(*pde_ptr(vaddr) & PG_P_1)) {
+        return 0;
+    }
+    uint32_t* pte = pte_ptr(vaddr);
+    uint32_t frame = 0;
+    enum intr_status old_stat = spin_lock_intr(&cow_spin);
+    if(*pte & PG_P_1) {
+        frame = *pte & 0xfffff000;
+        if(*pte & PG_RW_W) {
+            page_frame_get(frame);
+            page_table_remap_attr(vaddr, frame, PG_US_U | PG_RW_R | PG_P_1 | PG_COW);
+        }
+        page_frame_get(frame);
+    }
+    spin_unlock_intr(&cow_spin, old_stat);
+    return frame;
+}
+
+/* 将共享页框 pg_phy_addr 写时复制地映射到当前进程用户空间 vaddr 处替换原页框，调用者仍持有自己的一份，vaddr 未映射返回 false */
+bool page_frame_attach(uint32_t vaddr, uint32_t pg_phy_addr) {
+    ASSERT((vaddr % PG_SIZE) == 0 && vaddr < 0xc0000000);
+    if(!(*pde_ptr(vaddr) & PG_P_1) || !(*pte_ptr(vaddr) & PG_P_1)) {
+        return false;
+    }
+    page_share_map(vaddr, pg_phy_addr, true);
+    return true;
+}
+
+/* 将共享页框 pg_phy_addr 只读映射到当前进程用户空间 vaddr 处并增加其持有者，cow 为 true 时写入触发写时复制；
+ * vaddr 原先映射的私有页框被释放，共享页框减少一个持有者 */
+void page_share_map(uint32_t vaddr, uint32_t pg_phy_addr, bool cow) {
+    ASSERT((vaddr % PG_SIZE) == 0 && vaddr < 0xc0000000);
+    struct vaddr_mem_pool* vaddr_pool = &thread_running()->group_leader->userprog_vaddr_mem_pool;
+    bitmap_set(&vaddr_pool->vaddr_bitmap, (vaddr - vaddr_pool->vaddr_start) / PG_SIZE, 1);
+
+    uint32_t attr = PG_US_U | PG_RW_R | PG_P_1 | (cow ? PG_COW : 0);
+    uint32_t* pte = pte_ptr(vaddr);
+    page_frame_get(pg_phy_addr);
+    if(!(*pde_ptr(vaddr) & PG_P_1) || !(*pte & PG_P_1)) {
+        page_table_map_attr((void*)vaddr, (void*)pg_phy_addr, attr);
+        return;
+    }
+    uint32_t old_frame = *pte & 0xfffff000;
+    bool old_private = *pte & PG_RW_W;
+    page_table_remap_attr(vaddr, pg_phy_addr, attr);
+    if(!old_private) {
+        page_frame_put(old_frame);
+    } else if(old_frame != pg_phy_addr) {
+        pfree(old_frame);
+    }
+}
+
+/* 保证当前进程用户空间 vaddr 处映射着可写的私有页框：未映射则分配，映射着共享页框则换上新页框，失败返回 NULL */
+void* page_private_get(uint32_t vaddr) {
+    ASSERT((vaddr % PG_SIZE) == 0 && vaddr < 0xc0000000);
+    uint32_t* pte = pte_ptr(vaddr);
+    if(!(*pde_ptr(vaddr) & PG_P_1) || !(*pte & PG_P_1)) {
+        return get_a_page(MPF_USER, vaddr);
+    }
+    if(!(*pte & PG_RW_W)) {
+        /* 原页框为共享页框，放弃本进程持有的一份 */
+        uint32_t old_frame = *pte & 0xfffff000;
+        void* new_frame = palloc(&user_phy_pool);
+        if(new_frame == NULL) {
+            return NULL;
+        }
+        page_table_remap(vaddr, (uint32_t)new_frame);
+        page_frame_put(old_frame);
+    }
+    return (void*)vaddr;
+}
+
+/* vaddr 处为写时复制页时为当前进程换上一份私有副本，返回 true 表示缺页已处理，在缺页异常中调用 */
+bool page_cow_break(uint32_t vaddr) {
+    vaddr &= 0xfffff000;
+    if(vaddr >= 0xc0000000 || !(*pde_ptr(vaddr) & PG_P_1)) {
+        return false;
+    }
+    uint32_t* pte = pte_ptr(vaddr);
+    bool done = false;
+    enum intr_status old_stat = spin_lock_intr(&cow_spin);
+    if((*pte & PG_P_1) && (*pte & PG_RW_W)) {
+        /* 同进程的其他线程已完成复制，本处理器的快表中还是旧的只读映射 */
+        asm volatile("invlpg %0" : : "m" (*(uint8_t*)vaddr) : "memory");
+        done = true;
+    } else if((*pte & PG_P_1) && (*pte & PG_COW)) {
+        /* 换上副本后放弃本进程持有的共享页框 */
+        uint32_t old_frame = *pte & 0xfffff000;
+        void* new_frame = palloc(&user_phy_pool);
+        void* kaddr = new_frame == NULL ? NULL : kmap((uint32_t)new_frame);
+        if(kaddr != NULL) {
+            memcpy(kaddr, (void*)vaddr, PG_SIZE);
+            kunmap(kaddr);
+            page_table_remap(vaddr, (uint32_t)new_frame);
+            page_frame_put(old_frame);
+            done = true;
+        } else if(new_frame != NULL) {
+            pfree((uint32_t)new_frame);
+        }
+    }
+    spin_unlock_intr(&cow_spin, old_stat);
+    return done;
+}
+
+/* 共享页框 pg_phy_addr 增加一个持有者 */
+void page_frame_get(uint32_t pg_phy_addr) {
+    ASSERT(pg_phy_addr >= user_phy_pool.phy_addr_start);
+    enum intr_status old_stat = spin_lock_intr(&frame_ref_spin);
+    user_frame_refs[(pg_phy_addr - user_phy_pool.phy_addr_start) / PG_SIZE]++;
+    spin_unlock_intr(&frame_ref_spin, old_stat);
+}
+
+/* 共享页框 pg_phy_addr 减少一个持有者，最后一个持有者（页缓存或只读映射）放弃时释放页框 */
+void page_frame_put(uint32_t pg_phy_addr) {
+    ASSERT(pg_phy_addr >= user_phy_pool.phy_addr_start);
+    enum intr_status old_stat = spin_lock_intr(&frame_ref_spin);
+    uint16_t* refs = &user_frame_refs[(pg_phy_addr - user_phy_pool.phy_addr_start) / PG_SIZE];
+    ASSERT(*refs > 0);
+    bool last = --*refs == 0;
+    spin_unlock_intr(&frame_ref_spin, old_stat);
+    if(last) {
+        pfree(pg_phy_addr);
+    }
+}
+
+/* 将页框 pg_phy_addr 临时映射到内核空间，用完后调用 kunmap */
+void* kmap(uint32_t pg_phy_addr) {
+    void* vaddr = vaddr_get(MPF_KERNEL, 1);
+    if(vaddr == NULL) {
+        return NULL;
+    }
+    page_table_map(vaddr, (void*)pg_phy_addr);
+    return vaddr;
+}
 
-    enum mem_pool_flags mpf;
+/* 撤销 kmap 建立的映射，不释放页框 */
+void kunmap(void* vaddr) {
+    page_table_unmap((uint32_t)vaddr);
+    vaddr_remove(MPF_KERNEL, vaddr, 1);
+}
+
+/* 保留一页内核虚拟地址作为映射窗口，由 kmap_local 换上页框，失败返回 NULL */
+void* kmap_window(void) {
+    void* vaddr = vaddr_get(MPF_KERNEL, 1);
+    if(vaddr != NULL) {
+        /* 内核空间的页表在各页目录中共享，已经存在 */
+        ASSERT(*pde_ptr((uint32_t)vaddr) & PG_P_1);
+        *pte_ptr((uint32_t)vaddr) = 0;
+    }
+    return vaddr;
+}
+
+/* 将窗口 window 改为映射页框 pg_phy_addr，只刷新本处理器的快表，调用者关中断直到用完该映射
+ * 其他处理器可能留有窗口的旧映射，但每次使用前都在本处理器上重新映射，不会用到旧映射 */
+void kmap_local(void* window, uint32_t pg_phy_addr) {
+    ASSERT(intr_status_get() == INTR_OFF);
+    *pte_ptr((uint32_t)window) = pg_phy_addr | PG_US_S | PG_RW_W | PG_P_1;
+    asm volatile("invlpg %0" : : "m" (*(uint8_t*)window) : "memory");
+}
+
+/* 回收 mpf 指定的堆中的内存 ptr */
+static void heap_free(enum mem_pool_flags mpf, void* ptr) {
     struct paddr_mem_pool* mem_pool;
-    if(thread_running()->pgdir == NULL) {
+    if(mpf == MPF_KERNEL) {
         ASSERT((uint32_t)ptr >= K_HEAP_START);
-        mpf = MPF_KERNEL;
         mem_pool = &kernel_phy_pool;
     } else {
-        mpf = MPF_USER;
         mem_pool = &user_phy_pool;
     }
     /* 以下操作需要上锁 */
@@ -616,6 +857,61 @@ void sys_free(void* ptr) {
     locker_unlock(&mem_pool->locker);
 }
 
+/* 回收内存 ptr */
+void sys_free(void* ptr) {
+    ASSERT(ptr != NULL);
+    if(ptr == NULL) return;
+    heap_free(thread_running()->pgdir == NULL ? MPF_KERNEL : MPF_USER, ptr);
+}
+
+/* 回收 kmalloc 申请的内存 ptr */
+void kfree(void* ptr) {
+    ASSERT(ptr != NULL);
+    heap_free(MPF_KERNEL, ptr);
+}
+
+/* 开启当前处理器的全局页（CR4.PGE） */
+void page_global_enable(void) {
+    uint32_t cr4;
+    asm volatile("movl %%cr4, %0" : "=r" (cr4));
+    cr4 |= 0x80; /* PGE */
+    asm volatile("movl %0, %%cr4" : : "r" (cr4) : "memory");
+}
+
+/* 开启当前处理器的写保护（CR0.WP），内核写只读的用户页同样触发缺页，写时复制对内核写入同样有效 */
+void page_write_protect_enable(void) {
+    uint32_t cr0;
+    asm volatile("movl %%cr0, %0" : "=r" (cr0));
+    cr0 |= 0x10000; /* WP */
+    asm volatile("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+/*
+ * @brief: 将内核映像所在的低 1MB（0xc0000000 ~ 0xc00fffff）标记为全局页，切换地址空间后仍留在 TLB 中
+ * 动态分配的内核页会被释放重用，不标记
+ */
+static void kernel_pages_global(void) {
+    /*
+     * loader 中 PDE 0 的恒等映射与 PDE 768 共用一张页表，恒等映射只在 AP 启动开启分页时使用，
+     * 若也成为全局页，用户进程访问低地址时可能命中残留的恒等映射，因此为 PDE 0 复制一张独立的页表
+     */
+    uint32_t* identity_pt = get_kernel_pages(1);
+    ASSERT(identity_pt != NULL);
+    memcpy(identity_pt, pte_ptr(0xc0000000), 256 * 4);
+    *pde_ptr(0) = addr_v2p((uint32_t)identity_pt) | PG_US_U | PG_RW_W | PG_P_1;
+
+    uint32_t vaddr;
+    for(vaddr = 0xc0000000; vaddr < 0xc0100000; vaddr += PG_SIZE) {
+        uint32_t* pte = pte_ptr(vaddr);
+        if(*pte & PG_P_1) {
+            *pte |= PG_G;
+        }
+    }
+    page_global_enable();
+    /* 重新加载 cr3 使新的 PDE 0 生效 */
+    asm volatile("movl %0, %%cr3" : : "r" (KERNEL_PAGE_DIR_PHY) : "memory");
+}
+
 /*
  * @brief: 内存管理初始化入口
  */
@@ -624,5 +920,9 @@ void mem_init(void) {
     /* 0xb03 开始 32 位存放了内存的总容量 */
     mem_pool_init(MEMORY_TOTAL_SIZE); /* init memory pool */
     bck_desc_init(k_bck_descs);
+    user_frame_refs = get_kernel_pages(DIV_ROUND_UP(user_phy_pool.pool_size / PG_SIZE * sizeof(uint16_t), PG_SIZE));
+    ASSERT(user_frame_refs != NULL);
+    kernel_pages_global();
+    page_write_protect_enable();
     put_str("mem_init done\n");
 }
@@ -20,6 +20,12 @@ enum mem_pool_flags {
 #define PG_RW_W 2   /* R/W : read & write & execute */
 #define PG_US_S 0   /* U/S : system */
 #define PG_US_U 4   /* U/S : user */
+#define PG_PWT  8   /* page write through */
+#define PG_PCD  16  /* page cache disable : 设备寄存器（mmio）不可缓存 */
+#define PG_G    256 /* global : 重新加载 cr3 时不从 TLB 中刷出，需 CR4.PGE */
+#define PG_COW  512 /* AVL 位：写时复制，只读映射的共享页框，写入时换上私有副本 */
+
+#define KERNEL_PAGE_DIR_PHY 0x100000 /* 内核页目录表的物理地址 */
 
 /* virtual address memory pool */
 struct vaddr_mem_pool {
@@ -90,6 +96,15 @@ void* get_a_page2(enum mem_pool_flags mpf, uint32_t vaddr);
 /* get physical address which virtual address mapped */
 uint32_t addr_v2p(uint32_t vaddr);
 
+/* 将物理地址 phy_addr 起始的 pg_cnt 页设备寄存器以不可缓存方式映射到内核空间，返回对应的虚拟地址 */
+void* mmio_map(uint32_t phy_addr, uint32_t pg_cnt);
+
+/* 开启当前处理器的全局页（CR4.PGE） */
+void page_global_enable(void);
+
+/* 开启当前处理器的写保护（CR0.WP），内核写只读的用户页同样触发缺页，写时复制对内核写入同样有效 */
+void page_write_protect_enable(void);
+
 /* 堆中申请size字节的内存 */
 void* sys_malloc(uint32_t size);
 
@@ -105,6 +120,46 @@ void mfree_page(enum mem_pool_flags mpf, void* _vaddr, uint32_t pg_cnt);
 /* 回收内存 ptr */
 void sys_free(void* ptr);
 
+/* 在内核堆中申请 size 字节的内存，与当前任务是否为用户进程无关，用 kfree 释放 */
+void* kmalloc(uint32_t size);
+
+/* 回收 kmalloc 申请的内存 ptr */
+void kfree(void* ptr);
+
+/* 将当前进程用户空间 vaddr 处的页框改为写时复制的共享页框并为调用者增加一个持有者，返回页框物理地址，未映射返回 0 */
+uint32_t page_frame_share(uint32_t vaddr);
+
+/* 将共享页框 pg_phy_addr 写时复制地映射到当前进程用户空间 vaddr 处替换原页框，调用者仍持有自己的一份，vaddr 未映射返回 false */
+bool page_frame_attach(uint32_t vaddr, uint32_t pg_phy_addr);
+
+/* 将共享页框 pg_phy_addr 只读映射到当前进程用户空间 vaddr 处并增加其持有者，cow 为 true 时写入触发写时复制；
+ * vaddr 原先映射的私有页框被释放，共享页框减少一个持有者 */
+void page_share_map(uint32_t vaddr, uint32_t pg_phy_addr, bool cow);
+
+/* 保证当前进程用户空间 vaddr 处映射着可写的私有页框：未映射则分配，映射着共享页框则换上新页框，失败返回 NULL */
+void* page_private_get(uint32_t vaddr);
+
+/* vaddr 处为写时复制页时为当前进程换上一份私有副本，返回 true 表示缺页已处理，在缺页异常中调用 */
+bool page_cow_break(uint32_t vaddr);
+
+/* 共享页框 pg_phy_addr 增加一个持有者 */
+void page_frame_get(uint32_t pg_phy_addr);
+
+/* 共享页框 pg_phy_addr 减少一个持有者，最后一个持有者（页缓存或只读映射）放弃时释放页框 */
+void page_frame_put(uint32_t pg_phy_addr);
+
+/* 将页框 pg_phy_addr 临时映射到内核空间，用完后调用 kunmap */
+void* kmap(uint32_t pg_phy_addr);
+
+/* 撤销 kmap 建立的映射，不释放页框 */
+void kunmap(void* vaddr);
+
+/* 保留一页内核虚拟地址作为映射窗口，由 kmap_local 换上页框，失败返回 NULL */
+void* kmap_window(void);
+
+/* 将窗口 window 改为映射页框 pg_phy_addr，只刷新本处理器的快表，调用者关中断直到用完该映射 */
+void kmap_local(void* window, uint32_t pg_phy_addr);
+
 /*
  * @brief: entry of init memory manager
  */
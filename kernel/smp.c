@@ -0,0 +1,322 @@
+#include "smp.h"
+#include "apic.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "tss.h"
+#include "print.h"
+#include "debug.h"
+#include "string.h"
+#include "fpu.h"
+
+/* 低 1MB 物理内存在内核空间的映射 */
+#define PHY_LOW_TO_VIR(addr) ((void*)(0xc0000000 + (uint32_t)(addr)))
+
+#define MP_ENTRY_PROCESSOR  0   /* 处理器表项，20 字节，其余表项均为 8 字节 */
+#define MP_CPU_ENABLED      0x1
+#define MP_CPU_BSP          0x2
+
+/* MP floating pointer structure */
+struct mp_fps {
+    char signature[4]; /* "_MP_" */
+    uint32_t config_addr; /* MP 配置表物理地址 */
+    uint8_t length; /* 以 16 字节为单位 */
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t feature[5]; /* feature[0] 非 0 表示使用默认配置，没有配置表 */
+} __attribute__ ((packed));
+
+/* MP configuration table header */
+struct mp_config {
+    char signature[4]; /* "PCMP" */
+    uint16_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} __attribute__ ((packed));
+
+/* MP configuration table : processor entry */
+struct mp_processor {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_ver;
+    uint8_t cpu_flags;
+    uint32_t signature;
+    uint32_t feature_flags;
+    uint32_t reserved[2];
+} __attribute__ ((packed));
+
+struct cpu cpus[NR_CPUS];
+uint8_t cpu_cnt = 0;
+
+/* trampoline.S 中 AP 的启动代码及其使用的栈顶 */
+extern char ap_trampoline_start[], ap_trampoline_end[], ap_stack_top[];
+
+/* 初始化逻辑编号为 id 的处理器数据 */
+void cpu_init(struct cpu* pcpu, uint8_t id) {
+    memset(pcpu, 0, sizeof(struct cpu));
+    pcpu->id = id;
+    spin_init(&pcpu->rq_lock);
+    list_init(&pcpu->ready_list);
+    pcpu->balance_ticks = 1;
+    pcpu->cr3 = KERNEL_PAGE_DIR_PHY; /* loader 与 AP 启动代码都使用内核页目录表 */
+}
+
+/* 当前处理器，运行中任务的 cpu 只会由自己修改 */
+struct cpu* cpu_current(void) {
+    struct cpu* pcpu = thread_running()->cpu;
+    return pcpu == NULL ? &cpus[0] : pcpu;
+}
+
+/* 向处理器 pcpu 发送重新调度的 IPI，唤醒其 hlt */
+void smp_send_resched(struct cpu* pcpu) {
+    if(!pcpu->started || pcpu == cpu_current()) {
+        return;
+    }
+    lapic_send_ipi(pcpu->apic_id, LAPIC_RESCHED_VECTOR);
+}
+
+/* 第 i 位为 1 表示处理器 i 有尚未完成的 TLB 刷新请求 */
+static volatile uint32_t tlb_flush_pending = 0;
+/* 正在释放的页目录物理地址，处理刷新请求时若仍加载着它则换成内核页目录 */
+static volatile uint32_t pgdir_releasing = 0;
+static spinlock_t pgdir_release_spin = { 0 }; /* 同一时刻只释放一个页目录 */
+
+/* 重新加载 cr3 刷出所有非全局页 */
+static void tlb_flush_local(void) {
+    uint32_t cr3;
+    asm volatile("movl %%cr3, %0; movl %0, %%cr3" : "=r" (cr3) : : "memory");
+}
+
+/* 当前处理器加载着物理地址为 pgdir_phy 的页目录时改为加载内核页目录，内核线程沿用的页目录可以是任意进程的 */
+static void pgdir_leave(uint32_t pgdir_phy) {
+    struct cpu* pcpu = cpu_current();
+    if(pcpu->cr3 == pgdir_phy) {
+        asm volatile("movl %0, %%cr3" : : "r" (KERNEL_PAGE_DIR_PHY) : "memory");
+        pcpu->cr3 = KERNEL_PAGE_DIR_PHY;
+    }
+}
+
+/* 完成发给本处理器的 TLB 刷新请求：先清除请求位再刷新，刷新期间到达的新请求不会丢失 */
+void smp_tlb_poll(void) {
+    if(tlb_flush_pending == 0) {
+        return;
+    }
+    uint32_t bit = 1 << cpu_current()->id;
+    if(tlb_flush_pending & bit) {
+        asm volatile("lock andl %1, %0" : "+m" (tlb_flush_pending) : "r" (~bit) : "memory");
+        if(pgdir_releasing != 0) {
+            pgdir_leave(pgdir_releasing);
+        }
+        tlb_flush_local();
+    }
+}
+
+/* 页目录 pgdir_phy 即将被释放：让所有仍加载着它的处理器换成内核页目录并等待完成
+ * 此后没有处理器的 cr3 指向它，该页框被重用为新的页目录时 page_dir_activate 不会误以为无需切换 */
+void smp_pgdir_release(uint32_t pgdir_phy) {
+    enum intr_status old_stat = spin_lock_intr(&pgdir_release_spin);
+    pgdir_leave(pgdir_phy);
+    pgdir_releasing = pgdir_phy;
+    smp_tlb_flush_others();
+    pgdir_releasing = 0;
+    spin_unlock_intr(&pgdir_release_spin, old_stat);
+}
+
+/* 通知其他处理器刷新 TLB 中的非全局页并等待完成，内核空间映射被撤销后调用
+ * 返回后被撤销的虚拟地址和页框才可重用。等待期间处理发给自己的请求，两个处理器同时发起时不会互相等待 */
+void smp_tlb_flush_others(void) {
+    uint32_t mask = 0;
+    uint8_t cpu_idx;
+    for(cpu_idx = 0; cpu_idx < cpu_cnt; cpu_idx++) {
+        struct cpu* pcpu = &cpus[cpu_idx];
+        if(pcpu->started && pcpu != cpu_current()) {
+            mask |= 1 << pcpu->id;
+        }
+    }
+    if(mask == 0) {
+        return;
+    }
+    asm volatile("lock orl %1, %0" : "+m" (tlb_flush_pending) : "r" (mask) : "memory");
+    for(cpu_idx = 0; cpu_idx < cpu_cnt; cpu_idx++) {
+        if(mask & (1 << cpus[cpu_idx].id)) {
+            lapic_send_ipi(cpus[cpu_idx].apic_id, LAPIC_TLB_VECTOR);
+        }
+    }
+    while(tlb_flush_pending & mask) {
+        smp_tlb_poll();
+        asm volatile("pause");
+    }
+}
+
+/* 刷新 TLB IPI */
+static void tlb_flush_intr_handler(void) {
+    smp_tlb_poll();
+}
+
+/* AP 的 local apic 时钟中断 */
+static void lapic_timer_intr_handler(void) {
+    thread_tick();
+}
+
+/* 重新调度 IPI：只需打断目标处理器的 hlt，idle 醒来后会重新调度 */
+static void resched_intr_handler(void) {
+}
+
+/* 校验和：所有字节相加为 0 */
+static bool mp_checksum(void* addr, uint32_t len) {
+    uint8_t* p = addr;
+    uint8_t sum = 0;
+    while(len--) {
+        sum += *p++;
+    }
+    return sum == 0;
+}
+
+/* 在物理地址 [start, start + len) 中查找 MP floating pointer structure */
+static struct mp_fps* mp_fps_search(uint32_t start, uint32_t len) {
+    uint32_t addr;
+    for(addr = start; addr + sizeof(struct mp_fps) <= start + len; addr += 16) {
+        struct mp_fps* fps = PHY_LOW_TO_VIR(addr);
+        if(!memcmp(fps->signature, "_MP_", 4) && mp_checksum(fps, sizeof(struct mp_fps))) {
+            return fps;
+        }
+    }
+    return NULL;
+}
+
+/* 依次查找 EBDA 的第 1KB，基本内存的最后 1KB 及 BIOS ROM */
+static struct mp_fps* mp_fps_find(void) {
+    struct mp_fps* fps = NULL;
+    uint32_t ebda = (uint32_t)(*(uint16_t*)PHY_LOW_TO_VIR(0x40e)) << 4;
+    if(ebda != 0 && (fps = mp_fps_search(ebda, 1024)) != NULL) {
+        return fps;
+    }
+    uint32_t base_mem_kb = *(uint16_t*)PHY_LOW_TO_VIR(0x413);
+    if(base_mem_kb != 0 && (fps = mp_fps_search(base_mem_kb * 1024 - 1024, 1024)) != NULL) {
+        return fps;
+    }
+    return mp_fps_search(0xf0000, 0x10000);
+}
+
+/* 解析 MP 配置表，得到各处理器的 apic id 及 local apic 地址，返回处理器数 */
+static uint8_t mp_config_parse(void) {
+    struct mp_fps* fps = mp_fps_find();
+    /* 只支持配置表位于低 1MB 的情况（bochs、qemu 均如此），否则按单处理器运行 */
+    if(fps == NULL || fps->feature[0] != 0 || fps->config_addr == 0 || fps->config_addr >= 0x100000) {
+        return 1;
+    }
+    struct mp_config* conf = PHY_LOW_TO_VIR(fps->config_addr);
+    if(memcmp(conf->signature, "PCMP", 4) || !mp_checksum(conf, conf->length)) {
+        return 1;
+    }
+    lapic_phy_addr = conf->lapic_addr;
+
+    uint8_t cnt = 1; /* cpus[0] 留给 BSP */
+    uint8_t* entry = (uint8_t*)(conf + 1);
+    uint16_t entry_idx;
+    for(entry_idx = 0; entry_idx < conf->entry_cnt; entry_idx++) {
+        if(*entry != MP_ENTRY_PROCESSOR) {
+            entry += 8;
+            continue;
+        }
+        struct mp_processor* proc = (struct mp_processor*)entry;
+        entry += sizeof(struct mp_processor);
+        if(!(proc->cpu_flags & MP_CPU_ENABLED)) {
+            continue;
+        }
+        if(proc->cpu_flags & MP_CPU_BSP) {
+            cpus[0].apic_id = proc->apic_id;
+        } else if(cnt < NR_CPUS) {
+            cpus[cnt++].apic_id = proc->apic_id;
+        }
+    }
+    return cnt;
+}
+
+/* 启动逻辑编号为 id 的 AP，成功返回 true */
+static bool smp_boot_ap(uint8_t id) {
+    struct cpu* pcpu = &cpus[id];
+    uint8_t apic_id = pcpu->apic_id;
+    cpu_init(pcpu, id);
+    pcpu->apic_id = apic_id;
+
+    char name[] = "idle0";
+    name[4] = '0' + id;
+    struct task_struct* idle = thread_idle_create(pcpu, name);
+    /* AP 直接在 idle 线程的内核栈上运行 */
+    *(uint32_t*)PHY_LOW_TO_VIR(AP_TRAMPOLINE_BASE + (ap_stack_top - ap_trampoline_start)) = (uint32_t)idle + PG_SIZE;
+
+    lapic_startup_ap(apic_id, AP_TRAMPOLINE_BASE);
+    /* 最多等待 1s */
+    uint32_t wait_cnt = 1000;
+    while(!pcpu->started && wait_cnt--) {
+        timer_udelay(1000);
+    }
+    return pcpu->started;
+}
+
+/* 解析 MP 表并通过 INIT-SIPI-SIPI 启动所有 AP */
+void smp_init(void) {
+    put_str("smp_init start\n");
+    uint8_t mp_cpu_cnt = mp_config_parse();
+    if(mp_cpu_cnt <= 1) {
+        put_str("   no mp table, uniprocessor\n");
+        put_str("smp_init done\n");
+        return;
+    }
+
+    lapic_init(true);
+    cpus[0].apic_id = lapic_id();
+    lapic_timer_calibrate();
+    intr_handler_register(LAPIC_TIMER_VECTOR, lapic_timer_intr_handler);
+    intr_handler_register(LAPIC_RESCHED_VECTOR, resched_intr_handler);
+    intr_handler_register(LAPIC_TLB_VECTOR, tlb_flush_intr_handler);
+    cpus[0].started = true;
+
+    /* 复制 AP 启动代码到 1MB 以内 4K 对齐处 */
+    memcpy(PHY_LOW_TO_VIR(AP_TRAMPOLINE_BASE), ap_trampoline_start, ap_trampoline_end - ap_trampoline_start);
+
+    uint8_t id;
+    for(id = 1; id < mp_cpu_cnt; id++) {
+        if(!smp_boot_ap(id)) {
+            put_str("   ap start failed, apic id: 0x");
+            put_int(cpus[id].apic_id);
+            put_char('\n');
+            break;
+        }
+        /* AP 初始化完成后才参与任务分配 */
+        cpu_cnt = id + 1;
+    }
+    put_str("   cpu count: 0x");
+    put_int(cpu_cnt);
+    put_char('\n');
+    put_str("smp_init done\n");
+}
+
+/* AP 进入保护模式并开启分页后的 C 入口，运行在本处理器 idle 线程的栈上 */
+void ap_main(void) {
+    struct task_struct* idle = thread_running();
+    struct cpu* pcpu = idle->cpu;
+    ASSERT(pcpu->idle == idle);
+
+    idt_load();
+    tss_ap_init(pcpu->id);
+    fpu_ap_init();
+    page_global_enable();
+    page_write_protect_enable();
+    lapic_init(false);
+    lapic_timer_start();
+
+    idle->status = TASK_RUNNING;
+    pcpu->started = true;
+    intr_enable();
+    thread_idle(NULL);
+}
@@ -0,0 +1,57 @@
+#ifndef __KERNEL_SMP_H
+#define __KERNEL_SMP_H
+
+#include "global.h"
+#include "list.h"
+#include "sync.h"
+#include "thread.h"
+
+#define NR_CPUS 4 /* 最多支持的处理器数，GDT 中为每个处理器预留一个 TSS 描述符 */
+
+/* AP 启动代码被复制到的物理地址（原 kernel.bin 的加载缓冲区，内核运行后不再使用），SIPI 向量为其页号 */
+#define AP_TRAMPOLINE_BASE  0x70000
+
+/* 每个处理器的数据 */
+struct cpu {
+    uint8_t id; /* 逻辑编号，0 为 BSP */
+    uint8_t apic_id; /* local apic id */
+    volatile bool started; /* AP 是否已完成初始化 */
+    struct task_struct* idle; /* 本处理器的 idle 线程 */
+
+    spinlock_t rq_lock; /* 保护就绪队列，调度期间一直持有到 switch_to 完成 */
+    struct list ready_list; /* 本处理器的就绪队列 */
+    uint32_t nr_ready; /* 就绪队列长度，负载均衡使用 */
+    uint32_t balance_ticks; /* 距离下一次负载均衡的时钟数 */
+
+    struct task_struct* fpu_owner; /* 本处理器 FPU 寄存器属于哪个任务 */
+    uint32_t cr3; /* 当前加载的页目录物理地址，内核线程沿用上一个任务的地址空间 */
+};
+
+extern struct cpu cpus[NR_CPUS];
+extern uint8_t cpu_cnt; /* 已上线的处理器数 */
+
+/* 初始化逻辑编号为 id 的处理器数据 */
+void cpu_init(struct cpu* pcpu, uint8_t id);
+
+/* 当前处理器 */
+struct cpu* cpu_current(void);
+
+/* 向处理器 pcpu 发送重新调度的 IPI，唤醒其 hlt */
+void smp_send_resched(struct cpu* pcpu);
+
+/* 通知其他处理器刷新 TLB 中的非全局页并等待完成，内核空间映射被撤销后调用 */
+void smp_tlb_flush_others(void);
+
+/* 页目录 pgdir_phy 即将被释放：让所有仍加载着它的处理器换成内核页目录并等待完成 */
+void smp_pgdir_release(uint32_t pgdir_phy);
+
+/* 完成发给本处理器的 TLB 刷新请求，关中断忙等时调用，避免与等待本处理器刷新的处理器互相等待 */
+void smp_tlb_poll(void);
+
+/* 解析 MP 表并通过 INIT-SIPI-SIPI 启动所有 AP */
+void smp_init(void);
+
+/* AP 进入保护模式并开启分页后的 C 入口 */
+void ap_main(void);
+
+#endif /* __KERNEL_SMP_H */
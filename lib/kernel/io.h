@@ -15,6 +15,14 @@ static inline void outb(uint16_t port, uint8_t data) {
     asm volatile("outb %b0, %w1" : : "a" (data), "Nd" (port));
 }
 
+static inline void outw(uint16_t port, uint16_t data) {
+    asm volatile("outw %w0, %w1" : : "a" (data), "Nd" (port));
+}
+
+static inline void outl(uint16_t port, uint32_t data) {
+    asm volatile("outl %0, %w1" : : "a" (data), "Nd" (port));
+}
+
 static inline void outsw(uint16_t port, const void* addr, uint32_t word_cnt) {
     asm volatile("cld; rep outsw" : "+S" (addr), "+c" (word_cnt) : "d" (port));
 }
@@ -30,6 +38,18 @@ static inline uint8_t inb(uint16_t port) {
     return data;
 }
 
+static inline uint16_t inw(uint16_t port) {
+    uint16_t data;
+    asm volatile("inw %w1, %w0" : "=a" (data) : "Nd" (port));
+    return data;
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t data;
+    asm volatile("inl %w1, %0" : "=a" (data) : "Nd" (port));
+    return data;
+}
+
 static inline void insw(uint16_t port, void* addr, uint32_t word_cnt) {
     asm volatile("cld; rep insw" : "+D" (addr), "+c" (word_cnt) : "d" (port) : "memory");
 }
@@ -1,54 +1,147 @@
 #include "syscall.h"
 
+#define CPUID_EDX_SEP (1 << 11)
+
+/* 是否可用 sysenter 进入内核：-1 表示尚未检测 */
+static int8_t sysenter_state = -1;
+
+/* 是否运行在 3 特权级，用户库同样会被内核线程调用 */
+static bool user_mode(void) {
+    uint32_t cs;
+    asm volatile("movl %%cs, %0" : "=r" (cs));
+    return (cs & 3) == 3;
+}
+
+/* 与内核 tss.c 相同的判断条件，只有 3 特权级才能用 sysexit 返回 */
+static bool sysenter_usable(void) {
+    if(!user_mode()) {
+        return false;
+    }
+    if(sysenter_state < 0) {
+        uint32_t eax = 1, ebx, ecx, edx;
+        asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+        uint32_t family = (eax >> 8) & 0xf, model = (eax >> 4) & 0xf, stepping = eax & 0xf;
+        sysenter_state = (edx & CPUID_EDX_SEP) && !(family == 6 && model < 3 && stepping < 3);
+    }
+    return sysenter_state;
+}
+
+/* sysenter 约定：eax 子功能号，ebx、esi、edi 为参数，ecx 保存用户栈顶，edx 保存返回地址 */
+#define SYSENTER \
+    "movl %%esp, %%ecx\n\t"\
+    "movl $1f, %%edx\n\t"\
+    "sysenter\n"\
+    "1:"
+
 #define _syscall0(NUMBER) ({\
     int retval;\
-    asm volatile (\
-        "int $0x80"\
-        : "=a" (retval)\
-        : "a" (NUMBER)\
-        : "memory"\
-    );\
+    if(sysenter_usable()) {\
+        asm volatile (\
+            SYSENTER\
+            : "=a" (retval)\
+            : "a" (NUMBER)\
+            : "ecx", "edx", "memory"\
+        );\
+    } else {\
+        asm volatile (\
+            "int $0x80"\
+            : "=a" (retval)\
+            : "a" (NUMBER)\
+            : "memory"\
+        );\
+    }\
     retval;\
 })
 
 #define _syscall1(NUMBER, ARG1) ({\
     int retval;\
-    asm volatile (\
-        "int $0x80"\
-        : "=a" (retval)\
-        : "a" (NUMBER), "b" (ARG1)\
-        : "memory"\
-    );\
+    if(sysenter_usable()) {\
+        asm volatile (\
+            SYSENTER\
+            : "=a" (retval)\
+            : "a" (NUMBER), "b" (ARG1)\
+            : "ecx", "edx", "memory"\
+        );\
+    } else {\
+        asm volatile (\
+            "int $0x80"\
+            : "=a" (retval)\
+            : "a" (NUMBER), "b" (ARG1)\
+            : "memory"\
+        );\
+    }\
     retval;\
 })
 
 #define _syscall2(NUMBER, ARG1, ARG2) ({\
     int retval;\
-    asm volatile (\
-        "int $0x80"\
-        : "=a" (retval)\
-        : "a" (NUMBER), "b" (ARG1), "c" (ARG2)\
-        : "memory"\
-    );\
+    if(sysenter_usable()) {\
+        asm volatile (\
+            SYSENTER\
+            : "=a" (retval)\
+            : "a" (NUMBER), "b" (ARG1), "S" (ARG2)\
+            : "ecx", "edx", "memory"\
+        );\
+    } else {\
+        asm volatile (\
+            "int $0x80"\
+            : "=a" (retval)\
+            : "a" (NUMBER), "b" (ARG1), "c" (ARG2)\
+            : "memory"\
+        );\
+    }\
     retval;\
 })
 
 #define _syscall3(NUMBER, ARG1, ARG2, ARG3) ({\
     int retval;\
-    asm volatile (\
-        "int $0x80"\
-        : "=a" (retval)\
-        : "a" (NUMBER), "b" (ARG1), "c" (ARG2), "d" (ARG3)\
-        : "memory"\
-    );\
+    if(sysenter_usable()) {\
+        asm volatile (\
+            SYSENTER\
+            : "=a" (retval)\
+            : "a" (NUMBER), "b" (ARG1), "S" (ARG2), "D" (ARG3)\
+            : "ecx", "edx", "memory"\
+        );\
+    } else {\
+        asm volatile (\
+            "int $0x80"\
+            : "=a" (retval)\
+            : "a" (NUMBER), "b" (ARG1), "c" (ARG2), "d" (ARG3)\
+            : "memory"\
+        );\
+    }\
     retval;\
 })
 
-/* get current process id */
+/* get current process id，用户进程直接读取 vdso 数据页 */
 uint32_t getpid(void) {
+    if(user_mode()) {
+        return ((const struct vdso_proc*)VDSO_PROC_VADDR)->pid;
+    }
     return _syscall0(SYS_GETPID);
 }
 
+/* vdso 数据页：内核线程没有映射，使用内核中的地址 */
+static const struct vdso_data* vdso_data_get(void) {
+    return user_mode() ? (const struct vdso_data*)VDSO_DATA_VADDR : vdso_data;
+}
+
+/* 开中断以来的时钟中断数 */
+uint32_t uptime_ticks(void) {
+    return vdso_data_get()->ticks;
+}
+
+/* 开中断以来的毫秒数，精度为一个时钟中断周期 */
+uint32_t uptime_mtime(void) {
+    const struct vdso_data* vdata = vdso_data_get();
+    return vdata->ticks * vdata->mtime_per_tick;
+}
+
+/* 获取时钟参数 */
+void clock_info(struct vdso_data* info) {
+    *info = *vdso_data_get();
+}
+
 /* memory allocate */
 void* malloc(uint32_t size) {
     return (void*)_syscall1(SYS_MALLOC, size);
@@ -154,7 +247,170 @@ void ps(void) {
     _syscall0(SYS_PS);
 }
 
+/* copy locker contention statistics into buf (at most size bytes), reset them if clear is not 0, return bytes copied */
+int lockstat(char* buf, uint32_t size, uint32_t clear) {
+    return (int)_syscall3(SYS_LOCKSTAT, buf, size, clear);
+}
+
+/* create a pipe, pipefd[0] is read end, pipefd[1] is write end */
+int pipe(int32_t pipefd[2]) {
+    return (int)_syscall2(SYS_PIPE, pipefd, 0);
+}
+
+/* create a pipe with flags (O_NONBLOCK) on both ends */
+int pipe2(int32_t pipefd[2], uint8_t flags) {
+    return (int)_syscall2(SYS_PIPE, pipefd, flags);
+}
+
+/* make newfd be the copy of oldfd, closing newfd first if necessary */
+int dup2(int oldfd, int newfd) {
+    return (int)_syscall2(SYS_DUP2, oldfd, newfd);
+}
+
+/* wait for one of fds to become ready, timeout in ms, -1 : forever */
+int poll(struct pollfd* fds, uint32_t nfds, int32_t timeout) {
+    return (int)_syscall3(SYS_POLL, fds, nfds, timeout);
+}
+
+/* open message queue name, create it with attr (NULL : default) if not exist */
+int mq_open(const char* name, const struct mq_attr* attr) {
+    return (int)_syscall2(SYS_MQ_OPEN, name, attr);
+}
+
+/* close message queue mqd */
+int mq_close(int mqd) {
+    return (int)_syscall1(SYS_MQ_CLOSE, mqd);
+}
+
+/* send msg by priority, wait at most timeout ms while queue is full, -1 : forever */
+int mq_send(int mqd, const struct mq_msg* msg, int32_t timeout) {
+    return (int)_syscall3(SYS_MQ_SEND, mqd, msg, timeout);
+}
+
+/* receive the oldest message of highest priority, wait at most timeout ms while queue is empty, return message length */
+int mq_receive(int mqd, struct mq_msg* msg, int32_t timeout) {
+    return (int)_syscall3(SYS_MQ_RECEIVE, mqd, msg, timeout);
+}
+
+/* print syscall counts & latency of process pid (0 : global), clear them after printing if clear != 0 */
+void sysstat(pid_t pid, uint32_t clear) {
+    _syscall2(SYS_SYSSTAT, pid, clear);
+}
+
+/* trace syscalls of process pid, op : STRACE_ON / STRACE_OFF / STRACE_DUMP */
+int strace(uint32_t op, pid_t pid) {
+    return (int)_syscall2(SYS_STRACE, op, pid);
+}
+
+/* create process running program path directly, without copying the caller, actions may be NULL, return child pid */
+pid_t spawn(const char* path, const char* argv[], const struct spawn_file_actions* actions) {
+    return (pid_t)_syscall3(SYS_SPAWN, path, argv, actions);
+}
+
+/* write all modified disk sectors back to disk */
+void sync(void) {
+    _syscall0(SYS_SYNC);
+}
+
+/* write modified disk sectors of file fd back to disk, return -1 if fd is not a file */
+int fsync(int32_t fd) {
+    return (int)_syscall1(SYS_FSYNC, fd);
+}
+
+/* clear file actions */
+void spawn_actions_init(struct spawn_file_actions* actions) {
+    actions->cnt = 0;
+}
+
+/* 追加一个文件描述符操作，已满返回 -1 */
+static int spawn_action_add(struct spawn_file_actions* actions, uint32_t op, int32_t fd, int32_t newfd) {
+    if(actions->cnt == SPAWN_ACTIONS_MAX) {
+        return -1;
+    }
+    struct spawn_action* act = &actions->actions[actions->cnt++];
+    act->op = op;
+    act->fd = fd;
+    act->newfd = newfd;
+    return 0;
+}
+
+/* add dup2(fd, newfd) to file actions, return -1 if full */
+int spawn_actions_dup2(struct spawn_file_actions* actions, int32_t fd, int32_t newfd) {
+    return spawn_action_add(actions, SPAWN_DUP2, fd, newfd);
+}
+
+/* add close(fd) to file actions, return -1 if full */
+int spawn_actions_close(struct spawn_file_actions* actions, int32_t fd) {
+    return spawn_action_add(actions, SPAWN_CLOSE, fd, 0);
+}
+
+/* create submission & completion rings of current process, store ring address to *ring, return ring descriptor */
+int uring_setup(struct uring** ring) {
+    return (int)_syscall1(SYS_URING_SETUP, ring);
+}
+
+/* start submitted entries, wait at most timeout ms for min_complete completions, return completions available */
+int uring_enter(int rd, uint32_t min_complete, int32_t timeout) {
+    return (int)_syscall3(SYS_URING_ENTER, rd, min_complete, timeout);
+}
+
+/* next free submission entry, NULL if submission queue is full */
+struct uring_sqe* uring_sqe_get(struct uring* ring) {
+    if(ring->sq_tail - ring->sq_head >= URING_SQ_ENTRIES) {
+        return NULL;
+    }
+    struct uring_sqe* sqe = &ring->sqes[ring->sq_tail % URING_SQ_ENTRIES];
+    memset(sqe, 0, sizeof(struct uring_sqe));
+    return sqe;
+}
+
+/* publish the entry got by uring_sqe_get to kernel, takes effect on next uring_enter */
+void uring_sqe_submit(struct uring* ring) {
+    /* 提交项写完后才能推进 sq_tail */
+    asm volatile("" : : : "memory");
+    ring->sq_tail++;
+}
+
+/* oldest completion entry, NULL if none */
+struct uring_cqe* uring_cqe_peek(struct uring* ring) {
+    if(ring->cq_head == ring->cq_tail) {
+        return NULL;
+    }
+    return &ring->cqes[ring->cq_head % URING_CQ_ENTRIES];
+}
+
+/* mark the entry got by uring_cqe_peek as consumed */
+void uring_cqe_seen(struct uring* ring) {
+    asm volatile("" : : : "memory");
+    ring->cq_head++;
+}
+
 /* The  exec()  family  of functions replaces the current process image with a new process image. */
 int execv(const char *path, const char *argv[]) {
     return (int)_syscall2(SYS_EXECV, path, argv);
 }
+
+/* FUTEX_WAIT : sleep while *uaddr == val; FUTEX_WAKE : wake up at most val waiters */
+int futex(uint32_t* uaddr, int op, uint32_t val) {
+    return _syscall3(SYS_FUTEX, uaddr, op, val);
+}
+
+/* terminate calling thread, return from thread function is the same */
+void uthread_exit(void* status) {
+    _syscall1(SYS_THREAD_EXIT, status);
+}
+
+/* 新线程在用户态的入口，线程函数返回即退出 */
+static void uthread_entry(uthread_func* func, void* arg) {
+    uthread_exit(func(arg));
+}
+
+/* create thread sharing address space & files with current process, return thread id or -1 */
+pid_t uthread_create(uthread_func* func, void* arg) {
+    return _syscall3(SYS_THREAD_CREATE, uthread_entry, func, arg);
+}
+
+/* wait for thread tid to exit, store its return value to status */
+int uthread_join(pid_t tid, void** status) {
+    return _syscall2(SYS_THREAD_JOIN, tid, status);
+}
@@ -4,6 +4,13 @@
 #include "global.h"
 #include "thread.h"
 #include "fs.h"
+#include "futex.h"
+#include "poll.h"
+#include "mqueue.h"
+#include "vdso.h"
+#include "uring.h"
+#include "sysstat.h"
+#include "spawn.h"
 
 enum SYSCALL_NR {
     SYS_GETPID = 0,
@@ -28,12 +35,40 @@ enum SYSCALL_NR {
     SYS_REWINDDIR,
     SYS_STAT,
     SYS_PS,
-    SYS_EXECV
+    SYS_EXECV,
+    SYS_FUTEX,
+    SYS_THREAD_CREATE,
+    SYS_THREAD_JOIN,
+    SYS_THREAD_EXIT,
+    SYS_LOCKSTAT,
+    SYS_PIPE,
+    SYS_DUP2,
+    SYS_POLL,
+    SYS_MQ_OPEN,
+    SYS_MQ_CLOSE,
+    SYS_MQ_SEND,
+    SYS_MQ_RECEIVE,
+    SYS_URING_SETUP,
+    SYS_URING_ENTER,
+    SYS_SYSSTAT,
+    SYS_STRACE,
+    SYS_SPAWN,
+    SYS_SYNC,
+    SYS_FSYNC
 };
 
 /* get current process id */
 uint32_t getpid(void);
 
+/* ticks since interrupts were enabled, read from vdso page without trapping */
+uint32_t uptime_ticks(void);
+
+/* milliseconds since interrupts were enabled, resolution is one tick */
+uint32_t uptime_mtime(void);
+
+/* copy clock frequency & calibration data */
+void clock_info(struct vdso_data* info);
+
 /* memory allocate */
 void *malloc(uint32_t size);
 
@@ -97,7 +132,91 @@ int stat(const char* pathname, struct stat* buf);
 /* list tasks' info */
 void ps(void);
 
+/* copy locker contention statistics into buf (at most size bytes), reset them if clear is not 0, return bytes copied */
+int lockstat(char* buf, uint32_t size, uint32_t clear);
+
+/* create a pipe, pipefd[0] is read end, pipefd[1] is write end */
+int pipe(int32_t pipefd[2]);
+
+/* create a pipe with flags (O_NONBLOCK) on both ends */
+int pipe2(int32_t pipefd[2], uint8_t flags);
+
+/* make newfd be the copy of oldfd, closing newfd first if necessary */
+int dup2(int oldfd, int newfd);
+
+/* wait for one of fds to become ready, timeout in ms, -1 : forever */
+int poll(struct pollfd* fds, uint32_t nfds, int32_t timeout);
+
+/* open message queue name, create it with attr (NULL : default) if not exist */
+int mq_open(const char* name, const struct mq_attr* attr);
+
+/* close message queue mqd */
+int mq_close(int mqd);
+
+/* send msg by priority, wait at most timeout ms while queue is full, -1 : forever */
+int mq_send(int mqd, const struct mq_msg* msg, int32_t timeout);
+
+/* receive the oldest message of highest priority, wait at most timeout ms while queue is empty, return message length */
+int mq_receive(int mqd, struct mq_msg* msg, int32_t timeout);
+
+/* print syscall counts & latency of process pid (0 : global), clear them after printing if clear != 0 */
+void sysstat(pid_t pid, uint32_t clear);
+
+/* trace syscalls of process pid, op : STRACE_ON / STRACE_OFF / STRACE_DUMP */
+int strace(uint32_t op, pid_t pid);
+
+/* create submission & completion rings of current process, store ring address to *ring, return ring descriptor */
+int uring_setup(struct uring** ring);
+
+/* start submitted entries, wait at most timeout ms for min_complete completions, return completions available */
+int uring_enter(int rd, uint32_t min_complete, int32_t timeout);
+
+/* next free submission entry, NULL if submission queue is full */
+struct uring_sqe* uring_sqe_get(struct uring* ring);
+
+/* publish the entry got by uring_sqe_get to kernel, takes effect on next uring_enter */
+void uring_sqe_submit(struct uring* ring);
+
+/* oldest completion entry, NULL if none */
+struct uring_cqe* uring_cqe_peek(struct uring* ring);
+
+/* mark the entry got by uring_cqe_peek as consumed */
+void uring_cqe_seen(struct uring* ring);
+
+/* create process running program path directly, without copying the caller, actions may be NULL, return child pid */
+pid_t spawn(const char* path, const char* argv[], const struct spawn_file_actions* actions);
+
+/* clear file actions */
+void spawn_actions_init(struct spawn_file_actions* actions);
+
+/* add dup2(fd, newfd) to file actions, return -1 if full */
+int spawn_actions_dup2(struct spawn_file_actions* actions, int32_t fd, int32_t newfd);
+
+/* add close(fd) to file actions, return -1 if full */
+int spawn_actions_close(struct spawn_file_actions* actions, int32_t fd);
+
+/* write all modified disk sectors back to disk */
+void sync(void);
+
+/* write modified disk sectors of file fd back to disk, return -1 if fd is not a file */
+int fsync(int32_t fd);
+
 /* The  exec()  family  of functions replaces the current process image with a new process image. */
 int execv(const char *path, const char *argv[]);
 
+/* FUTEX_WAIT : sleep while *uaddr == val; FUTEX_WAKE : wake up at most val waiters */
+int futex(uint32_t* uaddr, int op, uint32_t val);
+
+/* user thread function type */
+typedef void* uthread_func(void* arg);
+
+/* create thread sharing address space & files with current process, return thread id or -1 */
+pid_t uthread_create(uthread_func* func, void* arg);
+
+/* wait for thread tid to exit, store its return value to status */
+int uthread_join(pid_t tid, void** status);
+
+/* terminate calling thread, return from thread function is the same */
+void uthread_exit(void* status);
+
 #endif /* __LIB_USER_SYSCALL_H */
\ No newline at end of file
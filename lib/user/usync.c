@@ -0,0 +1,113 @@
+#include "usync.h"
+#include "syscall.h"
+
+/* 若 *ptr == old 则置为 new，返回 *ptr 原来的值 */
+static uint32_t atomic_cmpxchg(volatile uint32_t* ptr, uint32_t old, uint32_t new) {
+    uint32_t prev;
+    asm volatile("lock cmpxchgl %2, %1" : "=a" (prev), "+m" (*ptr) : "r" (new), "0" (old) : "memory");
+    return prev;
+}
+
+/* 将 *ptr 置为 val，返回原来的值 */
+static uint32_t atomic_xchg(volatile uint32_t* ptr, uint32_t val) {
+    asm volatile("xchgl %0, %1" : "+r" (val), "+m" (*ptr) : : "memory");
+    return val;
+}
+
+/* *ptr 加 val，返回原来的值 */
+static uint32_t atomic_add(volatile uint32_t* ptr, uint32_t val) {
+    asm volatile("lock xaddl %0, %1" : "+r" (val), "+m" (*ptr) : : "memory");
+    return val;
+}
+
+/* mutex operation */
+void umutex_init(umutex_t* pmutex) {
+    pmutex->state = 0;
+}
+
+void umutex_lock(umutex_t* pmutex) {
+    /* fast path : 0 -> 1 */
+    uint32_t state = atomic_cmpxchg(&pmutex->state, 0, 1);
+    if(state == 0) {
+        return;
+    }
+    /* 标记有等待者，直到换回 0 即获得锁 */
+    if(state != 2) {
+        state = atomic_xchg(&pmutex->state, 2);
+    }
+    while(state != 0) {
+        futex((uint32_t*)&pmutex->state, FUTEX_WAIT, 2);
+        state = atomic_xchg(&pmutex->state, 2);
+    }
+}
+
+bool umutex_trylock(umutex_t* pmutex) {
+    return atomic_cmpxchg(&pmutex->state, 0, 1) == 0;
+}
+
+void umutex_unlock(umutex_t* pmutex) {
+    /* 原来为 1 说明没有等待者，不进入内核 */
+    if(atomic_xchg(&pmutex->state, 0) == 2) {
+        futex((uint32_t*)&pmutex->state, FUTEX_WAKE, 1);
+    }
+}
+
+/* condition variable operation */
+void ucond_init(ucond_t* pcond) {
+    pcond->seq = 0;
+}
+
+void ucond_wait(ucond_t* pcond, umutex_t* pmutex) {
+    uint32_t seq = pcond->seq;
+    umutex_unlock(pmutex);
+    /* 释放锁之后 seq 若已改变，futex 立即返回，不会错过通知 */
+    futex((uint32_t*)&pcond->seq, FUTEX_WAIT, seq);
+    /* 被唤醒时可能还有其他等待者，按有竞争的方式加锁 */
+    while(atomic_xchg(&pmutex->state, 2) != 0) {
+        futex((uint32_t*)&pmutex->state, FUTEX_WAIT, 2);
+    }
+}
+
+void ucond_signal(ucond_t* pcond) {
+    atomic_add(&pcond->seq, 1);
+    futex((uint32_t*)&pcond->seq, FUTEX_WAKE, 1);
+}
+
+void ucond_broadcast(ucond_t* pcond) {
+    atomic_add(&pcond->seq, 1);
+    futex((uint32_t*)&pcond->seq, FUTEX_WAKE, 0xffffffff);
+}
+
+/* semaphore operation */
+void usem_init(usem_t* psem, uint32_t value) {
+    psem->value = value;
+    psem->waiters = 0;
+}
+
+bool usem_trywait(usem_t* psem) {
+    uint32_t value = psem->value;
+    while(value > 0) {
+        uint32_t prev = atomic_cmpxchg(&psem->value, value, value - 1);
+        if(prev == value) {
+            return true;
+        }
+        value = prev;
+    }
+    return false;
+}
+
+void usem_wait(usem_t* psem) {
+    while(!usem_trywait(psem)) {
+        atomic_add(&psem->waiters, 1);
+        /* value 仍为 0 才睡眠，post 先加 value 再检查 waiters，不会丢失唤醒 */
+        futex((uint32_t*)&psem->value, FUTEX_WAIT, 0);
+        atomic_add(&psem->waiters, (uint32_t)-1);
+    }
+}
+
+void usem_post(usem_t* psem) {
+    atomic_add(&psem->value, 1);
+    if(psem->waiters > 0) {
+        futex((uint32_t*)&psem->value, FUTEX_WAKE, 1);
+    }
+}
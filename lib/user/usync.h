@@ -0,0 +1,49 @@
+#ifndef __LIB_USER_USYNC_H
+#define __LIB_USER_USYNC_H
+
+#include "stdint.h"
+#include "global.h"
+
+/*
+ * 基于 futex 的用户态同步原语：无竞争时只做原子操作，不进入内核
+ * 同一进程的多个线程（或映射同一物理页的进程）之间使用
+ */
+
+/* mutex : state 0 未加锁，1 已加锁无等待者，2 已加锁可能有等待者 */
+typedef struct {
+    volatile uint32_t state;
+}umutex_t;
+
+/* condition variable : 每次 signal/broadcast 递增 seq */
+typedef struct {
+    volatile uint32_t seq;
+}ucond_t;
+
+/* semaphore */
+typedef struct {
+    volatile uint32_t value;
+    volatile uint32_t waiters; /* 在 futex 中等待的任务数，为 0 时 post 不进入内核 */
+}usem_t;
+
+/* mutex operation */
+void umutex_init(umutex_t* pmutex);
+void umutex_lock(umutex_t* pmutex);
+/* umutex_trylock return true if get mutex */
+bool umutex_trylock(umutex_t* pmutex);
+void umutex_unlock(umutex_t* pmutex);
+
+/* condition variable operation */
+void ucond_init(ucond_t* pcond);
+/* ucond_wait release pmutex & wait, get pmutex again before return. 可能被虚假唤醒 */
+void ucond_wait(ucond_t* pcond, umutex_t* pmutex);
+void ucond_signal(ucond_t* pcond);
+void ucond_broadcast(ucond_t* pcond);
+
+/* semaphore operation */
+void usem_init(usem_t* psem, uint32_t value);
+void usem_wait(usem_t* psem);
+/* usem_trywait return true if decrements semaphore */
+bool usem_trywait(usem_t* psem);
+void usem_post(usem_t* psem);
+
+#endif /* __LIB_USER_USYNC_H */
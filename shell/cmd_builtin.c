@@ -70,6 +70,76 @@ void ps_builtin(int argc, char** argv UNUSED) {
     ps();
 }
 
+#define LOCKSTAT_BUF_SIZE 8192 /* 统计信息的缓冲区大小，与内核的格式化缓冲相同 */
+
+/* usage: lockstat [-c], -c 输出后清零 */
+void lockstat_builtin(int argc, char** argv) {
+    uint32_t clear = 0;
+    if(argc == 2 && !strcmp(argv[1], "-c")) {
+        clear = 1;
+    } else if(argc != 1) {
+        printf("usage: lockstat [-c]\n");
+        return;
+    }
+    char* buf = malloc(LOCKSTAT_BUF_SIZE);
+    if(buf == NULL) {
+        printf("lockstat: malloc failed\n");
+        return;
+    }
+    int len = lockstat(buf, LOCKSTAT_BUF_SIZE, clear);
+    if(len > 0) {
+        write(stdout_no, buf, len);
+    }
+    free(buf);
+}
+
+/* 十进制字符串转换为 pid，不是合法数字返回 -1 */
+static pid_t str2pid(const char* str) {
+    int32_t pid = 0;
+    if(*str == 0) {
+        return -1;
+    }
+    for(; *str != 0; str++) {
+        if(*str < '0' || *str > '9' || pid > 0x7fff) {
+            return -1;
+        }
+        pid = pid * 10 + (*str - '0');
+    }
+    return pid > 0x7fff ? -1 : (pid_t)pid;
+}
+
+/* usage: sysstat [-c] [pid]，不指定 pid 输出全局统计，-c 输出后清零 */
+void sysstat_builtin(int argc, char** argv) {
+    uint32_t clear = 0;
+    pid_t pid = 0;
+    int idx;
+    for(idx = 1; idx < argc; idx++) {
+        if(!strcmp(argv[idx], "-c")) {
+            clear = 1;
+        } else if((pid = str2pid(argv[idx])) < 0) {
+            printf("usage: sysstat [-c] [pid]\n");
+            return;
+        }
+    }
+    sysstat(pid, clear);
+}
+
+/* usage: strace on pid | off | dump */
+void strace_builtin(int argc, char** argv) {
+    if(argc == 3 && !strcmp(argv[1], "on")) {
+        pid_t pid = str2pid(argv[2]);
+        if(pid <= 0 || strace(STRACE_ON, pid) == -1) {
+            printf("strace: no such process %s\n", argv[2]);
+        }
+    } else if(argc == 2 && !strcmp(argv[1], "off")) {
+        strace(STRACE_OFF, 0);
+    } else if(argc == 2 && !strcmp(argv[1], "dump")) {
+        strace(STRACE_DUMP, 0);
+    } else {
+        printf("usage: strace on pid | off | dump\n");
+    }
+}
+
 void ls_builtin(int argc, char** argv) {
     /* 遍历除命令 ls 之后的参数名 */
     char* pathname = NULL; /* 记录路径参数 */
@@ -285,7 +355,9 @@ void touch_builtin(int argc, char** argv) {
 
 /* usage: echo content >> filename. '>>' is append. '>' is override. */
 void echo_builtin(int argc, char** argv) {
-    if(argc == 4) {
+    if(argc == 2) { /* 输出到标准输出，可以接管道 */
+        printf("%s\n", argv[1]);
+    } else if(argc == 4) {
         /* content */
         char* idx_start = argv[1];
         size_t cnt = strlen(argv[1]);
@@ -313,7 +385,7 @@ void echo_builtin(int argc, char** argv) {
         write(fd, idx_start, cnt);
         close(fd);
     } else {
-        printf("usage: echo content >>/> filename\nnote: '>>' is append. '>' is override\n") ;
+        printf("usage: echo content [>>/> filename]\nnote: '>>' is append. '>' is override\n") ;
     }
 }
 
@@ -327,8 +399,15 @@ void cat_builtin(int argc, char** argv) {
         write(stdout_no, __io_buf, SECTOR_SIZE);
         printf("\n");
         close(fd);
+    } else if(argc == 1) {
+        /* 没有文件名时读标准输入直到读完，用于管道：ls | cat */
+        int32_t cnt;
+        while((cnt = read(stdin_no, __io_buf, SECTOR_SIZE - 1)) > 0) {
+            __io_buf[cnt] = 0;
+            write(stdout_no, __io_buf, cnt);
+        }
     } else {
-        printf("usage: cat filename\n") ;
+        printf("usage: cat [filename]\n") ;
     }
 }
 
@@ -6,6 +6,15 @@
 /* ps builtin cmd */
 void ps_builtin(int agrc, char** argv);
 
+/* usage: lockstat [-c], -c 输出后清零 */
+void lockstat_builtin(int argc, char** argv);
+
+/* usage: sysstat [-c] [pid]，不指定 pid 输出全局统计，-c 输出后清零 */
+void sysstat_builtin(int argc, char** argv);
+
+/* usage: strace on pid | off | dump */
+void strace_builtin(int argc, char** argv);
+
 void ls_builtin(int argc, char** argv UNUSED) ;
 
 void pwd_builtin(int argc, char** argv UNUSED) ;
@@ -25,10 +34,10 @@ int rmdir_builtin(int argc, char** argv UNUSED) ;
 /* create file (read & write) */
 void touch_builtin(int argc, char** argv);
 
-/* usage: echo content >> filename. '>>' is append. '>' is override. */
+/* usage: echo content [>> filename]. '>>' is append. '>' is override. print to stdout without filename */
 void echo_builtin(int argc, char** argv);
 
-/* usage: cat filename*/
+/* usage: cat [filename], read stdin without filename */
 void cat_builtin(int argc, char** argv);
 
 int rm_builtin(int argc, char** argv UNUSED) ;
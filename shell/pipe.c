@@ -0,0 +1,142 @@
+#include "pipe.h"
+#include "memory.h"
+#include "fs.h"
+#include "ioqueue.h"
+#include "thread.h"
+#include "debug.h"
+#include "string.h"
+#include "poll.h"
+
+extern struct file __file_table[MAX_FILE_OPEN]; /* 文件表 */
+
+/* 管道对象，读端和写端各占一个文件表项，fd_inode 均指向它 */
+struct pipe {
+    ioqueue_t ioq;
+    char buf[PIPE_BUF_SIZE];
+};
+
+/* 文件表项 file 是否为管道的一端 */
+bool is_pipe(struct file* file) {
+    return (file->fd_flag & PIPE_FLAG) != 0;
+}
+
+/* 占用一个文件表项作为管道的一端 */
+static int32_t pipe_slot_alloc(struct pipe* pp, uint32_t flag) {
+    int32_t gfd = get_free_slot_in_global();
+    if(gfd == -1) {
+        return -1;
+    }
+    __file_table[gfd].fd_inode = (struct inode*)pp;
+    __file_table[gfd].fd_offset = 0;
+    __file_table[gfd].fd_flag = PIPE_FLAG | flag;
+    __file_table[gfd].fd_refs = 1;
+    return gfd;
+}
+
+/* 创建管道，pipefd[0] 为读端，pipefd[1] 为写端，flags 可为 O_NONBLOCK，成功返回 0，失败返回 -1 */
+int32_t sys_pipe(int32_t pipefd[2], uint8_t flags) {
+    if(flags & ~O_NONBLOCK) {
+        return -1;
+    }
+    ASSERT(sizeof(struct pipe) <= PG_SIZE);
+    struct pipe* pp = get_kernel_pages(1);
+    if(pp == NULL) {
+        return -1;
+    }
+    ioq_init(&pp->ioq, pp->buf, PIPE_BUF_SIZE);
+    int32_t* fd_table = thread_running()->group_leader->fd_table;
+    int32_t rd_gfd = -1, wr_gfd = -1, rd_fd = -1, wr_fd = -1;
+    if((rd_gfd = pipe_slot_alloc(pp, O_RDONLY | flags)) == -1 ||
+       (wr_gfd = pipe_slot_alloc(pp, O_WRONLY | flags)) == -1 ||
+       (rd_fd = pcb_fd_install(rd_gfd)) == -1 ||
+       (wr_fd = pcb_fd_install(wr_gfd)) == -1) {
+        /* 回滚 */
+        if(rd_fd != -1) {
+            fd_table[rd_fd] = -1;
+        }
+        if(wr_gfd != -1) {
+            memset(&__file_table[wr_gfd], 0, sizeof(struct file));
+        }
+        if(rd_gfd != -1) {
+            memset(&__file_table[rd_gfd], 0, sizeof(struct file));
+        }
+        ioq_destroy(&pp->ioq);
+        mfree_page(MPF_KERNEL, pp, 1);
+        return -1;
+    }
+    pipefd[0] = rd_fd;
+    pipefd[1] = wr_fd;
+    return 0;
+}
+
+/* 从管道读出至多 count 字节，管道空时阻塞（O_NONBLOCK 返回 -1），写端全部关闭且读空后返回 0 */
+int32_t pipe_read(struct file* file, void* buf, uint32_t count) {
+    ASSERT(is_pipe(file));
+    if((file->fd_flag & O_WRONLY)) {
+        return -1;
+    }
+    struct pipe* pp = (struct pipe*)file->fd_inode;
+    if(!(file->fd_flag & O_NONBLOCK)) {
+        return (int32_t)ioq_read_some(&pp->ioq, buf, count);
+    }
+    uint32_t got = ioq_try_read(&pp->ioq, buf, count);
+    if(got == 0 && count != 0 && !pp->ioq.wr_closed) {
+        return -1; /* 暂时没有数据 */
+    }
+    return (int32_t)got;
+}
+
+/* 向管道写入 count 字节，管道满时阻塞，读端全部关闭时返回 -1 */
+int32_t pipe_write(struct file* file, const void* buf, uint32_t count) {
+    ASSERT(is_pipe(file));
+    if(!(file->fd_flag & O_WRONLY)) {
+        return -1;
+    }
+    struct pipe* pp = (struct pipe*)file->fd_inode;
+    uint32_t written = 0;
+    if(pp->ioq.rd_closed) {
+        return -1;
+    }
+    if(file->fd_flag & O_NONBLOCK) {
+        written = ioq_try_write(&pp->ioq, buf, count);
+    } else {
+        written = ioq_write(&pp->ioq, buf, count);
+    }
+    /* 阻塞写一个字节都没写入说明没有读者了，非阻塞写则是管道已满 */
+    return written == 0 && count != 0 ? -1 : (int32_t)written;
+}
+
+/* 管道一端的就绪状态 POLLIN、POLLOUT、POLLHUP、POLLERR，*pwq 返回需要等待的队列 */
+uint16_t pipe_poll(struct file* file, wait_queue_t** pwq) {
+    ASSERT(is_pipe(file));
+    struct pipe* pp = (struct pipe*)file->fd_inode;
+    uint16_t revents = 0;
+    *pwq = &pp->ioq.pollq;
+    if(file->fd_flag & O_WRONLY) {
+        if(pp->ioq.rd_closed) {
+            revents |= POLLERR;
+        } else if(!ioq_full(&pp->ioq)) {
+            revents |= POLLOUT;
+        }
+    } else {
+        if(!ioq_empty(&pp->ioq)) {
+            revents |= POLLIN;
+        }
+        if(pp->ioq.wr_closed) {
+            revents |= POLLHUP;
+        }
+    }
+    return revents;
+}
+
+/* 管道一端的最后一个描述符关闭，两端都关闭后释放管道 */
+void pipe_release(struct file* file) {
+    ASSERT(is_pipe(file) && file->fd_refs == 0);
+    struct pipe* pp = (struct pipe*)file->fd_inode;
+    ioq_close(&pp->ioq, !(file->fd_flag & O_WRONLY));
+    memset(file, 0, sizeof(struct file));
+    if(pp->ioq.rd_closed && pp->ioq.wr_closed) {
+        ioq_destroy(&pp->ioq);
+        mfree_page(MPF_KERNEL, pp, 1);
+    }
+}
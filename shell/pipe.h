@@ -0,0 +1,33 @@
+#ifndef __SHELL_PIPE_H
+#define __SHELL_PIPE_H
+
+#include "stdint.h"
+#include "global.h"
+#include "file.h"
+#include "waitqueue.h"
+
+/* fd_flag 中的管道标志，低位的 O_RDONLY、O_WRONLY 区分读端与写端 */
+#define PIPE_FLAG 0x10000
+
+/* 管道缓冲区大小，2 的幂，与管道头部共用一页内核内存 */
+#define PIPE_BUF_SIZE 2048
+
+/* 文件表项 file 是否为管道的一端 */
+bool is_pipe(struct file* file);
+
+/* 创建管道，pipefd[0] 为读端，pipefd[1] 为写端，flags 可为 O_NONBLOCK，成功返回 0，失败返回 -1 */
+int32_t sys_pipe(int32_t pipefd[2], uint8_t flags);
+
+/* 从管道读出至多 count 字节，管道空时阻塞（O_NONBLOCK 返回 -1），写端全部关闭且读空后返回 0 */
+int32_t pipe_read(struct file* file, void* buf, uint32_t count);
+
+/* 向管道写入 count 字节，管道满时阻塞（O_NONBLOCK 只写入放得下的部分），读端全部关闭时返回 -1 */
+int32_t pipe_write(struct file* file, const void* buf, uint32_t count);
+
+/* 管道一端的就绪状态 POLLIN、POLLOUT、POLLHUP、POLLERR，*pwq 返回需要等待的队列 */
+uint16_t pipe_poll(struct file* file, wait_queue_t** pwq);
+
+/* 管道一端的最后一个描述符关闭，两端都关闭后释放管道 */
+void pipe_release(struct file* file);
+
+#endif /* __SHELL_PIPE_H */
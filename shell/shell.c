@@ -79,9 +79,199 @@ void print_prompt(void) {
     printf("sakura@localhost:%s$ ", __cwd_cache);
 }
 
+/* 返回值不需要的内部命令，包装成统一的形式 */
+static void mkdir_run(int argc, char** argv) {
+    mkdir_builtin(argc, argv);
+}
+
+static void rmdir_run(int argc, char** argv) {
+    rmdir_builtin(argc, argv);
+}
+
+static void rm_run(int argc, char** argv) {
+    rm_builtin(argc, argv);
+}
+
+/* cd 成功后更新当前工作目录缓存 */
+static void cd_run(int argc, char** argv) {
+    if(cd_builtin(argc, argv) != NULL) {
+        strcpy(__cwd_cache, __final_path);
+    }
+}
+
+/* 内部命令表，builtin_is 与 builtin_run 共用 */
+struct builtin_cmd {
+    const char* name;
+    void (*run)(int argc, char** argv);
+};
+
+static const struct builtin_cmd builtin_cmds[] = {
+    { "ps", ps_builtin },
+    { "lockstat", lockstat_builtin },
+    { "sysstat", sysstat_builtin },
+    { "strace", strace_builtin },
+    { "ls", ls_builtin },
+    { "pwd", pwd_builtin },
+    { "clear", clear_builtin },
+    { "mkdir", mkdir_run },
+    { "cd", cd_run },
+    { "rmdir", rmdir_run },
+    { "touch", touch_builtin },
+    { "echo", echo_builtin },
+    { "cat", cat_builtin },
+    { "rm", rm_run }
+};
+
+/* 查找内部命令，name 不是内部命令返回 NULL */
+static const struct builtin_cmd* builtin_find(const char* name) {
+    uint32_t idx;
+    for(idx = 0; idx < sizeof(builtin_cmds) / sizeof(builtin_cmds[0]); idx++) {
+        if(strcmp(builtin_cmds[idx].name, name) == 0) {
+            return &builtin_cmds[idx];
+        }
+    }
+    return NULL;
+}
+
+/* name 是否为内部命令 */
+static bool builtin_is(const char* name) {
+    return builtin_find(name) != NULL;
+}
+
+/* 执行内部命令，argv[0] 不是内部命令返回 false */
+static bool builtin_run(int argc, char** argv) {
+    const struct builtin_cmd* cmd = builtin_find(argv[0]);
+    if(cmd == NULL) {
+        return false;
+    }
+    cmd->run(argc, argv);
+    return true;
+}
+
+/* 以 spawn 创建新进程执行外部命令，不复制 shell 的地址空间，actions 为新进程的文件描述符操作，失败返回 -1 */
+static pid_t external_spawn(char** argv, const struct spawn_file_actions* actions) {
+    path2abs(argv[0], __final_path);
+    argv[0] = __final_path;
+    struct stat file_stat;
+    bzero(&file_stat, sizeof(struct stat));
+    if(-1 == stat(argv[0], &file_stat)) {
+        printf("my_shell: cannot access %s: No such file or directory\n", argv[0]);
+        return -1;
+    }
+    pid_t pid = spawn(argv[0], (const char**)argv, actions);
+    if(pid == -1) {
+        printf("my_shell: call %s failed!\n", argv[0]);
+    }
+    return pid;
+}
+
+/* 没有 exit、wait，执行完的子进程和等待外部命令的 shell 在不监视任何描述符的 poll 中永久睡眠，不占用处理器 */
+static void cmd_park(void) {
+    while(1) {
+        poll(NULL, 0, -1);
+    }
+}
+
+/* 执行一条命令，外部命令由 spawn 创建的子进程执行 */
+static void cmd_run(int argc, char** argv) {
+    if(builtin_run(argc, argv)) {
+        return;
+    }
+    pid_t pid = external_spawn(argv, NULL);
+    if(pid != -1) {
+        printf("%d\n", pid);
+        cmd_park();
+    }
+}
+
+/* 
+ * 执行管道 cmd_1 | cmd_2 | ... | cmd_n，stages 为各命令字符串
+ * 前 n-1 个命令各由一个子进程执行，标准输出重定向到通往下一个命令的管道，
+ * 最后一个命令在 shell 中执行，标准输入临时重定向到上一个管道的读端
+ */
+static void pipeline_run(char** stages, int stage_cnt) {
+    int32_t in_fd = -1; /* 上一个命令输出管道的读端 */
+    int stage_idx;
+    for(stage_idx = 0; stage_idx < stage_cnt; stage_idx++) {
+        argc = cmd_parse(stages[stage_idx], argv, ' ');
+        if(argc == -1 || argv[0] == NULL) {
+            printf("my_shell: bad command in pipeline\n");
+            break;
+        }
+        if(stage_idx == stage_cnt - 1) {
+            bool redirected = in_fd != -1;
+            if(redirected) {
+                dup2(stdin_no, FD_SAVED_STDIN);
+                dup2(in_fd, stdin_no);
+                close(in_fd);
+                in_fd = -1;
+            }
+            cmd_run(argc, argv);
+            if(redirected) {
+                /* 恢复标准输入，同时关闭管道读端，上游命令再写入会失败 */
+                dup2(FD_SAVED_STDIN, stdin_no);
+                close(FD_SAVED_STDIN);
+            }
+            break;
+        }
+
+        int32_t pipefd[2];
+        if(pipe(pipefd) == -1) {
+            printf("my_shell: create pipe failed\n");
+            break;
+        }
+        pid_t pid;
+        if(builtin_is(argv[0])) {
+            pid = fork();
+            if(pid == 0) {
+                if(in_fd != -1) {
+                    dup2(in_fd, stdin_no);
+                    close(in_fd);
+                }
+                close(pipefd[0]);
+                dup2(pipefd[1], stdout_no);
+                close(pipefd[1]);
+                builtin_run(argc, argv);
+                /* 关闭管道写端，下游命令读完数据后得到文件结束 */
+                close(stdout_no);
+                close(stdin_no);
+                cmd_park();
+            }
+        } else {
+            /* 外部命令直接 spawn，重定向在新进程加载程序前完成 */
+            struct spawn_file_actions actions;
+            spawn_actions_init(&actions);
+            if(in_fd != -1) {
+                spawn_actions_dup2(&actions, in_fd, stdin_no);
+                spawn_actions_close(&actions, in_fd);
+            }
+            spawn_actions_close(&actions, pipefd[0]);
+            spawn_actions_dup2(&actions, pipefd[1], stdout_no);
+            spawn_actions_close(&actions, pipefd[1]);
+            pid = external_spawn(argv, &actions);
+        }
+        if(pid == -1) {
+            printf("my_shell: start %s failed\n", argv[0]);
+            close(pipefd[0]);
+            close(pipefd[1]);
+            break;
+        }
+        /* shell 不保留写端，否则下游永远等不到文件结束 */
+        close(pipefd[1]);
+        if(in_fd != -1) {
+            close(in_fd);
+        }
+        in_fd = pipefd[0];
+    }
+    if(in_fd != -1) {
+        close(in_fd);
+    }
+}
+
 /* 简单的 shell */
 void shell(void) {
     __cwd_cache[0] = '/';
+    char* stages[MAX_ARG_NR]; /* 管道中的各个命令 */
     while(1) {
         print_prompt();
         memset(_cmd_line, 0, MAX_CMD_LEN);
@@ -90,57 +280,22 @@ void shell(void) {
             continue;
         }
 
+        if(strchr(_cmd_line, '|') != NULL) {
+            int stage_cnt = cmd_parse(_cmd_line, stages, '|');
+            if(stage_cnt == -1) {
+                printf("num of commands in pipeline exceed %d\n", MAX_ARG_NR);
+                continue;
+            }
+            pipeline_run(stages, stage_cnt);
+            continue;
+        }
+
         argc = cmd_parse(_cmd_line, argv, ' ');
         if(argc == -1) {
             printf("num of arguments exceed %d\n", MAX_ARG_NR);
             continue;
         }
-
-        if(strcmp("ps", argv[0]) == 0) {
-            ps_builtin(argc, argv);
-        } else if(strcmp("ls", argv[0]) == 0) {
-            ls_builtin(argc, argv);
-        } else if(strcmp("pwd", argv[0]) == 0) {
-            pwd_builtin(argc, argv);
-        } else if(strcmp("clear", argv[0]) == 0) {
-            clear_builtin(argc, argv);
-        } else if(strcmp("mkdir", argv[0]) == 0) {
-            mkdir_builtin(argc, argv);
-        } else if(strcmp("cd", argv[0]) == 0) {
-            if(cd_builtin(argc, argv) != NULL) {
-                strcpy(__cwd_cache, __final_path);
-            }
-        } else if(strcmp("rmdir", argv[0]) == 0) {
-            rmdir_builtin(argc, argv);
-        } else if(strcmp("touch", argv[0]) == 0) {
-            touch_builtin(argc, argv);
-        } else if(strcmp("echo", argv[0]) == 0) {
-            echo_builtin(argc, argv);
-        } else if(strcmp("cat", argv[0]) == 0) {
-            cat_builtin(argc, argv);
-        } else if(strcmp("rm", argv[0]) == 0) {
-            rm_builtin(argc, argv);
-        } else {
-            /* 外部命令 */
-            pid_t pid = fork();
-            if(pid) {
-                printf("%d\n", pid);
-                while(1);
-            } else {
-                path2abs(argv[0], __final_path);
-                argv[0] = __final_path;
-                struct stat file_stat;
-                bzero(&file_stat, sizeof(struct stat));
-                if(-1 == stat(argv[0], &file_stat)) {
-                    printf("my_shell: cannot access %s: No such file or directory\n", argv[0]);
-                } else {
-                    if(-1 == execv(argv[0], (const char**)argv)) {
-                        printf("my_shell: call %s failed!\n", argv[0]);
-                    }
-                }
-                while(1);
-            }
-        }
+        cmd_run(argc, argv);
     }
     PANIC("my_shell: should not be here");
 }
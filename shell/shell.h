@@ -3,6 +3,7 @@
 
 #define MAX_CMD_LEN 128 /* 最后键入 128 个字符的命令行输入 */
 #define MAX_ARG_NR  16 /* 加上命令名最后支持 16 个参数 */
+#define FD_SAVED_STDIN 7 /* 执行管道最后一个命令时保存 shell 的标准输入 */
 
 /* 输出命令提示符 */
 void print_prompt(void);
@@ -0,0 +1,119 @@
+#include "futex.h"
+#include "sync.h"
+#include "thread.h"
+#include "memory.h"
+#include "debug.h"
+#include "print.h"
+
+#define FUTEX_HASH_SIZE 64 /* 桶数，须为 2 的幂 */
+
+/* 等待队列桶：物理地址散列到同一桶的等待者共用 */
+struct futex_bucket {
+    spinlock_t spin; /* 保护 waiters，同时使 WAIT 的比较与入队对 WAKE 是原子的 */
+    struct list waiters;
+};
+
+/* 一个等待者，位于其内核栈上 */
+struct futex_waiter {
+    struct list_elem tag;
+    uint32_t key; /* uaddr 的物理地址 */
+    struct task_struct* task;
+};
+
+static struct futex_bucket futex_hash[FUTEX_HASH_SIZE];
+
+/* 用户地址 uaddr 的物理地址，未映射或不是合法用户地址返回 0 */
+static uint32_t futex_key(uint32_t* uaddr) {
+    uint32_t vaddr = (uint32_t)uaddr;
+    if(vaddr == 0 || vaddr >= 0xc0000000 || (vaddr & 0x3) != 0) {
+        return 0;
+    }
+    if(!(*pde_ptr(vaddr) & PG_P_1) || !(*pte_ptr(vaddr) & PG_P_1)) {
+        return 0;
+    }
+    return addr_v2p(vaddr);
+}
+
+static struct futex_bucket* futex_bucket_get(uint32_t key) {
+    /* 同一页内相邻的 futex 分散到不同桶 */
+    return &futex_hash[((key >> 2) ^ (key >> 12)) & (FUTEX_HASH_SIZE - 1)];
+}
+
+/* *uaddr 仍等于 val 时阻塞，直到被 futex_wake 唤醒 */
+static int32_t futex_wait(uint32_t* uaddr, uint32_t val) {
+    struct task_struct* cur_thread = thread_running();
+    enum intr_status old_stat = intr_disable();
+    /* 关中断后再查页表，期间映射不会被本任务撤销 */
+    uint32_t key = futex_key(uaddr);
+    if(key == 0) {
+        intr_status_set(old_stat);
+        return -1;
+    }
+    struct futex_bucket* bucket = futex_bucket_get(key);
+    spin_lock(&bucket->spin);
+    if(*uaddr != val) {
+        /* 值已被修改，用户态应重新尝试 */
+        spin_unlock_intr(&bucket->spin, old_stat);
+        return -1;
+    }
+    struct futex_waiter waiter = { .key = key, .task = cur_thread };
+    list_push_back(&bucket->waiters, &waiter.tag);
+    while(1) {
+        thread_block_timeout(&bucket->spin, 0);
+        spin_lock(&bucket->spin);
+        /* 被 futex_wake 移出队列才返回，虚假唤醒则继续等待 */
+        if(!elem_find(&bucket->waiters, &waiter.tag)) {
+            break;
+        }
+    }
+    spin_unlock_intr(&bucket->spin, old_stat);
+    return 0;
+}
+
+/* 唤醒在 uaddr 上等待的最多 cnt 个任务，返回唤醒数 */
+static int32_t futex_wake(uint32_t* uaddr, uint32_t cnt) {
+    enum intr_status old_stat = intr_disable();
+    uint32_t key = futex_key(uaddr);
+    if(key == 0) {
+        intr_status_set(old_stat);
+        return -1;
+    }
+    struct futex_bucket* bucket = futex_bucket_get(key);
+    spin_lock(&bucket->spin);
+    int32_t woken = 0;
+    struct list_elem* elem = bucket->waiters.head.next;
+    while(elem != &bucket->waiters.tail && (uint32_t)woken < cnt) {
+        struct futex_waiter* waiter = elem2entry(struct futex_waiter, tag, elem);
+        elem = elem->next;
+        if(waiter->key == key) {
+            list_remove(&waiter->tag);
+            thread_wakeup(waiter->task);
+            woken++;
+        }
+    }
+    spin_unlock_intr(&bucket->spin, old_stat);
+    return woken;
+}
+
+/* futex 系统调用 */
+int32_t sys_futex(uint32_t* uaddr, int op, uint32_t val) {
+    switch(op) {
+        case FUTEX_WAIT:
+            return futex_wait(uaddr, val);
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, val);
+        default:
+            return -1;
+    }
+}
+
+/* init futex hash table */
+void futex_init(void) {
+    put_str("futex_init start\n");
+    uint32_t idx;
+    for(idx = 0; idx < FUTEX_HASH_SIZE; idx++) {
+        spin_init(&futex_hash[idx].spin);
+        list_init(&futex_hash[idx].waiters);
+    }
+    put_str("futex_init done\n");
+}
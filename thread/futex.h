@@ -0,0 +1,20 @@
+#ifndef __THREAD_FUTEX_H
+#define __THREAD_FUTEX_H
+
+#include "global.h"
+
+/* futex operation */
+#define FUTEX_WAIT 0 /* *uaddr 仍等于 val 时睡眠 */
+#define FUTEX_WAKE 1 /* 唤醒最多 val 个等待者 */
+
+/*
+ * futex 系统调用，uaddr 为 4 字节对齐的用户地址，以其物理地址为键（共享页目录的线程之间同样有效）
+ * FUTEX_WAIT : *uaddr == val 时阻塞直到被唤醒，返回 0；不相等返回 -1
+ * FUTEX_WAKE : 返回唤醒的任务数
+ */
+int32_t sys_futex(uint32_t* uaddr, int op, uint32_t val);
+
+/* init futex hash table */
+void futex_init(void);
+
+#endif /* __THREAD_FUTEX_H */
@@ -0,0 +1,126 @@
+#include "lockstat.h"
+#include "sync.h"
+#include "memory.h"
+#include "stdio.h"
+#include "string.h"
+
+#define LOCKSTAT_BUF_PAGES 2 /* 格式化缓冲，放不下的锁不输出 */
+#define LOCKSTAT_LINE_MAX (16 + 6 * 10 + 1) /* 一行的长度 */
+
+static struct list lockstat_list; /* 所有登记的锁，mem_init 中即有锁登记，首次使用时初始化 */
+static spinlock_t lockstat_spin = { 0 };
+
+/* 清零并以 name 登记到全局统计队列 */
+void lockstat_register(lock_stat_t *pstat, const char *name) {
+    memset(pstat, 0, sizeof(lock_stat_t));
+    pstat->name = name;
+    if(name == NULL) {
+        return;
+    }
+    enum intr_status old_stat = spin_lock_intr(&lockstat_spin);
+    if(lockstat_list.head.next == NULL) {
+        list_init(&lockstat_list);
+    }
+    list_push_back(&lockstat_list, &pstat->tag);
+    spin_unlock_intr(&lockstat_spin, old_stat);
+}
+
+/* 锁被释放前移出全局统计队列 */
+void lockstat_unregister(lock_stat_t *pstat) {
+    if(pstat->name == NULL) {
+        return;
+    }
+    enum intr_status old_stat = spin_lock_intr(&lockstat_spin);
+    list_remove(&pstat->tag);
+    pstat->name = NULL;
+    spin_unlock_intr(&lockstat_spin, old_stat);
+}
+
+/* 获得锁后记录，调用者持有该锁，统计信息不需要另外保护 */
+void lockstat_acquired(lock_stat_t *pstat, bool contended, uint32_t wait) {
+    pstat->acquired++;
+    if(contended) {
+        pstat->contended++;
+        pstat->wait_ticks += wait;
+        if(wait > pstat->wait_max) {
+            pstat->wait_max = wait;
+        }
+    }
+}
+
+/* 释放锁时记录持有时长 */
+void lockstat_released(lock_stat_t *pstat, uint32_t hold) {
+    pstat->hold_ticks += hold;
+    if(hold > pstat->hold_max) {
+        pstat->hold_max = hold;
+    }
+}
+
+/* 将 str 左对齐写入 dst 的 width 个字符宽的栏，返回写入的字符数 */
+static uint32_t lockstat_field(char* dst, const char* str, uint32_t width) {
+    uint32_t len = strlen(str);
+    if(len >= width) {
+        len = width - 1; /* 至少保留一个空格分隔 */
+    }
+    memcpy(dst, str, len);
+    memset(dst + len, ' ', width - len);
+    return width;
+}
+
+/* 输出统计信息的一行 */
+static uint32_t lockstat_line(char* dst, lock_stat_t* pstat) {
+    uint32_t vals[6] = { pstat->acquired, pstat->contended, pstat->wait_ticks,
+                        pstat->wait_max, pstat->hold_ticks, pstat->hold_max };
+    char num[12];
+    uint32_t len = lockstat_field(dst, pstat->name, 16);
+    uint32_t idx;
+    for(idx = 0; idx < 6; idx++) {
+        sprintf(num, "%d", vals[idx]);
+        len += lockstat_field(dst + len, num, 10);
+    }
+    dst[len++] = '\n';
+    return len;
+}
+
+/* 将所有登记的锁的统计信息复制到用户缓冲区 ubuf，最多 size 字节，clear 非 0 时随后清零，返回复制的字节数，失败返回 -1 */
+int32_t sys_lockstat(char* ubuf, uint32_t size, uint32_t clear) {
+    if(ubuf == NULL) {
+        return -1;
+    }
+    char* buf = get_kernel_pages(LOCKSTAT_BUF_PAGES);
+    if(buf == NULL) {
+        return -1;
+    }
+    const char* titles[6] = { "ACQUIRED", "CONTENDED", "WAIT", "WAIT_MAX", "HOLD", "HOLD_MAX" };
+    uint32_t len = lockstat_field(buf, "NAME", 16);
+    uint32_t idx;
+    for(idx = 0; idx < 6; idx++) {
+        len += lockstat_field(buf + len, titles[idx], 10);
+    }
+    buf[len++] = '\n';
+
+    /* 持自旋锁时只格式化到内核缓冲区，复制到用户缓冲区可能缺页，在释放之后进行 */
+    enum intr_status old_stat = spin_lock_intr(&lockstat_spin);
+    if(lockstat_list.head.next != NULL) {
+        struct list_elem* elem = lockstat_list.head.next;
+        for(; elem != &lockstat_list.tail; elem = elem->next) {
+            lock_stat_t* pstat = elem2entry(lock_stat_t, tag, elem);
+            if(len + LOCKSTAT_LINE_MAX < LOCKSTAT_BUF_PAGES * PG_SIZE) {
+                len += lockstat_line(buf + len, pstat);
+            }
+            if(clear) {
+                pstat->acquired = pstat->contended = 0;
+                pstat->wait_ticks = pstat->wait_max = 0;
+                pstat->hold_ticks = pstat->hold_max = 0;
+            }
+        }
+    }
+    spin_unlock_intr(&lockstat_spin, old_stat);
+
+    if(len > size) {
+        len = size;
+    }
+    memcpy(ubuf, buf, len);
+    mfree_page(MPF_KERNEL, buf, LOCKSTAT_BUF_PAGES);
+    return len;
+}
@@ -0,0 +1,37 @@
+#ifndef __THREAD_LOCKSTAT_H
+#define __THREAD_LOCKSTAT_H
+
+#include "global.h"
+#include "list.h"
+
+/* 锁竞争统计，去掉此定义即可去除全部统计开销 */
+#define LOCKSTAT
+
+/* 一把锁的统计信息，时间以时钟中断为单位 */
+typedef struct lock_stat {
+    const char *name; /* 为 NULL 时不登记 */
+    uint32_t acquired; /* 获得次数（不含递归） */
+    uint32_t contended; /* 获取时已被占用的次数 */
+    uint32_t wait_ticks; /* 累计等待时长 */
+    uint32_t wait_max;
+    uint32_t hold_ticks; /* 累计持有时长 */
+    uint32_t hold_max;
+    struct list_elem tag; /* 加入全局统计队列 */
+}lock_stat_t;
+
+/* 清零并以 name 登记到全局统计队列 */
+void lockstat_register(lock_stat_t *pstat, const char *name);
+
+/* 锁被释放前移出全局统计队列 */
+void lockstat_unregister(lock_stat_t *pstat);
+
+/* 获得锁后记录，contended 表示曾等待，wait 为等待时长 */
+void lockstat_acquired(lock_stat_t *pstat, bool contended, uint32_t wait);
+
+/* 释放锁时记录持有时长 */
+void lockstat_released(lock_stat_t *pstat, uint32_t hold);
+
+/* 将所有登记的锁的统计信息复制到用户缓冲区 ubuf，最多 size 字节，clear 非 0 时随后清零，返回复制的字节数，失败返回 -1 */
+int32_t sys_lockstat(char* ubuf, uint32_t size, uint32_t clear);
+
+#endif /* __THREAD_LOCKSTAT_H */
@@ -1,73 +1,269 @@
 #include "sync.h"
 #include "debug.h"
 #include "interrupt.h"
+#include "timer.h"
+#include "smp.h"
+
+/* 优先级继承链最多追溯的锁数，防止死锁成环时无限循环 */
+#define PI_CHAIN_MAX 16
+
+/* 大内核锁 */
+static spinlock_t big_kernel_lock;
+/* 保护所有锁的 holder、pi_waiters 及任务的 blocked_on、held_lockers */
+static spinlock_t pi_lock = { 0 };
+/* 主线程 PCB 初始化之前（mem_init 等）不记录持有的锁 */
+static bool pi_enabled = false;
+
+extern uint32_t ticks;
+
+/* 距离 start 开始的 timeout 个时钟中断还剩多少，已到期返回 0 */
+static uint32_t timeout_left(uint32_t start, uint32_t timeout) {
+    uint32_t elapsed = ticks - start;
+    return elapsed >= timeout ? 0 : timeout - elapsed;
+}
+
+/* spinlock operation */
+/* spin_init init spinlock pointed to by plock */
+void spin_init(spinlock_t *plock) {
+    plock->locked = 0;
+}
+
+/* spin_lock busy wait until get spinlock. caller must turn off interrupt */
+void spin_lock(spinlock_t *plock) {
+    ASSERT(intr_status_get() == INTR_OFF);
+    uint32_t old = 1;
+    while(1) {
+        /* xchg 自带 lock 语义，交换回 0 说明获得了锁 */
+        asm volatile("xchgl %0, %1" : "+r" (old), "+m" (plock->locked) : : "memory");
+        if(old == 0) {
+            return;
+        }
+        /* 只读等待锁空闲，避免反复锁总线。持锁者可能正等待本处理器刷新 TLB，关中断时须主动处理 */
+        while(plock->locked) {
+            smp_tlb_poll();
+            asm volatile("pause");
+        }
+        old = 1;
+    }
+}
+
+/* spin_unlock release spinlock */
+void spin_unlock(spinlock_t *plock) {
+    ASSERT(plock->locked == 1);
+    asm volatile("movl $0, %0" : "=m" (plock->locked) : : "memory");
+}
+
+/* spin_lock_intr turn off interrupt & get spinlock, return last interrupt status */
+enum intr_status spin_lock_intr(spinlock_t *plock) {
+    enum intr_status old_stat = intr_disable();
+    spin_lock(plock);
+    return old_stat;
+}
+
+/* spin_unlock_intr release spinlock & restore interrupt status */
+void spin_unlock_intr(spinlock_t *plock, enum intr_status old_stat) {
+    spin_unlock(plock);
+    intr_status_set(old_stat);
+}
 
 /* semaphore operation */
 /* sem_wait init semaphore pointed to by psem to val  */
 void sem_init(sem_t *psem, uint8_t val) {
+    spin_init(&psem->spin);
     psem->value = val;
     list_init(&psem->waiters);
 }
 
-/* sem_wait decrements the semaphore pointed to by psem */
-void sem_wait(sem_t *psem) {
-    enum intr_status old_stat = intr_disable();
+/* 等待信号量，timeout 为 0 表示不限时，超时返回 false */
+static bool sem_down(sem_t *psem, uint32_t timeout) {
+    struct task_struct* cur_thread = thread_running();
+    uint32_t start = ticks;
+    enum intr_status old_stat = spin_lock_intr(&psem->spin);
 
     while(psem->value == 0) { /* 信号量不足，阻塞 */
-        ASSERT(!elem_find(&psem->waiters, &thread_running()->general_tag));
-        if(elem_find(&psem->waiters, &thread_running()->general_tag)) {
+        uint32_t left = 0;
+        if(timeout != 0 && (left = timeout_left(start, timeout)) == 0) {
+            spin_unlock_intr(&psem->spin, old_stat);
+            return false;
+        }
+        ASSERT(!elem_find(&psem->waiters, &cur_thread->general_tag));
+        if(elem_find(&psem->waiters, &cur_thread->general_tag)) {
            PANIC("sem_wait : thread blocked has been in waiters list\n");
         }
-        list_push_back(&psem->waiters, &thread_running()->general_tag);
-        thread_block(TASK_BLOCKED);
+        list_push_back(&psem->waiters, &cur_thread->general_tag);
+        /* 释放自旋锁与阻塞是原子的，sem_post 不会错过唤醒 */
+        thread_block_timeout(&psem->spin, left);
+        spin_lock(&psem->spin);
+        /* 超时或虚假唤醒时仍在等待队列中 */
+        if(elem_find(&psem->waiters, &cur_thread->general_tag)) {
+            list_remove(&cur_thread->general_tag);
+        }
     }
     psem->value--;
-    
-    intr_status_set(old_stat);
+
+    spin_unlock_intr(&psem->spin, old_stat);
+    return true;
 }
 
-/* sem_post increments the semaphore pointed to by psem. 
-    If the semaphore's value consequently becomes greater than zero, 
+/* sem_wait decrements the semaphore pointed to by psem */
+void sem_wait(sem_t *psem) {
+    sem_down(psem, 0);
+}
+
+/* sem_timedwait like sem_wait, but give up after m_seconds. return false if timeout */
+bool sem_timedwait(sem_t *psem, uint32_t m_seconds) {
+    return sem_down(psem, mtime_to_ticks(m_seconds));
+}
+
+/* sem_post increments the semaphore pointed to by psem.
+    If the semaphore's value consequently becomes greater than zero,
     then another process or thread blocked in a sem_wait call will
     be woken up and proceed to lock the semaphore. */
 void sem_post(sem_t *psem) {
-    enum intr_status old_stat = intr_disable();
-    
-    if(!list_empty(&psem->waiters)) {
+    enum intr_status old_stat = spin_lock_intr(&psem->spin);
 
-        struct task_struct* thread_blocked = 
-            elem2entry(struct task_struct, general_tag, list_pop(&psem->waiters));
-        thread_unblock(thread_blocked);    
+    if(!list_empty(&psem->waiters)) {
+        /* 唤醒优先级最高的等待者 */
+        struct list_elem* elem = psem->waiters.head.next;
+        struct task_struct* thread_blocked = elem2entry(struct task_struct, general_tag, elem);
+        for(elem = elem->next; elem != &psem->waiters.tail; elem = elem->next) {
+            struct task_struct* pthread = elem2entry(struct task_struct, general_tag, elem);
+            if(pthread->priority > thread_blocked->priority) {
+                thread_blocked = pthread;
+            }
+        }
+        list_remove(&thread_blocked->general_tag);
+        /* 等待者同时超时则唤醒失败，它醒来后会重新检查 value */
+        thread_wakeup(thread_blocked);
     }
     psem->value++;
     ASSERT(psem->value > 0);
 
-    intr_status_set(old_stat);
+    spin_unlock_intr(&psem->spin, old_stat);
 }
 
 
+/* priority inheritance */
+/* 沿 plocker 的持有者及其等待的锁向下，将整条链上的持有者提升到不低于 prio。调用者持有 pi_lock */
+static void pi_boost_chain(locker_t *plocker, uint8_t prio) {
+    int depth = 0;
+    while(plocker != NULL && plocker->holder != NULL && depth++ < PI_CHAIN_MAX) {
+        struct task_struct* holder = plocker->holder;
+        if(holder->priority >= prio) {
+            break; /* 后续的持有者已被提升过 */
+        }
+        thread_priority_set(holder, prio);
+        plocker = holder->blocked_on;
+    }
+}
+
+/* 按自身优先级及仍持有的锁上的等待者重新计算 pthread 的优先级。调用者持有 pi_lock */
+static void pi_restore(struct task_struct* pthread) {
+    uint8_t prio = pthread->base_priority;
+    struct list_elem* lelem = pthread->held_lockers.head.next;
+    for(; lelem != &pthread->held_lockers.tail; lelem = lelem->next) {
+        locker_t* plocker = elem2entry(locker_t, holder_tag, lelem);
+        struct list_elem* welem = plocker->pi_waiters.head.next;
+        for(; welem != &plocker->pi_waiters.tail; welem = welem->next) {
+            struct task_struct* waiter = elem2entry(struct task_struct, pi_tag, welem);
+            if(waiter->priority > prio) {
+                prio = waiter->priority;
+            }
+        }
+    }
+    if(prio != pthread->priority) {
+        thread_priority_set(pthread, prio);
+    }
+}
+
+/* 主线程 PCB 初始化完成后开启优先级继承 */
+void locker_pi_enable(void) {
+    pi_enabled = true;
+}
+
 /* locker operation */
-/* locker_init init locker pointed to by plocker */
-void locker_init(locker_t *plocker) {
+/* locker_init init locker pointed to by plocker, name 用于竞争统计，为 NULL 不统计 */
+void locker_init(locker_t *plocker, const char *name UNUSED) {
     plocker->holder = NULL;
     plocker->holder_repeat_nr = 0;
     sem_init(&plocker->sem, 1);
+    list_init(&plocker->pi_waiters);
+    plocker->holder_tag.prev = plocker->holder_tag.next = NULL;
+#ifdef LOCKSTAT
+    lockstat_register(&plocker->stat, name);
+    plocker->acquire_tick = 0;
+#endif
 }
 
-/* locker_lock get locker pointed to by plocker. If locker already is holded by others, then blocked. */
-void locker_lock(locker_t *plocker) {
+/* locker_destroy unregister statistics of locker before its memory freed */
+void locker_destroy(locker_t *plocker UNUSED) {
+#ifdef LOCKSTAT
+    lockstat_unregister(&plocker->stat);
+#endif
+}
+
+/* 获取锁，timeout 为 0 表示不限时，超时返回 false */
+static bool locker_down(locker_t *plocker, uint32_t timeout) {
+    struct task_struct* cur_thread = thread_running();
     /* avoid repeat apply locker */
-    if(plocker->holder != thread_running()) {
-        sem_wait(&plocker->sem); /* P */
+    if(plocker->holder != cur_thread) {
+        /* 锁被占用时登记为等待者，并把优先级传递给持有者 */
+        enum intr_status old_stat = spin_lock_intr(&pi_lock);
+        if(pi_enabled && plocker->holder != NULL) {
+            cur_thread->blocked_on = plocker;
+            list_push_back(&plocker->pi_waiters, &cur_thread->pi_tag);
+            pi_boost_chain(plocker, cur_thread->priority);
+        }
+        spin_unlock_intr(&pi_lock, old_stat);
+
+#ifdef LOCKSTAT
+        bool contended = plocker->holder != NULL;
+        uint32_t wait_start = ticks;
+#endif
+        bool acquired = sem_down(&plocker->sem, timeout); /* P */
+
+        old_stat = spin_lock_intr(&pi_lock);
+        if(cur_thread->blocked_on != NULL) {
+            cur_thread->blocked_on = NULL;
+            list_remove(&cur_thread->pi_tag);
+            /* 超时放弃：撤销给予持有者的提升（链上更远的持有者在其释放锁时恢复） */
+            if(!acquired && plocker->holder != NULL) {
+                pi_restore(plocker->holder);
+            }
+        }
+        if(!acquired) {
+            spin_unlock_intr(&pi_lock, old_stat);
+            return false;
+        }
         ASSERT(plocker->sem.value == 0);
+        plocker->holder = cur_thread;
+        if(pi_enabled) {
+            list_push_back(&cur_thread->held_lockers, &plocker->holder_tag);
+            /* 其余等待者的优先级转移给新的持有者 */
+            pi_restore(cur_thread);
+        }
+        spin_unlock_intr(&pi_lock, old_stat);
 
-        plocker->holder = thread_running();
-    
         ASSERT(plocker->holder_repeat_nr == 0);
         plocker->holder_repeat_nr = 1;
+#ifdef LOCKSTAT
+        plocker->acquire_tick = ticks;
+        lockstat_acquired(&plocker->stat, contended, plocker->acquire_tick - wait_start);
+#endif
     } else {
         plocker->holder_repeat_nr++;
     }
+    return true;
+}
+
+/* locker_lock get locker pointed to by plocker. If locker already is holded by others, then blocked. */
+void locker_lock(locker_t *plocker) {
+    locker_down(plocker, 0);
+}
+
+/* locker_timedlock like locker_lock, but give up after m_seconds. return false if timeout */
+bool locker_timedlock(locker_t *plocker, uint32_t m_seconds) {
+    return locker_down(plocker, mtime_to_ticks(m_seconds));
 }
 
 /* locker_lock release locker pointed to by plocker. */
@@ -78,8 +274,239 @@ void locker_unlock(locker_t *plocker) {
         return;
     }
     ASSERT(plocker->holder_repeat_nr == 1);
+#ifdef LOCKSTAT
+    lockstat_released(&plocker->stat, ticks - plocker->acquire_tick);
+#endif
 
+    enum intr_status old_stat = spin_lock_intr(&pi_lock);
     plocker->holder = NULL;
     plocker->holder_repeat_nr = 0;
+    if(plocker->holder_tag.next != NULL) {
+        list_remove(&plocker->holder_tag);
+        plocker->holder_tag.prev = plocker->holder_tag.next = NULL;
+        /* 撤销因本锁的等待者而获得的提升 */
+        pi_restore(thread_running());
+    }
+    spin_unlock_intr(&pi_lock, old_stat);
+
     sem_post(&plocker->sem); /* V */
-}
\ No newline at end of file
+}
+
+/* rwlock operation */
+/* rwlock_init init rwlock pointed to by prw, fair or writer-preferring */
+void rwlock_init(rwlock_t *prw, bool fair) {
+    spin_init(&prw->spin);
+    prw->readers = 0;
+    prw->writer = NULL;
+    list_init(&prw->read_waiters);
+    list_init(&prw->write_waiters);
+    prw->fair = fair;
+}
+
+/*
+ * 锁状态变化后按策略把锁直接交给等待者（从等待队列移除即表示已获得），调用者持有 prw->spin
+ * writer_released 为 true 表示刚由写者释放，公平模式此时先放行读者
+ */
+static void rwlock_grant(rwlock_t *prw, bool writer_released) {
+    if(prw->writer != NULL) {
+        return;
+    }
+    bool readers_first = prw->fair && writer_released;
+    if(!list_empty(&prw->read_waiters) && (list_empty(&prw->write_waiters) || readers_first)) {
+        while(!list_empty(&prw->read_waiters)) {
+            struct task_struct* reader = elem2entry(struct task_struct, general_tag, list_pop(&prw->read_waiters));
+            prw->readers++;
+            thread_wakeup(reader);
+        }
+        return;
+    }
+    if(prw->readers == 0 && !list_empty(&prw->write_waiters)) {
+        struct task_struct* writer = elem2entry(struct task_struct, general_tag, list_pop(&prw->write_waiters));
+        prw->writer = writer;
+        thread_wakeup(writer);
+    }
+}
+
+/* 在 waiters 上等待 rwlock_grant 交出锁，timeout 为 0 表示不限时，超时返回 false。调用者持有 prw->spin */
+static bool rwlock_wait(rwlock_t *prw, struct list *waiters, uint32_t timeout) {
+    struct task_struct* cur_thread = thread_running();
+    uint32_t start = ticks;
+    list_push_back(waiters, &cur_thread->general_tag);
+    while(1) {
+        uint32_t left = 0;
+        if(timeout != 0 && (left = timeout_left(start, timeout)) == 0) {
+            list_remove(&cur_thread->general_tag);
+            /* 放弃等待的写者可能正挡着后面的读者 */
+            rwlock_grant(prw, false);
+            return false;
+        }
+        thread_block_timeout(&prw->spin, left);
+        spin_lock(&prw->spin);
+        if(!elem_find(waiters, &cur_thread->general_tag)) {
+            return true; /* 已被交予锁 */
+        }
+    }
+}
+
+/* 获取读锁，timeout 为 0 表示不限时 */
+static bool rwlock_read_down(rwlock_t *prw, uint32_t timeout) {
+    enum intr_status old_stat = spin_lock_intr(&prw->spin);
+    bool acquired = true;
+    if(prw->writer == NULL && list_empty(&prw->write_waiters)) {
+        prw->readers++;
+    } else {
+        acquired = rwlock_wait(prw, &prw->read_waiters, timeout);
+    }
+    spin_unlock_intr(&prw->spin, old_stat);
+    return acquired;
+}
+
+/* 获取写锁，timeout 为 0 表示不限时 */
+static bool rwlock_write_down(rwlock_t *prw, uint32_t timeout) {
+    enum intr_status old_stat = spin_lock_intr(&prw->spin);
+    ASSERT(prw->writer != thread_running());
+    bool acquired = true;
+    if(prw->writer == NULL && prw->readers == 0 && list_empty(&prw->write_waiters)) {
+        prw->writer = thread_running();
+    } else {
+        acquired = rwlock_wait(prw, &prw->write_waiters, timeout);
+    }
+    spin_unlock_intr(&prw->spin, old_stat);
+    return acquired;
+}
+
+/* rwlock_read_lock get read lock, blocked while writer holds or waits */
+void rwlock_read_lock(rwlock_t *prw) {
+    rwlock_read_down(prw, 0);
+}
+
+/* rwlock_read_timedlock like rwlock_read_lock, but give up after m_seconds. return false if timeout */
+bool rwlock_read_timedlock(rwlock_t *prw, uint32_t m_seconds) {
+    return rwlock_read_down(prw, mtime_to_ticks(m_seconds));
+}
+
+/* rwlock_read_unlock release read lock */
+void rwlock_read_unlock(rwlock_t *prw) {
+    enum intr_status old_stat = spin_lock_intr(&prw->spin);
+    ASSERT(prw->readers > 0);
+    if(--prw->readers == 0) {
+        rwlock_grant(prw, false);
+    }
+    spin_unlock_intr(&prw->spin, old_stat);
+}
+
+/* rwlock_write_lock get write lock exclusively */
+void rwlock_write_lock(rwlock_t *prw) {
+    rwlock_write_down(prw, 0);
+}
+
+/* rwlock_write_timedlock like rwlock_write_lock, but give up after m_seconds. return false if timeout */
+bool rwlock_write_timedlock(rwlock_t *prw, uint32_t m_seconds) {
+    return rwlock_write_down(prw, mtime_to_ticks(m_seconds));
+}
+
+/* rwlock_write_unlock release write lock */
+void rwlock_write_unlock(rwlock_t *prw) {
+    enum intr_status old_stat = spin_lock_intr(&prw->spin);
+    ASSERT(prw->writer == thread_running());
+    prw->writer = NULL;
+    rwlock_grant(prw, true);
+    spin_unlock_intr(&prw->spin, old_stat);
+}
+
+/* condition variable operation */
+/* cond_init init condition variable pointed to by pcond */
+void cond_init(cond_t *pcond) {
+    spin_init(&pcond->spin);
+    list_init(&pcond->waiters);
+}
+
+/* 释放锁并等待通知，timeout 为 0 表示不限时，被通知返回 true */
+static bool cond_down(cond_t *pcond, locker_t *plocker, uint32_t timeout) {
+    struct task_struct* cur_thread = thread_running();
+    /* 递归持有的锁无法在等待期间完全释放 */
+    ASSERT(plocker->holder == cur_thread && plocker->holder_repeat_nr == 1);
+
+    enum intr_status old_stat = spin_lock_intr(&pcond->spin);
+    list_push_back(&pcond->waiters, &cur_thread->general_tag);
+    /* 先入队再释放锁，之后的 signal 不会被错过 */
+    locker_unlock(plocker);
+    thread_block_timeout(&pcond->spin, timeout);
+    spin_lock(&pcond->spin);
+    bool signaled = !elem_find(&pcond->waiters, &cur_thread->general_tag);
+    if(!signaled) {
+        list_remove(&cur_thread->general_tag);
+    }
+    spin_unlock_intr(&pcond->spin, old_stat);
+
+    locker_lock(plocker);
+    return signaled;
+}
+
+/* cond_wait release plocker & wait for signal atomically, get plocker again before return */
+void cond_wait(cond_t *pcond, locker_t *plocker) {
+    cond_down(pcond, plocker, 0);
+}
+
+/* cond_timedwait like cond_wait, but give up after m_seconds. return false if not signaled */
+bool cond_timedwait(cond_t *pcond, locker_t *plocker, uint32_t m_seconds) {
+    return cond_down(pcond, plocker, mtime_to_ticks(m_seconds));
+}
+
+/* cond_signal wake up one waiter */
+void cond_signal(cond_t *pcond) {
+    enum intr_status old_stat = spin_lock_intr(&pcond->spin);
+    if(!list_empty(&pcond->waiters)) {
+        struct task_struct* waiter = elem2entry(struct task_struct, general_tag, list_pop(&pcond->waiters));
+        thread_wakeup(waiter);
+    }
+    spin_unlock_intr(&pcond->spin, old_stat);
+}
+
+/* cond_broadcast wake up all waiters */
+void cond_broadcast(cond_t *pcond) {
+    enum intr_status old_stat = spin_lock_intr(&pcond->spin);
+    while(!list_empty(&pcond->waiters)) {
+        struct task_struct* waiter = elem2entry(struct task_struct, general_tag, list_pop(&pcond->waiters));
+        thread_wakeup(waiter);
+    }
+    spin_unlock_intr(&pcond->spin, old_stat);
+}
+
+/* big kernel lock operation */
+/* kernel_lock get big kernel lock, nesting is allowed */
+void kernel_lock(void) {
+    enum intr_status old_stat = intr_disable();
+    struct task_struct* cur_thread = thread_running();
+    if(cur_thread->lock_depth++ == 0) {
+        spin_lock(&big_kernel_lock);
+    }
+    intr_status_set(old_stat);
+}
+
+/* kernel_unlock release big kernel lock */
+void kernel_unlock(void) {
+    enum intr_status old_stat = intr_disable();
+    struct task_struct* cur_thread = thread_running();
+    ASSERT(cur_thread->lock_depth > 0);
+    if(--cur_thread->lock_depth == 0) {
+        spin_unlock(&big_kernel_lock);
+    }
+    intr_status_set(old_stat);
+}
+
+/* kernel_lock_drop release big kernel lock held by current task before switch out */
+void kernel_lock_drop(void) {
+    ASSERT(intr_status_get() == INTR_OFF);
+    if(thread_running()->lock_depth > 0) {
+        spin_unlock(&big_kernel_lock);
+    }
+}
+
+/* kernel_lock_regain get big kernel lock again after current task switch in */
+void kernel_lock_regain(void) {
+    ASSERT(intr_status_get() == INTR_OFF);
+    if(thread_running()->lock_depth > 0) {
+        spin_lock(&big_kernel_lock);
+    }
+}
@@ -4,11 +4,33 @@
 #include "list.h"
 #include "stdint.h"
 #include "thread.h"
+#include "interrupt.h"
+#include "lockstat.h"
+
+/******************** spinlock ******************
+ ************************************************/
+/* spinlock struct : 多处理器间的忙等锁，持有期间不可睡眠 */
+typedef struct spinlock {
+    volatile uint32_t locked; /* 1 被持有 0 空闲 */
+}spinlock_t;
+
+/* spinlock operation */
+/* spin_init init spinlock pointed to by plock */
+void spin_init(spinlock_t *plock);
+/* spin_lock busy wait until get spinlock. caller must turn off interrupt */
+void spin_lock(spinlock_t *plock);
+/* spin_unlock release spinlock */
+void spin_unlock(spinlock_t *plock);
+/* spin_lock_intr turn off interrupt & get spinlock, return last interrupt status */
+enum intr_status spin_lock_intr(spinlock_t *plock);
+/* spin_unlock_intr release spinlock & restore interrupt status */
+void spin_unlock_intr(spinlock_t *plock, enum intr_status old_stat);
 
 /******************* semaphore ******************
  ************************************************/
 /* semaphore struct */
 typedef struct {
+    spinlock_t spin; /* 保护 value 和 waiters */
     struct list waiters;
     uint8_t value;
 }sem_t;
@@ -18,27 +40,108 @@ typedef struct {
 void sem_init(sem_t *psem, uint8_t val);
 /* sem_wait decrements the semaphore pointed to by psem */
 void sem_wait(sem_t *psem);
+/* sem_timedwait like sem_wait, but give up after m_seconds. return false if timeout */
+bool sem_timedwait(sem_t *psem, uint32_t m_seconds);
 /* sem_post increments the semaphore pointed to by psem. 
     If the semaphore's value consequently becomes greater than zero, 
     then another process or thread blocked in a sem_wait call will
-    be woken up and proceed to lock the semaphore. */
+    be woken up and proceed to lock the semaphore.
+    优先级最高的等待者先被唤醒，相同优先级按 FIFO */
 void sem_post(sem_t *psem);
 
 /********************* locker *******************
  ************************************************/
 /* locker struct */
-typedef struct {
+typedef struct locker {
     struct task_struct *holder; /* locker holder */
     uint32_t holder_repeat_nr; /* holder repeat apply count */
     sem_t sem; /* binary semaphore */
+    /* 优先级继承 */
+    struct list pi_waiters; /* 等待本锁的任务，持有者的优先级不低于其中最高者 */
+    struct list_elem holder_tag; /* 加入持有者的 held_lockers */
+#ifdef LOCKSTAT
+    lock_stat_t stat; /* 竞争统计 */
+    uint32_t acquire_tick; /* 本次获得锁时的 ticks */
+#endif
 }locker_t;
 
 /* locker operation */
-/* locker_init init locker pointed to by plocker */
-void locker_init(locker_t *plocker);
+/* locker_init init locker pointed to by plocker, name 用于竞争统计，为 NULL 不统计 */
+void locker_init(locker_t *plocker, const char *name);
+/* locker_destroy unregister statistics of locker before its memory freed */
+void locker_destroy(locker_t *plocker);
 /* locker_lock get locker pointed to by plocker. If locker already is holded by others, then blocked. */
 void locker_lock(locker_t *plocker);
+/* locker_timedlock like locker_lock, but give up after m_seconds. return false if timeout */
+bool locker_timedlock(locker_t *plocker, uint32_t m_seconds);
 /* locker_lock release locker pointed to by plocker. */
 void locker_unlock(locker_t *plocker);
+/* 主线程 PCB 初始化完成后开启优先级继承 */
+void locker_pi_enable(void);
+
+/******************* rwlock *********************
+ * 读者之间可并发，写者独占；已有写者等待时新来的读者也须等待
+ * 写者优先：写者释放时先交给下一个写者，读者可能饥饿
+ * 公平：写者释放时先放行所有等待的读者，读写交替进行
+ ************************************************/
+/* rwlock struct */
+typedef struct {
+    spinlock_t spin; /* 保护以下所有字段 */
+    uint32_t readers; /* 持有读锁的任务数 */
+    struct task_struct *writer; /* 持有写锁的任务 */
+    struct list read_waiters;
+    struct list write_waiters;
+    bool fair; /* true 公平，false 写者优先 */
+}rwlock_t;
+
+/* rwlock operation */
+/* rwlock_init init rwlock pointed to by prw, fair or writer-preferring */
+void rwlock_init(rwlock_t *prw, bool fair);
+/* rwlock_read_lock get read lock, blocked while writer holds or waits */
+void rwlock_read_lock(rwlock_t *prw);
+/* rwlock_read_timedlock like rwlock_read_lock, but give up after m_seconds. return false if timeout */
+bool rwlock_read_timedlock(rwlock_t *prw, uint32_t m_seconds);
+/* rwlock_read_unlock release read lock */
+void rwlock_read_unlock(rwlock_t *prw);
+/* rwlock_write_lock get write lock exclusively */
+void rwlock_write_lock(rwlock_t *prw);
+/* rwlock_write_timedlock like rwlock_write_lock, but give up after m_seconds. return false if timeout */
+bool rwlock_write_timedlock(rwlock_t *prw, uint32_t m_seconds);
+/* rwlock_write_unlock release write lock */
+void rwlock_write_unlock(rwlock_t *prw);
+
+/************** condition variable ***************
+ ************************************************/
+/* condition variable struct */
+typedef struct {
+    spinlock_t spin; /* 保护 waiters */
+    struct list waiters;
+}cond_t;
+
+/* condition variable operation */
+/* cond_init init condition variable pointed to by pcond */
+void cond_init(cond_t *pcond);
+/* cond_wait release plocker & wait for signal atomically, get plocker again before return.
+    可能被虚假唤醒，调用者须在循环中检查条件 */
+void cond_wait(cond_t *pcond, locker_t *plocker);
+/* cond_timedwait like cond_wait, but give up after m_seconds. return false if not signaled */
+bool cond_timedwait(cond_t *pcond, locker_t *plocker, uint32_t m_seconds);
+/* cond_signal wake up one waiter */
+void cond_signal(cond_t *pcond);
+/* cond_broadcast wake up all waiters */
+void cond_broadcast(cond_t *pcond);
+
+/***************** big kernel lock ***************
+ * 单处理器上系统调用运行于关中断环境，天然互斥；
+ * 多处理器上以大内核锁保持这一语义，任务睡眠时由调度器释放，被换回时重新获取
+ ************************************************/
+/* kernel_lock get big kernel lock, nesting is allowed */
+void kernel_lock(void);
+/* kernel_unlock release big kernel lock */
+void kernel_unlock(void);
+/* kernel_lock_drop release big kernel lock held by current task before switch out */
+void kernel_lock_drop(void);
+/* kernel_lock_regain get big kernel lock again after current task switch in */
+void kernel_lock_regain(void);
 
 #endif /* __THREAD_SYNC_H */
\ No newline at end of file
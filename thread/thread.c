@@ -8,13 +8,23 @@
 #include "file.h"
 #include "stdio.h"
 #include "fs.h"
+#include "smp.h"
+#include "fpu.h"
+
+/* 每个处理器每隔多少个时钟中断做一次负载均衡 */
+#define SCHED_BALANCE_TICKS 20
+/* 每个时钟中断最多唤醒的到期任务数，其余留到下一个时钟中断 */
+#define SLEEP_WAKE_BATCH 16
 
 struct task_struct* main_thread; /* main thread PCB */
-struct task_struct* idle_thread; /* idle thread PCB */
-struct list __thread_ready_list; /* ready tasks queue */
+struct task_struct* idle_thread; /* idle thread PCB of BSP */
 struct list __thread_all_list; /* all tasks queue */
-static struct list_elem* thread_tag; /* thread node of queue */
+static spinlock_t all_list_lock; /* all tasks queue locker */
 locker_t pid_locker; /* pid locker */
+static struct list sleep_list; /* 限时阻塞的任务，按 wake_tick 升序 */
+static spinlock_t sleep_lock; /* sleep list locker */
+
+extern uint32_t ticks;
 
 extern void switch_to(struct task_struct* cur, struct task_struct* next);
 extern void init(void);
@@ -79,6 +89,10 @@ void thread_attr_init(struct task_struct* pthread, char* name, int priority) {
     /* 栈从本页的最高地址 + 1 开始向下生长 */
     pthread->self_kstack = (uint32_t*)((uint32_t)pthread + PG_SIZE);
     pthread->priority = priority;
+    pthread->base_priority = priority;
+    pthread->group_leader = pthread;
+    pthread->nr_threads = 1;
+    list_init(&pthread->held_lockers);
     pthread->ticks = priority;
     pthread->elapsed_ticks = 0;
     
@@ -96,6 +110,55 @@ void thread_attr_init(struct task_struct* pthread, char* name, int priority) {
     pthread->stack_magic = 0x19990926; /* 定义的魔数，如果该值被覆盖，说明溢出 */
 }
 
+/* 将 pthread 加入 pcpu 的就绪队列，调用者须持有 pcpu->rq_lock */
+static void rq_push(struct cpu* pcpu, struct task_struct* pthread, bool front) {
+    ASSERT(!elem_find(&pcpu->ready_list, &pthread->general_tag));
+    if(elem_find(&pcpu->ready_list, &pthread->general_tag)) {
+        PANIC("rq_push: thread has been in ready_list\n");
+    }
+    if(front) {
+        list_push_front(&pcpu->ready_list, &pthread->general_tag);
+    } else {
+        list_push_back(&pcpu->ready_list, &pthread->general_tag);
+    }
+    pthread->cpu = pcpu;
+    pthread->status = TASK_READY;
+    pcpu->nr_ready++;
+}
+
+/* 就绪任务最少的已上线处理器 */
+static struct cpu* cpu_least_loaded(void) {
+    struct cpu* pcpu = &cpus[0];
+    uint8_t cpu_idx;
+    for(cpu_idx = 1; cpu_idx < cpu_cnt; cpu_idx++) {
+        if(cpus[cpu_idx].nr_ready < pcpu->nr_ready) {
+            pcpu = &cpus[cpu_idx];
+        }
+    }
+    return pcpu;
+}
+
+/* 将 pthread 加入全部任务队列 */
+static void all_list_push(struct task_struct* pthread) {
+    enum intr_status old_stat = spin_lock_intr(&all_list_lock);
+    ASSERT(!(elem_find(&__thread_all_list, &pthread->all_list_tag)));
+    list_push_back(&__thread_all_list, &pthread->all_list_tag);
+    spin_unlock_intr(&all_list_lock, old_stat);
+}
+
+/* 将新建的任务加入负载最轻的处理器就绪队列及全部任务队列 */
+void thread_ready_new(struct task_struct* pthread) {
+    enum intr_status old_stat = intr_disable();
+    struct cpu* pcpu = cpu_least_loaded();
+    spin_lock(&pcpu->rq_lock);
+    rq_push(pcpu, pthread, false);
+    spin_unlock(&pcpu->rq_lock);
+    intr_status_set(old_stat);
+
+    all_list_push(pthread);
+    smp_send_resched(pcpu);
+}
+
 /* 创建优先级为 prio 名为 name 的线程，执行函数为 func(func_arg) */
 struct task_struct* thread_start(char* name, int priority, thread_func* func, void* func_arg) {
     /* pcb 都位于内核空间，包括用户进程的 pcb 也是在内核空间 */
@@ -104,43 +167,193 @@ struct task_struct* thread_start(char* name, int priority, thread_func* func, vo
     thread_attr_init(thread, name, priority);
     thread_create(thread, func, func_arg);
 
-    /* ASSERT 保证元素不被重复添加进队列 */
-    ASSERT(!(elem_find(&__thread_ready_list, &thread->general_tag)));
-    list_push_back(&__thread_ready_list, &thread->general_tag);
-
-    ASSERT(!(elem_find(&__thread_all_list, &thread->all_list_tag)));
-    list_push_back(&__thread_all_list, &thread->all_list_tag);
+    thread_ready_new(thread);
 
     return thread;
 }
 
+/* 
+ * 切换到 pcpu 上的下一个任务
+ * 调用者已关中断并持有当前处理器的 rq_lock，该锁由换上处理器的任务在 schedule_tail 中释放
+ */
+static void sched_switch(struct task_struct* cur_tcb) {
+    struct cpu* pcpu = cur_tcb->cpu;
+    if(cur_tcb->status == TASK_RUNNING) {
+        /* 时间片到，加入就绪队列尾部；idle 不进入就绪队列，只在队列为空时运行 */
+        if(cur_tcb != pcpu->idle) {
+            rq_push(pcpu, cur_tcb, false);
+        } else {
+            cur_tcb->status = TASK_READY;
+        }
+        cur_tcb->ticks = cur_tcb->priority; /* 重置时间片为 priority */
+    } else {
+        /* 不是时间片到下 CPU，不加入就绪队列，此时没有进行任何操作 */
+    }
+
+    /* 没有可运行的任务，则执行 idle */
+    struct task_struct* next_tcb = pcpu->idle;
+    if(!list_empty(&pcpu->ready_list)) {
+        /* 从就绪队列获取一个 tcb，但因为其中存的是 list_elem 需要转化为 tcb 的地址 */
+        next_tcb = elem2entry(struct task_struct, general_tag, list_pop(&pcpu->ready_list));
+        pcpu->nr_ready--;
+    }
+    next_tcb->status = TASK_RUNNING;
+
+    if(next_tcb == cur_tcb) {
+        spin_unlock(&pcpu->rq_lock);
+        return;
+    }
+    /* 当前任务若持有大内核锁，换下处理器期间释放 */
+    kernel_lock_drop();
+    /* 保存本时间片内使用过的 FPU 状态，并置 TS 使下一个任务首次使用 FPU 时再恢复 */
+    fpu_switch_out(cur_tcb);
+
+    /* activate task page table ... */
+    process_activate(next_tcb);
+
+    switch_to(cur_tcb, next_tcb);
+}
+
+/* switch_to 切换完成后由新任务调用，释放调度锁 */
+void schedule_tail(void) {
+    spin_unlock(&thread_running()->cpu->rq_lock);
+    kernel_lock_regain();
+}
+
 /* thread block */
 void thread_block(enum task_status stat) {
-    ASSERT((TASK_BLOCKED == stat) || (TASK_WAITING == stat) || (TASK_HANGING == stat));
+    ASSERT((TASK_BLOCKED == stat) || (TASK_WAITING == stat) || (TASK_HANGING == stat) || (TASK_DIED == stat));
     enum intr_status old_stat = intr_disable();
 
     struct task_struct* cur_tcb = thread_running();
+    spin_lock(&cur_tcb->cpu->rq_lock);
     cur_tcb->status = stat;
-    schedule();
+    sched_switch(cur_tcb);
 
     intr_status_set(old_stat);
 }
 
+/* 释放自旋锁 plock 并阻塞当前线程，二者是原子的，调用前须关中断并持有 plock */
+void thread_block_release(enum task_status stat, struct spinlock* plock) {
+    ASSERT((TASK_BLOCKED == stat) || (TASK_WAITING == stat) || (TASK_HANGING == stat));
+    ASSERT(intr_status_get() == INTR_OFF);
+
+    struct task_struct* cur_tcb = thread_running();
+    /* 先持有调度锁再释放 plock，唤醒者拿到调度锁时本线程已经换下处理器 */
+    spin_lock(&cur_tcb->cpu->rq_lock);
+    cur_tcb->status = stat;
+    spin_unlock(plock);
+    sched_switch(cur_tcb);
+}
+
+/* 将当前任务按唤醒时间插入 sleep_list */
+static void sleep_list_insert(struct task_struct* cur_tcb) {
+    spin_lock(&sleep_lock);
+    struct list_elem* elem = sleep_list.head.next;
+    for(; elem != &sleep_list.tail; elem = elem->next) {
+        struct task_struct* pthread = elem2entry(struct task_struct, sleep_tag, elem);
+        if((int32_t)(pthread->wake_tick - cur_tcb->wake_tick) > 0) {
+            break;
+        }
+    }
+    list_insert_before(elem, &cur_tcb->sleep_tag);
+    cur_tcb->sleep_queued = true;
+    spin_unlock(&sleep_lock);
+}
+
+/*
+ * 释放自旋锁 plock（可为 NULL）并阻塞当前线程，直到被 thread_wakeup 唤醒或经过 timeout 个时钟中断，0 表示不限时
+ * 醒来的原因不作区分且可能是虚假唤醒，调用者须重新检查等待条件
+ */
+void thread_block_timeout(struct spinlock* plock, uint32_t timeout) {
+    ASSERT(intr_status_get() == INTR_OFF);
+
+    struct task_struct* cur_tcb = thread_running();
+    spin_lock(&cur_tcb->cpu->rq_lock);
+    cur_tcb->status = TASK_BLOCKED;
+    /* 持有调度锁后才允许唤醒，唤醒者拿到调度锁时本线程已经换下处理器 */
+    cur_tcb->wait_token = 1;
+    if(timeout != 0) {
+        cur_tcb->wake_tick = ticks + timeout;
+        sleep_list_insert(cur_tcb);
+    }
+    if(plock != NULL) {
+        spin_unlock(plock);
+    }
+    sched_switch(cur_tcb);
+
+    /* 被唤醒：作废令牌，并在超时前被唤醒时撤销定时 */
+    cur_tcb->wait_token = 0;
+    if(cur_tcb->sleep_queued) {
+        spin_lock(&sleep_lock);
+        if(cur_tcb->sleep_queued) {
+            list_remove(&cur_tcb->sleep_tag);
+            cur_tcb->sleep_queued = false;
+        }
+        spin_unlock(&sleep_lock);
+    }
+}
+
+/* 唤醒在 thread_block_timeout 中阻塞的 pthread，等待者与超时竞争唤醒时只有取得令牌的一方生效 */
+bool thread_wakeup(struct task_struct* pthread) {
+    uint32_t token = 0;
+    asm volatile("xchgl %0, %1" : "+r" (token), "+m" (pthread->wait_token) : : "memory");
+    if(token == 0) {
+        return false;
+    }
+    thread_unblock(pthread);
+    return true;
+}
+
+/* 睡眠 sleep_ticks 个时钟中断 */
+void thread_sleep(uint32_t sleep_ticks) {
+    uint32_t tick_start = ticks;
+    enum intr_status old_stat = intr_disable();
+    while(ticks - tick_start < sleep_ticks) {
+        thread_block_timeout(NULL, sleep_ticks - (ticks - tick_start));
+    }
+    intr_status_set(old_stat);
+}
+
+/* BSP 时钟中断中唤醒到期的限时阻塞任务 */
+void thread_sleep_tick(uint32_t now) {
+    struct task_struct* expired[SLEEP_WAKE_BATCH];
+    uint32_t expired_cnt = 0;
+
+    spin_lock(&sleep_lock);
+    while(!list_empty(&sleep_list) && expired_cnt < SLEEP_WAKE_BATCH) {
+        struct task_struct* pthread = elem2entry(struct task_struct, sleep_tag, sleep_list.head.next);
+        if((int32_t)(now - pthread->wake_tick) < 0) {
+            break;
+        }
+        list_remove(&pthread->sleep_tag);
+        pthread->sleep_queued = false;
+        expired[expired_cnt++] = pthread;
+    }
+    spin_unlock(&sleep_lock);
+
+    /* 唤醒需要持有调度锁，不能在 sleep_lock 内进行 */
+    uint32_t idx;
+    for(idx = 0; idx < expired_cnt; idx++) {
+        thread_wakeup(expired[idx]);
+    }
+}
+
 /* wakeup blocked thread */
 void thread_unblock(struct task_struct* pthread) {
-    ASSERT((TASK_BLOCKED == pthread->status) || (TASK_WAITING == pthread->status) || (TASK_HANGING == pthread->status));
     enum intr_status old_stat = intr_disable();
+    /* 阻塞的任务不会被迁移，cpu 不会改变 */
+    struct cpu* pcpu = pthread->cpu;
+    spin_lock(&pcpu->rq_lock);
 
+    ASSERT((TASK_BLOCKED == pthread->status) || (TASK_WAITING == pthread->status) || (TASK_HANGING == pthread->status));
     if(TASK_READY != pthread->status) {
-        ASSERT(!elem_find(&__thread_ready_list, &pthread->general_tag));
-        if(elem_find(&__thread_ready_list, &pthread->general_tag)) {
-            PANIC("thread_unblock: blocked thread in ready_list\n") ;
-        }
-        list_push_front(&__thread_ready_list, &pthread->general_tag);
-        pthread->status = TASK_READY;
+        rq_push(pcpu, pthread, true);
     }
 
+    spin_unlock(&pcpu->rq_lock);
     intr_status_set(old_stat);
+    smp_send_resched(pcpu);
 }
 
 /* 主动让出 CPU 切换其他线程 */
@@ -148,14 +361,136 @@ void thread_yield(void) {
     enum intr_status old_stat = intr_disable();
 
     struct task_struct* cur_thread = thread_running();
-    ASSERT(!elem_find(&__thread_ready_list, &cur_thread->general_tag));
-    list_push_back(&__thread_ready_list, &cur_thread->general_tag);
-    cur_thread->status = TASK_READY;
-    schedule();
+    struct cpu* pcpu = cur_thread->cpu;
+    spin_lock(&pcpu->rq_lock);
+    if(cur_thread != pcpu->idle) {
+        rq_push(pcpu, cur_thread, false);
+    } else {
+        cur_thread->status = TASK_READY;
+    }
+    sched_switch(cur_thread);
     
     intr_status_set(old_stat);
 }
 
+/* 比较任务的 pid */
+static bool pid_check(struct list_elem* elem, void* pid) {
+    struct task_struct* pthread = elem2entry(struct task_struct, all_list_tag, elem);
+    return pthread->pid == (pid_t)(int32_t)pid;
+}
+
+/* 在全部任务队列中查找 pid 对应的任务 */
+struct task_struct* pid2thread(pid_t pid) {
+    enum intr_status old_stat = spin_lock_intr(&all_list_lock);
+    struct list_elem* elem = list_traversal(&__thread_all_list, pid_check, (void*)(int32_t)pid);
+    spin_unlock_intr(&all_list_lock, old_stat);
+    return elem == NULL ? NULL : elem2entry(struct task_struct, all_list_tag, elem);
+}
+
+/* 回收已死亡任务的 PCB：等待其完全换下处理器，移出全部任务队列并释放所在页 */
+void thread_reap(struct task_struct* pthread) {
+    while(pthread->status != TASK_DIED) {
+        thread_yield();
+    }
+    /* 死亡状态在持有调度锁时设置，该锁直到换上的任务执行 schedule_tail 才释放，此后其上下文不再被使用 */
+    enum intr_status old_stat = intr_disable();
+    spin_lock(&pthread->cpu->rq_lock);
+    spin_unlock(&pthread->cpu->rq_lock);
+    intr_status_set(old_stat);
+
+    old_stat = spin_lock_intr(&all_list_lock);
+    list_remove(&pthread->all_list_tag);
+    spin_unlock_intr(&all_list_lock, old_stat);
+    mfree_page(MPF_KERNEL, pthread, 1);
+}
+
+/* 设置 pthread 的当前优先级（优先级继承使用），提升时若其处于就绪状态则移到就绪队列头部 */
+void thread_priority_set(struct task_struct* pthread, uint8_t prio) {
+    enum intr_status old_stat = intr_disable();
+    struct cpu* pcpu = pthread->cpu;
+    if(pcpu == NULL) {
+        /* 还未加入任何就绪队列 */
+        pthread->priority = prio;
+        intr_status_set(old_stat);
+        return;
+    }
+    spin_lock(&pcpu->rq_lock);
+    /* 就绪任务可能被负载均衡迁移，持锁后再确认 */
+    while(pthread->cpu != pcpu) {
+        spin_unlock(&pcpu->rq_lock);
+        pcpu = pthread->cpu;
+        spin_lock(&pcpu->rq_lock);
+    }
+    if(prio > pthread->priority) {
+        /* 被提升的锁持有者应尽快运行并获得足够的时间片以释放锁 */
+        pthread->ticks = prio;
+        if(pthread->status == TASK_READY && pthread != pcpu->idle) {
+            list_remove(&pthread->general_tag);
+            list_push_front(&pcpu->ready_list, &pthread->general_tag);
+        }
+    } else if(pthread->ticks > prio) {
+        pthread->ticks = prio;
+    }
+    pthread->priority = prio;
+    spin_unlock(&pcpu->rq_lock);
+    intr_status_set(old_stat);
+}
+
+/* 负载均衡：从就绪任务最多的处理器拉取一个任务到 this_cpu */
+static void thread_balance(struct cpu* this_cpu) {
+    struct cpu* busiest = NULL;
+    uint8_t cpu_idx;
+    for(cpu_idx = 0; cpu_idx < cpu_cnt; cpu_idx++) {
+        struct cpu* pcpu = &cpus[cpu_idx];
+        if(pcpu != this_cpu && (busiest == NULL || pcpu->nr_ready > busiest->nr_ready)) {
+            busiest = pcpu;
+        }
+    }
+    /* 相差不足 2 个任务时迁移只会来回颠簸 */
+    if(busiest == NULL || busiest->nr_ready < this_cpu->nr_ready + 2) {
+        return;
+    }
+
+    /* 按编号顺序加锁，避免两个处理器互相拉取时死锁 */
+    struct cpu* first = this_cpu->id < busiest->id ? this_cpu : busiest;
+    struct cpu* second = this_cpu->id < busiest->id ? busiest : this_cpu;
+    spin_lock(&first->rq_lock);
+    spin_lock(&second->rq_lock);
+    if(busiest->nr_ready >= this_cpu->nr_ready + 2) {
+        /* 迁移队尾的任务：它离被调度最远，缓存最冷 */
+        struct task_struct* pthread =
+            elem2entry(struct task_struct, general_tag, busiest->ready_list.tail.prev);
+        list_remove(&pthread->general_tag);
+        busiest->nr_ready--;
+        rq_push(this_cpu, pthread, false);
+    }
+    spin_unlock(&second->rq_lock);
+    spin_unlock(&first->rq_lock);
+}
+
+/* 时钟中断中的时间片记账，时间片用完则调度 */
+void thread_tick(void) {
+    struct task_struct* cur_thread = thread_running();
+
+    /* 判断栈是否溢出 */
+    ASSERT(0x19990926 == cur_thread->stack_magic);
+
+    cur_thread->elapsed_ticks++;
+
+    struct cpu* pcpu = cur_thread->cpu;
+    if(cpu_cnt > 1 && --pcpu->balance_ticks == 0) {
+        pcpu->balance_ticks = SCHED_BALANCE_TICKS;
+        thread_balance(pcpu);
+    }
+
+    /* 时间片用完则开始新的调度 */
+    if(cur_thread->ticks == 0) {
+        schedule();
+    } else {
+        cur_thread->ticks--;
+    }
+}
+
 /* 将 kernel 中的 main 函数完善为主线程 */
 static void make_main_thread(void) {
     /* main 线程早已经运行，
@@ -164,14 +499,16 @@ static void make_main_thread(void) {
     PCB 地址为 0xc009e000，不需要另外申请页面 */
     main_thread = thread_running();
     thread_attr_init(main_thread, "main", MAIN_THREAD_PRIORITY);
+    main_thread->cpu = &cpus[0];
 
     /* main 函数为当前线程，不在就绪队列中，仅在 __thread_all_list 中 */
-    ASSERT(!(elem_find(&__thread_all_list, &main_thread->all_list_tag)));
-    list_push_back(&__thread_all_list, &main_thread->all_list_tag);
+    all_list_push(main_thread);
+    /* 此后所有任务的 held_lockers 均已初始化 */
+    locker_pi_enable();
 }
 
-/* 系统空闲时运行的线程 */
-static void idle(void* arg UNUSED) {
+/* 系统空闲时运行的线程，每个处理器一个 */
+void thread_idle(void* arg UNUSED) {
     while(1) {
         thread_block(TASK_BLOCKED);
         /* 开中断执行 hlt */
@@ -179,64 +516,45 @@ static void idle(void* arg UNUSED) {
     }
 }
 
+/* 为处理器 pcpu 创建 idle 线程，idle 不进入就绪队列 */
+struct task_struct* thread_idle_create(struct cpu* pcpu, char* name) {
+    struct task_struct* thread = get_kernel_pages(1);
+    thread_attr_init(thread, name, IDLE_THREAD_PRIORITY);
+    thread_create(thread, thread_idle, NULL);
+    thread->cpu = pcpu;
+    thread->status = TASK_BLOCKED;
+    pcpu->idle = thread;
+    all_list_push(thread);
+    return thread;
+}
+
 /* task schedule */
 void schedule(void) {
     ASSERT(intr_status_get() == INTR_OFF);
     /* 主要任务：将当前线程下处理器，并在就绪队列中找到下一个可运行的执行流，换上处理器 */
     struct task_struct* cur_tcb = thread_running();
-    if(cur_tcb->status == TASK_RUNNING) {
-        /* 时间片到，加入就绪队列尾部 */
-
-        ASSERT(!elem_find(&__thread_ready_list, &cur_tcb->general_tag));
-
-        list_push_back(&__thread_ready_list, &cur_tcb->general_tag);
-        cur_tcb->ticks = cur_tcb->priority; /* 重置时间片为 priority */
-        cur_tcb->status = TASK_READY;
-    } else {
-        /* 不是时间片到下 CPU，不加入就绪队列，此时没有进行任何操作 */
-    }
-    
-    // /* 暂时用该语句保证就绪队列不为空 */
-    // ASSERT(!list_empty(&__thread_ready_list));
-    /* 没有可运行的任务，则执行 idle */
-    if(list_empty(&__thread_ready_list)) {
-        thread_unblock(idle_thread);
-    }
-
-    /* 从就绪队列获取一个 tcb，但因为其中存的是 list_elem 需要转化为 tcb 的地址 */
-    thread_tag = NULL;
-    thread_tag = list_pop(&__thread_ready_list);
-    /* elem to tcb */
-    struct task_struct* next_tcb =\
-        elem2entry(struct task_struct, general_tag, thread_tag);
-    next_tcb->status = TASK_RUNNING;
-
-    /* activate task page table ... */
-    process_activate(next_tcb);
-
-    // struct list_elem* elem = &__thread_ready_list.head;
-    // while(elem != &__thread_ready_list.tail) {
-    //     put_int((uint32_t)elem2entry(struct task_struct, general_tag, elem));
-    //     elem = elem->next;
-    // }
-
-    switch_to(cur_tcb, next_tcb);
+    spin_lock(&cur_tcb->cpu->rq_lock);
+    sched_switch(cur_tcb);
 }
 
 /* init thread environment */
 void thread_env_init(void) {
     put_str("thread_env_init start\n");
     
-    list_init(&__thread_ready_list);
+    cpu_init(&cpus[0], 0);
+    cpu_cnt = 1;
     list_init(&__thread_all_list);
+    spin_init(&all_list_lock);
+    list_init(&sleep_list);
+    spin_init(&sleep_lock);
     
-    locker_init(&pid_locker);
+    locker_init(&pid_locker, "pid");
     /* 创建第一个用户进程：放在第一个初始化，init 进程pid就会为 1 */
     process_execute(init, "init");
     /* 当前 main 函数设置为主线程 */
     make_main_thread();
     /* 创建 idle 线程 */
-    idle_thread = thread_start("idle", IDLE_THREAD_PRIORITY, idle, NULL);
+    idle_thread = thread_idle_create(&cpus[0], "idle");
     
     put_str("thread_env_init done\n");
 }
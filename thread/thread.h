@@ -19,6 +19,11 @@ typedef void thread_func(void*);
 
 typedef int16_t pid_t;
 
+struct cpu;
+struct spinlock;
+struct locker;
+struct syscall_stat;
+
 /* process & thread status */
 enum task_status {
 	TASK_RUNNING, /* running */
@@ -80,6 +85,11 @@ struct thread_stack {
 	void* func_arg; /* kernel_thread 调用函数所需参数  */
 };
 
+/* FXSAVE/FXRSTOR 保存的 x87 及 SSE 寄存器，须 16 字节对齐 */
+struct fpu_state {
+	uint8_t fxsave[512];
+} __attribute__ ((aligned(16)));
+
 /* 进程或线程的 PCB */
 struct task_struct {
 	uint32_t* self_kstack; /* 各内核线程都用自己的内核栈 */
@@ -99,9 +109,38 @@ struct task_struct {
 	struct list_elem all_list_tag;
 	uint32_t* pgdir; /* 进程自己页表的虚拟地址，线程为 NULL */
 	struct vaddr_mem_pool userprog_vaddr_mem_pool; /* 用户进程虚拟地址 */
+	void* vdso_pages; /* vdso 的页表及进程数据页，共两页 */
 	mem_bck_desc_t u_bck_descs[MEM_DESC_CNT];
 	
 	uint32_t cwd_inode_nr; /* 进程所在工作目录的 inode 编号 */
+
+	/* 用户线程：同一进程的线程共享组长的页表、虚拟地址池、堆、文件描述符表和工作目录 */
+	struct task_struct* group_leader; /* 所属进程，进程及内核线程为自身 */
+	uint32_t nr_threads; /* 组长有效：进程中存活的线程数，含组长 */
+	void* ustack; /* 用户线程的 3 级栈 */
+	void* exit_retval; /* thread_exit 的返回值 */
+	volatile bool exited; /* 已调用 thread_exit，等待被 join 回收 */
+	struct task_struct* joiner; /* 等待本线程退出的线程 */
+	struct cpu* cpu; /* 所在处理器，仅在就绪（不在运行）时可被负载均衡迁移 */
+	struct cpu* pgdir_cpu; /* 上次加载页目录的处理器，换到其他处理器后首次运行须重新加载 cr3 */
+	uint32_t lock_depth; /* 大内核锁嵌套深度 */
+	struct syscall_stat* sc_stat; /* 组长有效：本进程的系统调用统计，首次系统调用返回时分配 */
+
+	/* 优先级继承：priority 为当前（可能被提升的）优先级，base_priority 为自身优先级 */
+	uint8_t base_priority;
+	struct locker* blocked_on; /* 正在等待的锁 */
+	struct list held_lockers; /* 持有的锁 */
+	struct list_elem pi_tag; /* 加入所等待锁的 pi_waiters */
+
+	/* 限时阻塞：wait_token 为 1 时才可被 thread_wakeup 唤醒，sleep_tag 按 wake_tick 加入 sleep_list */
+	volatile uint32_t wait_token;
+	uint32_t wake_tick;
+	bool sleep_queued;
+	struct list_elem sleep_tag;
+
+	bool fpu_used; /* 是否使用过 FPU，未使用过的任务首次使用时初始化 FPU */
+	struct cpu* fpu_cpu; /* FPU 寄存器中保存着本任务状态的处理器 */
+	struct fpu_state fpu; /* 换下处理器时保存的 FPU 状态 */
 	uint32_t stack_magic; /* 定义的魔数，如果该值被覆盖，说明溢出 */
 };
 /* 获取当前线程 PCB 指针 */
@@ -119,18 +158,57 @@ void thread_attr_init(struct task_struct* pthread, char* name, int priority);
 /* 创建优先级为 prio 名为 name 的线程，执行函数为 func(func_arg) */
 struct task_struct* thread_start(char* name, int priority, thread_func* func, void* func_arg);
 
+/* 将新建的任务加入负载最轻的处理器就绪队列及全部任务队列 */
+void thread_ready_new(struct task_struct* pthread);
+
 /* thread block */
 void thread_block(enum task_status stat);
 
+/* 释放自旋锁 plock 并阻塞当前线程，二者是原子的，调用前须关中断并持有 plock */
+void thread_block_release(enum task_status stat, struct spinlock* plock);
+
+/* 释放自旋锁 plock（可为 NULL）并阻塞当前线程，直到被 thread_wakeup 唤醒或经过 timeout 个时钟中断，0 表示不限时 */
+void thread_block_timeout(struct spinlock* plock, uint32_t timeout);
+
+/* 唤醒在 thread_block_timeout 中阻塞的 pthread，已被唤醒（或超时）则返回 false */
+bool thread_wakeup(struct task_struct* pthread);
+
+/* 睡眠 sleep_ticks 个时钟中断 */
+void thread_sleep(uint32_t sleep_ticks);
+
+/* BSP 时钟中断中唤醒到期的限时阻塞任务 */
+void thread_sleep_tick(uint32_t now);
+
 /* wakeup blocked thread */
 void thread_unblock(struct task_struct* pthread);
 
 /* 主动让出 CPU 切换其他线程 */
 void thread_yield(void);
 
+/* 在全部任务队列中查找 pid 对应的任务 */
+struct task_struct* pid2thread(pid_t pid);
+
+/* 回收已死亡任务的 PCB：等待其完全换下处理器，移出全部任务队列并释放所在页 */
+void thread_reap(struct task_struct* pthread);
+
+/* 设置 pthread 的当前优先级（优先级继承使用），提升时若其处于就绪状态则移到就绪队列头部 */
+void thread_priority_set(struct task_struct* pthread, uint8_t prio);
+
 /* task schedule */
 void schedule(void);
 
+/* switch_to 切换完成后由新任务调用，释放调度锁 */
+void schedule_tail(void);
+
+/* 时钟中断中的时间片记账，时间片用完则调度 */
+void thread_tick(void);
+
+/* 系统空闲时运行的线程，每个处理器一个 */
+void thread_idle(void* arg);
+
+/* 为处理器 pcpu 创建 idle 线程，idle 不进入就绪队列 */
+struct task_struct* thread_idle_create(struct cpu* pcpu, char* name);
+
 /* init thread environment */
 void thread_env_init(void);
 
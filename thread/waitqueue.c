@@ -0,0 +1,70 @@
+#include "waitqueue.h"
+#include "interrupt.h"
+#include "debug.h"
+
+/* init wait queue */
+void wait_queue_init(wait_queue_t* wq) {
+    spin_init(&wq->spin);
+    list_init(&wq->entries);
+}
+
+/* add entry of waiter to wq */
+void wait_queue_add(wait_queue_t* wq, struct wait_entry* entry, waiter_t* waiter) {
+    entry->waiter = waiter;
+    enum intr_status old_stat = spin_lock_intr(&wq->spin);
+    list_push_back(&wq->entries, &entry->tag);
+    spin_unlock_intr(&wq->spin, old_stat);
+}
+
+/* remove entry from wq */
+void wait_queue_del(wait_queue_t* wq, struct wait_entry* entry) {
+    enum intr_status old_stat = spin_lock_intr(&wq->spin);
+    list_remove(&entry->tag);
+    spin_unlock_intr(&wq->spin, old_stat);
+}
+
+/* wake up all waiters of wq */
+void wait_queue_wake(wait_queue_t* wq) {
+    /* 快速路径：没有等待者不加锁，调用者已在改变状态后执行过全屏障 */
+    if(list_empty(&wq->entries)) {
+        return;
+    }
+    enum intr_status old_stat = spin_lock_intr(&wq->spin);
+    struct list_elem* elem = wq->entries.head.next;
+    while(elem != &wq->entries.tail) {
+        waiter_t* waiter = elem2entry(struct wait_entry, tag, elem)->waiter;
+        /* 先置标志再唤醒，等待者在 waiter->spin 内检查标志，唤醒不会丢失 */
+        spin_lock(&waiter->spin);
+        waiter->triggered = true;
+        thread_wakeup(waiter->task);
+        spin_unlock(&waiter->spin);
+        elem = elem->next;
+    }
+    spin_unlock_intr(&wq->spin, old_stat);
+}
+
+/* init waiter for current thread */
+void waiter_init(waiter_t* waiter) {
+    spin_init(&waiter->spin);
+    waiter->task = thread_running();
+    waiter->triggered = false;
+}
+
+/* clear triggered before checking conditions */
+void waiter_prepare(waiter_t* waiter) {
+    enum intr_status old_stat = spin_lock_intr(&waiter->spin);
+    waiter->triggered = false;
+    spin_unlock_intr(&waiter->spin, old_stat);
+}
+
+/* block until some wait queue wakes waiter up or timeout ticks passed (0 : forever), return immediately if already triggered */
+void waiter_sleep(waiter_t* waiter, uint32_t timeout) {
+    ASSERT(waiter->task == thread_running());
+    enum intr_status old_stat = spin_lock_intr(&waiter->spin);
+    if(waiter->triggered) {
+        spin_unlock_intr(&waiter->spin, old_stat);
+        return;
+    }
+    thread_block_timeout(&waiter->spin, timeout);
+    intr_status_set(old_stat);
+}
@@ -0,0 +1,49 @@
+#ifndef __THREAD_WAITQUEUE_H
+#define __THREAD_WAITQUEUE_H
+
+#include "global.h"
+#include "list.h"
+#include "sync.h"
+#include "thread.h"
+
+/* 等待者：可以同时挂在多个等待队列上，任何一个队列唤醒都会让它醒来（poll） */
+typedef struct {
+    spinlock_t spin; /* 与 thread_block_timeout 配合，登记唤醒与阻塞之间不丢失唤醒 */
+    struct task_struct* task;
+    volatile bool triggered; /* 上次检查之后有队列发出过唤醒 */
+}waiter_t;
+
+/* 等待者在一个等待队列中的挂载项 */
+struct wait_entry {
+    struct list_elem tag;
+    waiter_t* waiter;
+};
+
+/* 等待队列：对象状态变化（可读、可写、关闭）时唤醒队列中全部等待者 */
+typedef struct {
+    spinlock_t spin; /* 保护 entries，中断处理程序也会唤醒 */
+    struct list entries;
+}wait_queue_t;
+
+/* init wait queue */
+void wait_queue_init(wait_queue_t* wq);
+
+/* add entry of waiter to wq */
+void wait_queue_add(wait_queue_t* wq, struct wait_entry* entry, waiter_t* waiter);
+
+/* remove entry from wq */
+void wait_queue_del(wait_queue_t* wq, struct wait_entry* entry);
+
+/* wake up all waiters of wq */
+void wait_queue_wake(wait_queue_t* wq);
+
+/* init waiter for current thread */
+void waiter_init(waiter_t* waiter);
+
+/* clear triggered before checking conditions */
+void waiter_prepare(waiter_t* waiter);
+
+/* block until some wait queue wakes waiter up or timeout ticks passed (0 : forever), return immediately if already triggered */
+void waiter_sleep(waiter_t* waiter, uint32_t timeout);
+
+#endif /* __THREAD_WAITQUEUE_H */
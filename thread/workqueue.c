@@ -0,0 +1,182 @@
+#include "workqueue.h"
+#include "memory.h"
+#include "interrupt.h"
+#include "debug.h"
+#include "print.h"
+#include "string.h"
+
+extern uint32_t ticks; /* 时钟中断次数 */
+
+workqueue_t* system_wq;
+
+static struct list delayed_list; /* 按到期时间升序排列的延时工作 */
+static spinlock_t delayed_lock; /* 保护 delayed_list */
+
+/* init work pointed to by pwork, func(arg) will be called in worker thread */
+void work_init(work_t* pwork, work_func* func, void* arg) {
+    pwork->tag.prev = pwork->tag.next = NULL;
+    pwork->func = func;
+    pwork->arg = arg;
+    pwork->pending = false;
+}
+
+/* init delayed work pointed to by pdwork */
+void delayed_work_init(delayed_work_t* pdwork, work_func* func, void* arg) {
+    work_init(&pdwork->work, func, arg);
+    pdwork->timer_tag.prev = pdwork->timer_tag.next = NULL;
+    pdwork->wq = NULL;
+    pdwork->expire = 0;
+    pdwork->timer_pending = false;
+}
+
+/* 唤醒所有等待 flush 的任务，由它们自行检查条件。调用者持有 wq->lock */
+static void flushers_wakeup(workqueue_t* wq) {
+    while(!list_empty(&wq->flushers)) {
+        struct task_struct* pthread = elem2entry(struct task_struct, general_tag, list_pop(&wq->flushers));
+        thread_unblock(pthread);
+    }
+}
+
+/* 工作线程：依次取出工作执行，队列为空则阻塞 */
+static void worker_thread(void* arg) {
+    workqueue_t* wq = arg;
+    while(1) {
+        enum intr_status old_stat = spin_lock_intr(&wq->lock);
+        while(list_empty(&wq->works)) {
+            wq->worker_sleeping = true;
+            thread_block_release(TASK_BLOCKED, &wq->lock);
+            spin_lock(&wq->lock);
+        }
+        work_t* pwork = elem2entry(work_t, tag, list_pop(&wq->works));
+        pwork->pending = false; /* 执行期间可以再次提交 */
+        work_func* func = pwork->func;
+        void* func_arg = pwork->arg;
+        spin_unlock(&wq->lock);
+
+        /* 工作与系统调用运行在相同的环境中：关中断并持有大内核锁，可直接调用文件系统等接口 */
+        kernel_lock();
+        func(func_arg);
+        kernel_unlock();
+
+        spin_lock(&wq->lock);
+        wq->done_seq++;
+        flushers_wakeup(wq);
+        spin_unlock_intr(&wq->lock, old_stat);
+    }
+}
+
+/* 创建名为 name 的 workqueue 及其工作线程，失败返回 NULL */
+workqueue_t* workqueue_create(char* name, int priority) {
+    ASSERT(strlen(name) < TASK_NAME_LEN);
+    workqueue_t* wq = sys_malloc(sizeof(workqueue_t));
+    if(wq == NULL) {
+        return NULL;
+    }
+    strcpy(wq->name, name);
+    spin_init(&wq->lock);
+    list_init(&wq->works);
+    list_init(&wq->flushers);
+    wq->worker_sleeping = false;
+    wq->queued_seq = 0;
+    wq->done_seq = 0;
+    wq->worker = thread_start(wq->name, priority, worker_thread, wq);
+    return wq;
+}
+
+/* 将 pwork 提交到 wq，已在队列中则返回 false。可在中断中调用 */
+bool queue_work(workqueue_t* wq, work_t* pwork) {
+    ASSERT(wq != NULL && pwork != NULL);
+    enum intr_status old_stat = spin_lock_intr(&wq->lock);
+    if(pwork->pending) {
+        spin_unlock_intr(&wq->lock, old_stat);
+        return false;
+    }
+    pwork->pending = true;
+    list_push_back(&wq->works, &pwork->tag);
+    wq->queued_seq++;
+    if(wq->worker_sleeping) {
+        wq->worker_sleeping = false;
+        thread_unblock(wq->worker);
+    }
+    spin_unlock_intr(&wq->lock, old_stat);
+    return true;
+}
+
+/* delay 个时钟中断后将 pdwork 提交到 wq，已在等待或已在队列中则返回 false。可在中断中调用 */
+bool queue_delayed_work(workqueue_t* wq, delayed_work_t* pdwork, uint32_t delay) {
+    ASSERT(wq != NULL && pdwork != NULL);
+    if(delay == 0) {
+        return queue_work(wq, &pdwork->work);
+    }
+    enum intr_status old_stat = spin_lock_intr(&delayed_lock);
+    if(pdwork->timer_pending || pdwork->work.pending) {
+        spin_unlock_intr(&delayed_lock, old_stat);
+        return false;
+    }
+    pdwork->wq = wq;
+    pdwork->expire = ticks + delay;
+    pdwork->timer_pending = true;
+
+    /* 插入到第一个比它晚到期的工作之前 */
+    struct list_elem* elem = delayed_list.head.next;
+    while(elem != &delayed_list.tail) {
+        delayed_work_t* other = elem2entry(delayed_work_t, timer_tag, elem);
+        if((int32_t)(other->expire - pdwork->expire) > 0) {
+            break;
+        }
+        elem = elem->next;
+    }
+    list_insert_before(elem, &pdwork->timer_tag);
+    spin_unlock_intr(&delayed_lock, old_stat);
+    return true;
+}
+
+/* 取消尚未到期的 pdwork，成功返回 true */
+bool cancel_delayed_work(delayed_work_t* pdwork) {
+    enum intr_status old_stat = spin_lock_intr(&delayed_lock);
+    bool canceled = pdwork->timer_pending;
+    if(canceled) {
+        list_remove(&pdwork->timer_tag);
+        pdwork->timer_pending = false;
+    }
+    spin_unlock_intr(&delayed_lock, old_stat);
+    return canceled;
+}
+
+/* 等待调用之前提交到 wq 的工作全部执行完，不可在 wq 的工作中调用 */
+void flush_workqueue(workqueue_t* wq) {
+    ASSERT(thread_running() != wq->worker);
+    enum intr_status old_stat = spin_lock_intr(&wq->lock);
+    uint32_t target = wq->queued_seq;
+    while((int32_t)(wq->done_seq - target) < 0) {
+        list_push_back(&wq->flushers, &thread_running()->general_tag);
+        thread_block_release(TASK_BLOCKED, &wq->lock);
+        spin_lock(&wq->lock);
+    }
+    spin_unlock_intr(&wq->lock, old_stat);
+}
+
+/* 时钟中断中调用，提交所有到期的延时工作 */
+void workqueue_tick(uint32_t now) {
+    spin_lock(&delayed_lock);
+    while(!list_empty(&delayed_list)) {
+        delayed_work_t* pdwork = elem2entry(delayed_work_t, timer_tag, delayed_list.head.next);
+        if((int32_t)(now - pdwork->expire) < 0) {
+            break;
+        }
+        list_remove(&pdwork->timer_tag);
+        pdwork->timer_pending = false;
+        queue_work(pdwork->wq, &pdwork->work);
+    }
+    spin_unlock(&delayed_lock);
+}
+
+/* init workqueue subsystem & system workqueue */
+void workqueue_init(void) {
+    put_str("workqueue_init start\n");
+    list_init(&delayed_list);
+    spin_init(&delayed_lock);
+    system_wq = workqueue_create("kworker", THREAD_PRIORITY_DEFAULT);
+    ASSERT(system_wq != NULL);
+    put_str("workqueue_init done\n");
+}
@@ -0,0 +1,73 @@
+#ifndef __THREAD_WORKQUEUE_H
+#define __THREAD_WORKQUEUE_H
+
+#include "global.h"
+#include "list.h"
+#include "sync.h"
+#include "thread.h"
+
+/* work function type */
+typedef void work_func(void* arg);
+
+struct workqueue;
+
+/* 一项推迟执行的工作 */
+typedef struct work {
+    struct list_elem tag; /* 加入 workqueue 的工作队列 */
+    work_func* func;
+    void* arg;
+    bool pending; /* 已在队列中尚未执行，重复提交会被忽略 */
+}work_t;
+
+/* 延时 expire 个时钟中断后才提交的工作 */
+typedef struct delayed_work {
+    work_t work;
+    struct list_elem timer_tag; /* 加入按到期时间排序的定时队列 */
+    struct workqueue* wq; /* 到期后提交到的 workqueue */
+    uint32_t expire; /* 到期时的 ticks */
+    bool timer_pending; /* 在定时队列中 */
+}delayed_work_t;
+
+/* 由一个同名内核线程顺序执行队列中的工作 */
+typedef struct workqueue {
+    char name[TASK_NAME_LEN];
+    spinlock_t lock; /* 保护以下所有成员 */
+    struct list works; /* 待执行的工作 */
+    struct task_struct* worker; /* 工作线程 */
+    bool worker_sleeping; /* 工作线程因队列为空而阻塞 */
+    uint32_t queued_seq; /* 累计提交的工作数 */
+    uint32_t done_seq; /* 累计执行完的工作数 */
+    struct list flushers; /* 等待 flush 完成的任务 */
+}workqueue_t;
+
+/* 系统默认 workqueue，供不需要独立工作线程的子系统使用 */
+extern workqueue_t* system_wq;
+
+/* init work pointed to by pwork, func(arg) will be called in worker thread */
+void work_init(work_t* pwork, work_func* func, void* arg);
+
+/* init delayed work pointed to by pdwork */
+void delayed_work_init(delayed_work_t* pdwork, work_func* func, void* arg);
+
+/* 创建名为 name 的 workqueue 及其工作线程，失败返回 NULL */
+workqueue_t* workqueue_create(char* name, int priority);
+
+/* 将 pwork 提交到 wq，已在队列中则返回 false。可在中断中调用 */
+bool queue_work(workqueue_t* wq, work_t* pwork);
+
+/* delay 个时钟中断后将 pdwork 提交到 wq，已在等待或已在队列中则返回 false。可在中断中调用 */
+bool queue_delayed_work(workqueue_t* wq, delayed_work_t* pdwork, uint32_t delay);
+
+/* 取消尚未到期的 pdwork，成功返回 true */
+bool cancel_delayed_work(delayed_work_t* pdwork);
+
+/* 等待调用之前提交到 wq 的工作全部执行完，不可在 wq 的工作中调用 */
+void flush_workqueue(workqueue_t* wq);
+
+/* 时钟中断中调用，提交所有到期的延时工作 */
+void workqueue_tick(uint32_t now);
+
+/* init workqueue subsystem & system workqueue */
+void workqueue_init(void);
+
+#endif /* __THREAD_WORKQUEUE_H */
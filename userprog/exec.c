@@ -4,8 +4,13 @@
 #include "thread.h"
 #include "fs.h"
 #include "stdio_kernel.h"
+#include "sync.h"
+#include "fpu.h"
+#include "file.h"
 
 extern void intr_exit(void);
+extern struct partition* __cur_part; /* 当前操作分区（全局变量） */
+extern struct file __file_table[MAX_FILE_OPEN]; /* 文件表 */
 
 // /* 将文件描述符 fd 指向的文件中，偏移为 offset，大小为 filesz 的段加载到虚拟地址 vaddr 的内存处 */
 // static bool seg_load(int fd, off_t offset, uint32_t filesz, uint32_t vaddr) {
@@ -122,44 +127,135 @@ extern void intr_exit(void);
 //     return 0;
 // }
 
-/* 将文件描述符fd指向的文件中,偏移为offset,大小为filesz的段加载到虚拟地址为vaddr的内存 */
-static bool segment_load(int32_t fd, uint32_t offset, uint32_t filesz, uint32_t vaddr) {
-   uint32_t vaddr_first_page = vaddr & 0xfffff000;    // vaddr地址所在的页框
-   uint32_t size_in_first_page = PG_SIZE - (vaddr & 0x00000fff);     // 加载到内存后,文件在第一个页框中占用的字节大小
-   uint32_t occupy_pages = 0;
-   /* 若一个页框容不下该段 */
-   if (filesz > size_in_first_page) {
-      uint32_t left_size = filesz - size_in_first_page;
-      occupy_pages = DIV_ROUND_UP(left_size, PG_SIZE) + 1;	     // 1是指vaddr_first_page
-   } else {
-      occupy_pages = 1;
+/* 可执行页缓存：以（分区，inode，虚拟页）为键缓存程序文件中完整落在某个段内的页，
+ * 之后加载同一程序时直接映射缓存的页框，只读段各进程共享，可写段写时复制；
+ * 缓存与每个映射各持有页框一个共享计数，被替换或失效的页框在最后一个映射撤销后释放。
+ * 表项在持有大内核锁的系统调用中访问，但读入文件时会阻塞，插入前须重新查找 */
+#define EXEC_CACHE_PAGES 256
+#define EXEC_CACHE_HASH_NR 64 /* 按 inode 散列，写文件时只需检查一个桶 */
+
+struct exec_page {
+   struct partition* part; /* NULL 表示空闲 */
+   uint32_t i_no;
+   uint32_t vaddr;     /* 页在程序中的虚拟地址，ELF 中 vaddr 与文件偏移一一对应 */
+   uint32_t phy_addr;  /* 缓存的页框，只读映射给各进程 */
+   bool writable;      /* 所在段可写：映射为写时复制 */
+   struct list_elem hash_tag;
+};
+
+static struct exec_page exec_cache[EXEC_CACHE_PAGES];
+static struct list exec_cache_hash[EXEC_CACHE_HASH_NR];
+static uint32_t exec_cache_next; /* 缓存满时按轮转替换 */
+
+/* 初始化可执行页缓存 */
+void exec_cache_init(void) {
+   uint32_t idx;
+   for (idx = 0; idx < EXEC_CACHE_HASH_NR; idx++) {
+      list_init(&exec_cache_hash[idx]);
    }
+}
 
-   /* 为进程分配内存 */
-   uint32_t page_idx = 0;
-   uint32_t vaddr_page = vaddr_first_page;
-   while (page_idx < occupy_pages) {
-      uint32_t* pde = pde_ptr(vaddr_page);
-      uint32_t* pte = pte_ptr(vaddr_page);
-
-      /* 如果pde不存在,或者pte不存在就分配内存.
-       * pde的判断要在pte之前,否则pde若不存在会导致
-       * 判断pte时缺页异常 */
-      if (!(*pde & 0x00000001) || !(*pte & 0x00000001)) {
-	 if (get_a_page(MPF_USER, vaddr_page) == NULL) {
-	    return false;
-	 }
-      } // 如果原进程的页表已经分配了,利用现有的物理页,直接覆盖进程体
-      vaddr_page += PG_SIZE;
-      page_idx++;
+/* 在可执行页缓存中查找 i_no 文件 vaddr 处的页 */
+static struct exec_page* exec_cache_lookup(uint32_t i_no, uint32_t vaddr) {
+   struct list* bucket = &exec_cache_hash[i_no % EXEC_CACHE_HASH_NR];
+   struct list_elem* elem;
+   for (elem = bucket->head.next; elem != &bucket->tail; elem = elem->next) {
+      struct exec_page* pg = elem2entry(struct exec_page, hash_tag, elem);
+      if (pg->part == __cur_part && pg->i_no == i_no && pg->vaddr == vaddr) {
+         return pg;
+      }
+   }
+   return NULL;
+}
+
+/* 移出缓存并放弃缓存持有的页框，仍映射着它的进程继续使用 */
+static void exec_cache_drop(struct exec_page* pg) {
+   list_remove(&pg->hash_tag);
+   pg->part = NULL;
+   page_frame_put(pg->phy_addr);
+}
+
+/* 将刚读入的页框加入可执行页缓存，返回应映射的页框：
+ * 读入期间其他进程已加入同一页时返回已缓存的页框，调用者的页框随映射替换而释放 */
+static uint32_t exec_cache_insert(uint32_t i_no, uint32_t vaddr, uint32_t phy_addr, bool writable) {
+   struct exec_page* pg = exec_cache_lookup(i_no, vaddr);
+   if (pg != NULL) {
+      return pg->phy_addr;
+   }
+   uint32_t idx;
+   for (idx = 0; idx < EXEC_CACHE_PAGES && pg == NULL; idx++) {
+      if (exec_cache[idx].part == NULL) {
+         pg = &exec_cache[idx];
+      }
+   }
+   if (pg == NULL) {
+      pg = &exec_cache[exec_cache_next];
+      exec_cache_next = (exec_cache_next + 1) % EXEC_CACHE_PAGES;
+      exec_cache_drop(pg);
+   }
+   pg->part = __cur_part;
+   pg->i_no = i_no;
+   pg->vaddr = vaddr;
+   pg->phy_addr = phy_addr;
+   pg->writable = writable;
+   page_frame_get(phy_addr);
+   list_push_back(&exec_cache_hash[i_no % EXEC_CACHE_HASH_NR], &pg->hash_tag);
+   return phy_addr;
+}
+
+/* 文件 i_no 被写入或删除，丢弃其缓存的页，已映射这些页框的进程继续使用旧内容 */
+void exec_cache_invalidate(uint32_t i_no) {
+   struct list* bucket = &exec_cache_hash[i_no % EXEC_CACHE_HASH_NR];
+   struct list_elem* elem = bucket->head.next;
+   while (elem != &bucket->tail) {
+      struct exec_page* pg = elem2entry(struct exec_page, hash_tag, elem);
+      elem = elem->next;
+      if (pg->part == __cur_part && pg->i_no == i_no) {
+         exec_cache_drop(pg);
+      }
+   }
+}
+
+/* 将文件描述符fd指向的文件中,偏移为offset,大小为filesz的段加载到虚拟地址为vaddr的内存
+ * 完整落在段内的页经可执行页缓存共享,段首尾不满一页的部分仍读入私有页框 */
+static bool segment_load(int32_t fd, uint32_t i_no, uint32_t offset, uint32_t filesz, uint32_t vaddr, bool writable) {
+   uint32_t vaddr_end = vaddr + filesz;
+   uint32_t vaddr_page = vaddr & 0xfffff000;    // vaddr地址所在的页框
+   while (vaddr_page < vaddr_end) {
+      uint32_t page_end = vaddr_page + PG_SIZE;
+      bool whole = vaddr_page >= vaddr && page_end <= vaddr_end;
+      if (whole) {
+         struct exec_page* pg = exec_cache_lookup(i_no, vaddr_page);
+         if (pg != NULL) {
+            page_share_map(vaddr_page, pg->phy_addr, pg->writable);
+            vaddr_page = page_end;
+            continue;
+         }
+      }
+
+      /* 未命中:读入私有页框.原进程已映射的私有页直接覆盖,共享页则换上新页框 */
+      if (page_private_get(vaddr_page) == NULL) {
+         return false;
+      }
+      uint32_t copy_start = vaddr_page > vaddr ? vaddr_page : vaddr;
+      uint32_t copy_end = page_end < vaddr_end ? page_end : vaddr_end;
+      sys_lseek(fd, offset + (copy_start - vaddr), SEEK_SET);
+      if (sys_read(fd, (void*)copy_start, copy_end - copy_start) != (int32_t)(copy_end - copy_start)) {
+         return false;
+      }
+
+      /* 整页读入后交给缓存,本进程也改为只读或写时复制映射 */
+      if (whole) {
+         uint32_t phy_addr = exec_cache_insert(i_no, vaddr_page, addr_v2p(vaddr_page), writable);
+         page_share_map(vaddr_page, phy_addr, writable);
+      }
+      vaddr_page = page_end;
    }
-   sys_lseek(fd, offset, SEEK_SET);
-   sys_read(fd, (void*)vaddr, filesz);
    return true;
 }
 
 /* 从文件系统上加载用户程序pathname,成功则返回程序的起始地址,否则返回-1 */
-static int32_t load(const char* pathname) {
+int32_t load(const char* pathname) {
    int32_t ret = -1;
    struct Elf32_Ehdr elf_header;
    struct Elf32_Phdr prog_header;
@@ -186,6 +282,7 @@ static int32_t load(const char* pathname) {
       goto done;
    }
 
+   uint32_t i_no = __file_table[fd_local2global(fd)].fd_inode->i_no;
    Elf32_Off prog_header_offset = elf_header.e_phoff; 
    Elf32_Half prog_header_size = elf_header.e_phentsize;
 
@@ -205,7 +302,7 @@ static int32_t load(const char* pathname) {
 
       /* 如果是可加载段就调用segment_load加载到内存 */
       if (PT_LOAD == prog_header.p_type) {
-	 if (!segment_load(fd, prog_header.p_offset, prog_header.p_filesz, prog_header.p_vaddr)) {
+	 if (!segment_load(fd, i_no, prog_header.p_offset, prog_header.p_filesz, prog_header.p_vaddr, prog_header.p_flags & PF_W)) {
 	    ret = -1;
 	    goto done;
 	 }
@@ -245,7 +342,9 @@ int32_t sys_execv(const char* path, const char* argv[]) {
    /* 使新用户进程的栈地址为最高用户空间地址 */
    intr_0_stack->esp = (void*)0xc0000000;
 
-   /* exec不同于fork,为使新进程更快被执行,直接从中断返回 */
+   /* exec不同于fork,为使新进程更快被执行,直接从中断返回，不再经过 syscall_dispatch，需自行释放大内核锁 */
+   fpu_reset_current();
+   kernel_unlock();
    asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (intr_0_stack) : "memory");
    return 0;
 }
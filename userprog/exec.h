@@ -1,6 +1,17 @@
 #ifndef __USERPROG_EXEC_H
 #define __USERPROG_EXEC_H
 
+#include "stdint.h"
+
+/* 从文件系统上加载用户程序 pathname 到当前进程的地址空间，成功则返回程序的起始地址，否则返回 -1 */
+int32_t load(const char* pathname);
+
+/* 初始化可执行页缓存 */
+void exec_cache_init(void);
+
+/* 文件 i_no 被写入或删除，丢弃可执行页缓存中该文件的页 */
+void exec_cache_invalidate(uint32_t i_no);
+
 /* 使用 path 指向的程序替换当前进程，失败返回 -1，成功无返回值 */
 int sys_execv(const char *path, const char *argv[]);
 
@@ -6,9 +6,7 @@
 #include "file.h"
 #include "thread.h"
 #include "stdio_kernel.h"
-
-extern struct list __thread_ready_list; /* ready tasks queue */
-extern struct list __thread_all_list; /* all tasks queue */
+#include "fpu.h"
 
 extern struct file __file_table[MAX_FILE_OPEN]; /* 文件表 */
 
@@ -18,17 +16,34 @@ extern void intr_exit(void); /* 中断返回地址 */
 static int32_t pcb_vbtmp_stk0_copy(struct task_struct* child_thread, struct task_struct* parent_thread) {
     /* 1 复制pcb所在的整个页面（pcb信息，0级栈以及返回地址） */
     memcpy(child_thread, parent_thread, PG_SIZE);
+    /* 由用户线程 fork 时，进程级的资源在组长中 */
+    struct task_struct* leader = parent_thread->group_leader;
+    memcpy(child_thread->fd_table, leader->fd_table, sizeof(leader->fd_table));
+    child_thread->userprog_vaddr_mem_pool = leader->userprog_vaddr_mem_pool;
+    child_thread->cwd_inode_nr = leader->cwd_inode_nr;
+    child_thread->group_leader = child_thread;
+    child_thread->nr_threads = 1;
+    child_thread->ustack = NULL;
+    child_thread->exited = false;
+    child_thread->joiner = NULL;
+    child_thread->pgdir_cpu = NULL;
     
     /* 修改对应信息 */
     child_thread->pid = fork_pid();
     child_thread->elapsed_ticks = 0;
     child_thread->status = TASK_READY;
+    child_thread->priority = child_thread->base_priority; /* 不继承父进程被提升的优先级及持有的锁 */
+    list_init(&child_thread->held_lockers);
+    child_thread->blocked_on = NULL;
     child_thread->ticks = child_thread->priority;
-    child_thread->ppid = parent_thread->pid;
+    child_thread->ppid = leader->pid;
     child_thread->general_tag.prev = NULL;
     child_thread->general_tag.next = NULL;
     child_thread->all_list_tag.prev = NULL;
     child_thread->all_list_tag.next = NULL;
+    child_thread->lock_depth = 0; /* 子进程从 intr_exit 返回，不持有大内核锁 */
+    child_thread->fpu_cpu = NULL; /* 子进程首次使用 FPU 时从复制来的 PCB 中恢复 */
+    child_thread->sc_stat = NULL; /* 子进程的系统调用统计从零开始 */
     bck_desc_init(child_thread->u_bck_descs);
 
     /* 复制父进程虚拟地址池的位图 */
@@ -45,9 +60,10 @@ static int32_t pcb_vbtmp_stk0_copy(struct task_struct* child_thread, struct task
 
 /* 复制父进程进程体（代码和数据）及用户栈 */
 static void procbody_stk3_copy(struct task_struct* child_thread, struct task_struct* parent_thread, void* buf_pg) {
-    uint8_t* vaddr_btmp = parent_thread->userprog_vaddr_mem_pool.vaddr_bitmap.bits;
-    uint32_t btmp_bytes_len = parent_thread->userprog_vaddr_mem_pool.vaddr_bitmap.btmp_bytes_len;
-    uint32_t vaddr_start = parent_thread->userprog_vaddr_mem_pool.vaddr_start;
+    struct vaddr_mem_pool* vaddr_pool = &parent_thread->group_leader->userprog_vaddr_mem_pool;
+    uint8_t* vaddr_btmp = vaddr_pool->vaddr_bitmap.bits;
+    uint32_t btmp_bytes_len = vaddr_pool->vaddr_bitmap.btmp_bytes_len;
+    uint32_t vaddr_start = vaddr_pool->vaddr_start;
     uint32_t byte_idx = 0;
     uint32_t bit_idx = 0;
     uint32_t prog_vaddr = 0;
@@ -57,6 +73,15 @@ static void procbody_stk3_copy(struct task_struct* child_thread, struct task_str
             while(bit_idx < 8) {
                 if((BITMAP_MASK << bit_idx) & vaddr_btmp[byte_idx]) {
                     prog_vaddr = vaddr_start + PG_SIZE * (byte_idx * 8 + bit_idx);
+                    uint32_t pte = *pte_ptr(prog_vaddr);
+                    if(!(pte & PG_RW_W)) {
+                        /* 页缓存中的共享页框：子进程以相同属性映射同一页框，不复制 */
+                        page_dir_activate(child_thread);
+                        page_share_map(prog_vaddr, pte & 0xfffff000, pte & PG_COW);
+                        page_dir_activate(parent_thread);
+                        bit_idx++;
+                        continue;
+                    }
                     /* 将父进程数据复制到内核缓冲 */
                     memcpy(buf_pg, (void*)prog_vaddr, PG_SIZE);
                     /* 页表切换到子进程，避免后续申请内存函数将pte和pde安装在父进程的页表中 */
@@ -101,15 +126,15 @@ static int32_t child_stk_build(struct task_struct* child_thread) {
     return 0;
 }
 
-/* 更新 inode 引用计数 */
-static void inode_ref_update(struct task_struct* thread) {
-    int32_t lfd = 3;
+/* 子进程与父进程共享文件表项（包括管道的两端），更新表项的引用计数 */
+void inode_ref_update(struct task_struct* thread) {
+    int32_t lfd = 0; /* dup2 后 0~2 也可能指向普通文件或管道 */
     int32_t gfd = 0;
     while(lfd < MAX_FILES_OPEN_PER_PROC) {
         gfd = thread->fd_table[lfd];
         ASSERT(gfd < MAX_FILE_OPEN);
-        if(gfd != -1) {
-            __file_table[gfd].fd_inode->i_count++;
+        if(gfd > stderr_no) {
+            __file_table[gfd].fd_refs++;
         }
         lfd++;
     }
@@ -121,8 +146,8 @@ static int32_t process_copy(struct task_struct* child_thread, struct task_struct
     if(pcb_vbtmp_stk0_copy(child_thread, parent_thread) == -1) {
         return -1;
     }
-    /* 2 为子进程创建页表，仅包含内核空间 */
-    child_thread->pgdir = page_dir_create();
+    /* 2 为子进程创建页表，仅包含内核空间及 vdso 数据页 */
+    child_thread->pgdir = page_dir_create(child_thread);
     if(child_thread->pgdir == NULL) {
         return -1;
     }
@@ -150,14 +175,12 @@ pid_t sys_fork(void) {
         return -1;
     }
     ASSERT(INTR_OFF == intr_status_get() && parent_thread->pgdir != NULL);
+    fpu_save_current(); /* 子进程继承父进程当前的 FPU 状态 */
     if(process_copy(child_thread, parent_thread) == -1) {
         return -1;
     }
 
-    ASSERT(!(elem_find(&__thread_ready_list, &child_thread->general_tag)));
-    list_push_back(&__thread_ready_list, &child_thread->general_tag);
-    ASSERT(!(elem_find(&__thread_all_list, &child_thread->all_list_tag)));
-    list_push_back(&__thread_all_list, &child_thread->all_list_tag);
+    thread_ready_new(child_thread);
 
     // printf("%s 0x%x\n", child_thread->name, child_thread);
     
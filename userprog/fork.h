@@ -3,6 +3,9 @@
 
 #include "thread.h"
 
+/* 子进程与父进程共享文件表项（包括管道的两端），更新表项的引用计数 */
+void inode_ref_update(struct task_struct* thread);
+
 /* fork 子进程 内核不可直接调用 */
 pid_t sys_fork(void);
 
@@ -0,0 +1,310 @@
+#include "mqueue.h"
+#include "memory.h"
+#include "sync.h"
+#include "list.h"
+#include "string.h"
+#include "debug.h"
+#include "timer.h"
+
+#define MQ_MSGS_DEFAULT     16      /* 默认最多容纳的消息数 */
+#define MQ_MSG_SIZE_DEFAULT 1024    /* 默认单条消息的最大字节数 */
+
+extern uint32_t ticks;
+
+/* 
+ * 队列中的一条消息
+ * 不足一页的消息整条复制在 data 中；一页及以上的消息，发送缓冲区中完整的页以写时复制共享页框，
+ * 首部到第一个页边界的 head_len 字节及尾部不足一页的部分复制在 data 中
+ * 消息由 kmalloc 在内核堆中分配，任何进程都能访问，用户态不能改写队列链表
+ */
+struct mq_message {
+    struct list_elem tag;
+    uint32_t prio;
+    uint32_t len;
+    uint32_t head_len;
+    uint32_t pg_cnt; /* 共享的页框数，消息各持有一份 */
+    uint32_t frames[MQ_MSG_SIZE_MAX / PG_SIZE];
+    char data[0];
+};
+
+/* 消息队列 */
+struct mqueue {
+    bool used;
+    char name[MQ_NAME_LEN];
+    uint32_t refs; /* 打开的次数加正在收发的次数，由 mq_table_lock 保护 */
+    uint32_t max_msgs;
+    uint32_t msg_size;
+    uint32_t cur_msgs;
+    struct list msgs; /* 按优先级从高到低排列，同优先级先进先出 */
+    locker_t lock; /* 保护 msgs、cur_msgs */
+    cond_t not_empty;
+    cond_t not_full;
+};
+
+static struct mqueue mq_table[MQ_MAX];
+static locker_t mq_table_lock; /* 保护队列的创建、销毁 */
+
+/* 初始化消息队列表 */
+void mqueue_init(void) {
+    memset(mq_table, 0, sizeof(mq_table));
+    locker_init(&mq_table_lock, NULL);
+}
+
+/* 队列描述符对应的队列，无效返回 NULL，调用者持有 mq_table_lock */
+static struct mqueue* mqd2mq(int32_t mqd) {
+    if(mqd < 0 || mqd >= MQ_MAX || !mq_table[mqd].used) {
+        return NULL;
+    }
+    return &mq_table[mqd];
+}
+
+/* 取得队列描述符对应的队列并增加引用，收发期间队列不会被 sys_mq_close 销毁，无效返回 NULL */
+static struct mqueue* mq_get(int32_t mqd) {
+    locker_lock(&mq_table_lock);
+    struct mqueue* mq = mqd2mq(mqd);
+    if(mq != NULL) {
+        mq->refs++;
+    }
+    locker_unlock(&mq_table_lock);
+    return mq;
+}
+
+/* 打开名为 name 的消息队列，不存在则按 attr 创建，成功返回队列描述符，失败返回 -1 */
+int32_t sys_mq_open(const char* name, const struct mq_attr* attr) {
+    if(name == NULL || name[0] == 0 || strlen(name) >= MQ_NAME_LEN) {
+        return -1;
+    }
+    uint32_t max_msgs = attr == NULL ? MQ_MSGS_DEFAULT : attr->max_msgs;
+    uint32_t msg_size = attr == NULL ? MQ_MSG_SIZE_DEFAULT : attr->msg_size;
+    if(max_msgs == 0 || max_msgs > MQ_MSGS_MAX || msg_size == 0 || msg_size > MQ_MSG_SIZE_MAX) {
+        return -1;
+    }
+
+    int32_t mqd = -1;
+    int32_t free_idx = -1;
+    int32_t idx;
+    locker_lock(&mq_table_lock);
+    for(idx = 0; idx < MQ_MAX; idx++) {
+        if(!mq_table[idx].used) {
+            if(free_idx == -1) {
+                free_idx = idx;
+            }
+        } else if(strcmp(mq_table[idx].name, name) == 0) {
+            mq_table[idx].refs++;
+            mqd = idx;
+            break;
+        }
+    }
+    if(mqd == -1 && free_idx != -1) {
+        struct mqueue* mq = &mq_table[free_idx];
+        strcpy(mq->name, name);
+        mq->refs = 1;
+        mq->max_msgs = max_msgs;
+        mq->msg_size = msg_size;
+        mq->cur_msgs = 0;
+        list_init(&mq->msgs);
+        locker_init(&mq->lock, NULL);
+        cond_init(&mq->not_empty);
+        cond_init(&mq->not_full);
+        mq->used = true;
+        mqd = free_idx;
+    }
+    locker_unlock(&mq_table_lock);
+    return mqd;
+}
+
+/* 释放消息及其持有的页框 */
+static void mq_message_free(struct mq_message* m) {
+    uint32_t idx;
+    for(idx = 0; idx < m->pg_cnt; idx++) {
+        page_frame_put(m->frames[idx]);
+    }
+    kfree(m);
+}
+
+/* 减少队列的引用，最后一个引用放弃后队列及其中的消息被销毁，调用者持有 mq_table_lock */
+static void mq_unref(struct mqueue* mq) {
+    if(--mq->refs == 0) {
+        while(!list_empty(&mq->msgs)) {
+            mq_message_free(elem2entry(struct mq_message, tag, list_pop(&mq->msgs)));
+        }
+        mq->used = false;
+    }
+}
+
+/* 放弃 mq_get 取得的引用 */
+static void mq_put(struct mqueue* mq) {
+    locker_lock(&mq_table_lock);
+    mq_unref(mq);
+    locker_unlock(&mq_table_lock);
+}
+
+/* 关闭队列描述符 mqd，最后一个使用者关闭后队列及其中的消息被销毁 */
+int32_t sys_mq_close(int32_t mqd) {
+    locker_lock(&mq_table_lock);
+    struct mqueue* mq = mqd2mq(mqd);
+    if(mq == NULL) {
+        locker_unlock(&mq_table_lock);
+        return -1;
+    }
+    mq_unref(mq);
+    locker_unlock(&mq_table_lock);
+    return 0;
+}
+
+/* 持有 mq->lock 在 cond 上等待，timeout 为从 start 起的毫秒数，-1 不限时，已超时返回 false */
+static bool mq_wait(struct mqueue* mq, cond_t* cond, int32_t timeout, uint32_t start) {
+    if(timeout < 0) {
+        cond_wait(cond, &mq->lock);
+        return true;
+    }
+    uint32_t elapsed = ticks_to_mtime(ticks - start);
+    if(elapsed >= (uint32_t)timeout) {
+        return false;
+    }
+    /* 被唤醒或超时都由调用者重新检查条件，超时在下一轮判断 */
+    cond_timedwait(cond, &mq->lock, (uint32_t)timeout - elapsed);
+    return true;
+}
+
+/* 按发送缓冲区构造消息，整页部分与发送者写时复制共享页框，失败返回 NULL */
+static struct mq_message* mq_message_build(const struct mq_msg* msg) {
+    uint32_t start = (uint32_t)msg->buf;
+    uint32_t end = start + msg->len;
+    uint32_t first_pg = (start + PG_SIZE - 1) & ~(PG_SIZE - 1);
+    uint32_t last_pg = end & ~(PG_SIZE - 1);
+    uint32_t pg_cnt = 0;
+    if(msg->len >= PG_SIZE && last_pg > first_pg) {
+        pg_cnt = (last_pg - first_pg) / PG_SIZE;
+    }
+    uint32_t head_len = pg_cnt == 0 ? msg->len : first_pg - start;
+    uint32_t tail_len = pg_cnt == 0 ? 0 : end - last_pg;
+
+    struct mq_message* m = kmalloc(sizeof(struct mq_message) + head_len + tail_len);
+    if(m == NULL) {
+        return NULL;
+    }
+    m->prio = msg->prio;
+    m->len = msg->len;
+    m->head_len = head_len;
+    m->pg_cnt = 0;
+    memcpy(m->data, msg->buf, head_len);
+    memcpy(m->data + head_len, (void*)last_pg, tail_len);
+
+    /* 页框共享：发送者的页改为只读，此后发送者或接收者写入时才复制，不写入则不复制 */
+    uint32_t vaddr = first_pg;
+    while(m->pg_cnt < pg_cnt) {
+        uint32_t frame = page_frame_share(vaddr);
+        if(frame == 0) {
+            /* 放弃已共享的页框，发送者的写时复制映射照常可用 */
+            mq_message_free(m);
+            return NULL;
+        }
+        m->frames[m->pg_cnt++] = frame;
+        vaddr += PG_SIZE;
+    }
+    return m;
+}
+
+/* 将消息交付到接收缓冲区 buf，页内偏移与发送时相同则写时复制地映射页框，返回是否成功 */
+static bool mq_message_deliver(struct mq_message* m, char* buf) {
+    bool ok = true;
+    memcpy(buf, m->data, m->head_len);
+    char* dst = buf + m->head_len;
+    bool remap = ((uint32_t)dst % PG_SIZE) == 0;
+    uint32_t idx;
+    for(idx = 0; idx < m->pg_cnt; idx++) {
+        if(remap) {
+            /* 接收缓冲区未映射时失败，不替接收者分配虚拟地址 */
+            if(!page_frame_attach((uint32_t)dst, m->frames[idx])) {
+                ok = false;
+            }
+        } else {
+            void* src = kmap(m->frames[idx]);
+            if(src != NULL) {
+                memcpy(dst, src, PG_SIZE);
+                kunmap(src);
+            } else {
+                ok = false;
+            }
+        }
+        dst += PG_SIZE;
+    }
+    if(m->pg_cnt != 0) {
+        memcpy(dst, m->data + m->head_len, m->len - m->head_len - m->pg_cnt * PG_SIZE);
+    }
+    return ok;
+}
+
+/* 按优先级发送消息，队列满时等待 timeout 毫秒，-1 表示一直等待，0 表示不等待，成功返回 0，失败返回 -1 */
+int32_t sys_mq_send(int32_t mqd, const struct mq_msg* msg, int32_t timeout) {
+    struct mqueue* mq = mq_get(mqd);
+    if(mq == NULL) {
+        return -1;
+    }
+    if(msg == NULL || msg->len > mq->msg_size || msg->prio >= MQ_PRIO_MAX) {
+        mq_put(mq);
+        return -1;
+    }
+    uint32_t start = ticks;
+    locker_lock(&mq->lock);
+    while(mq->cur_msgs == mq->max_msgs) {
+        if(!mq_wait(mq, &mq->not_full, timeout, start)) {
+            locker_unlock(&mq->lock);
+            mq_put(mq);
+            return -1;
+        }
+    }
+    /* 已确定有空位再构造，不会共享了页框又放弃 */
+    struct mq_message* m = mq_message_build(msg);
+    if(m == NULL) {
+        locker_unlock(&mq->lock);
+        mq_put(mq);
+        return -1;
+    }
+    /* 插到第一条优先级更低的消息之前 */
+    struct list_elem* elem = mq->msgs.head.next;
+    while(elem != &mq->msgs.tail && elem2entry(struct mq_message, tag, elem)->prio >= m->prio) {
+        elem = elem->next;
+    }
+    list_insert_before(elem, &m->tag);
+    mq->cur_msgs++;
+    cond_signal(&mq->not_empty);
+    locker_unlock(&mq->lock);
+    mq_put(mq);
+    return 0;
+}
+
+/* 接收优先级最高的消息中最早的一条，队列空时等待 timeout 毫秒，成功返回消息长度，失败返回 -1 */
+int32_t sys_mq_receive(int32_t mqd, struct mq_msg* msg, int32_t timeout) {
+    struct mqueue* mq = mq_get(mqd);
+    if(mq == NULL) {
+        return -1;
+    }
+    if(msg == NULL || msg->len < mq->msg_size) {
+        mq_put(mq);
+        return -1;
+    }
+    uint32_t start = ticks;
+    locker_lock(&mq->lock);
+    while(mq->cur_msgs == 0) {
+        if(!mq_wait(mq, &mq->not_empty, timeout, start)) {
+            locker_unlock(&mq->lock);
+            mq_put(mq);
+            return -1;
+        }
+    }
+    struct mq_message* m = elem2entry(struct mq_message, tag, list_pop(&mq->msgs));
+    mq->cur_msgs--;
+    cond_signal(&mq->not_full);
+    locker_unlock(&mq->lock);
+    mq_put(mq);
+
+    /* 交付在锁外进行，页表操作与复制不阻塞其他收发者 */
+    bool ok = mq_message_deliver(m, msg->buf);
+    msg->len = m->len;
+    msg->prio = m->prio;
+    int32_t len = ok ? (int32_t)m->len : -1;
+    mq_message_free(m);
+    return len;
+}
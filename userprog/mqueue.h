@@ -0,0 +1,49 @@
+#ifndef __USERPROG_MQUEUE_H
+#define __USERPROG_MQUEUE_H
+
+#include "stdint.h"
+#include "global.h"
+
+#define MQ_MAX          8   /* 系统中最多的消息队列数 */
+#define MQ_NAME_LEN     16  /* 队列名最大长度，含结尾的 0 */
+#define MQ_MSGS_MAX     64  /* 每个队列最多容纳的消息数 */
+#define MQ_MSG_SIZE_MAX (16 * PG_SIZE) /* 单条消息的最大字节数 */
+#define MQ_PRIO_MAX     32  /* 优先级 0 ~ MQ_PRIO_MAX - 1，数值大的先被接收 */
+
+/* 队列属性，mq_open 创建队列时使用，为 NULL 取默认值 */
+struct mq_attr {
+    uint32_t max_msgs; /* 最多容纳的消息数 */
+    uint32_t msg_size; /* 单条消息的最大字节数 */
+};
+
+/* 收发消息的描述，系统调用最多 3 个参数，缓冲区、长度和优先级放在一起传递 */
+struct mq_msg {
+    void* buf;
+    uint32_t len; /* 发送：消息长度；接收：传入缓冲区大小，返回消息长度 */
+    uint32_t prio; /* 发送：消息优先级；接收：返回消息优先级 */
+};
+
+/* 打开名为 name 的消息队列，不存在则按 attr 创建，成功返回队列描述符，失败返回 -1 */
+int32_t sys_mq_open(const char* name, const struct mq_attr* attr);
+
+/* 关闭队列描述符 mqd，最后一个使用者关闭后队列及其中的消息被销毁 */
+int32_t sys_mq_close(int32_t mqd);
+
+/* 
+ * 按优先级发送消息，队列满时等待 timeout 毫秒，-1 表示一直等待，0 表示不等待
+ * 一页及以上的消息中整页的部分与发送者写时复制共享页框，发送者的这些页变为只读，写入时才复制
+ * 成功返回 0，失败返回 -1
+ */
+int32_t sys_mq_send(int32_t mqd, const struct mq_msg* msg, int32_t timeout);
+
+/* 
+ * 接收优先级最高的消息中最早的一条，队列空时等待 timeout 毫秒，语义同 sys_mq_send
+ * 接收缓冲区与发送缓冲区页内偏移相同时整页部分写时复制地映射到接收缓冲区，否则复制
+ * 缓冲区须不小于队列的 msg_size，成功返回消息长度，失败返回 -1
+ */
+int32_t sys_mq_receive(int32_t mqd, struct mq_msg* msg, int32_t timeout);
+
+/* 初始化消息队列表 */
+void mqueue_init(void);
+
+#endif /* __USERPROG_MQUEUE_H */
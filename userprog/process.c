@@ -7,10 +7,10 @@
 #include "debug.h"
 #include "tss.h"
 #include "console.h"
+#include "smp.h"
+#include "vdso.h"
 
 extern void intr_exit(void);
-extern struct list __thread_ready_list; /* ready tasks queue */
-extern struct list __thread_all_list; /* all tasks queue */
 
 /* 构建用户进程初始上下文信息 */
 void process_start(void *filename_) {
@@ -50,15 +50,27 @@ void process_start(void *filename_) {
 
 /* 为进程重新加载页目录表，以激活进程页表 */
 void page_dir_activate(struct task_struct* pthread) {
-    /* 无论是线程还是进程都需要重新安装页表，防止线程使用进程的页表 */
-    /* 默认为内核页目录表（物理地址 0x100000） */
-    uint32_t phy_page_dir_addr = 0x100000;
-    if(pthread->pgdir != NULL) {
-        /* 进程自己的页目录表 */
-        phy_page_dir_addr = addr_v2p((uint32_t)pthread->pgdir);
+    /* 
+     * 内核线程只访问内核空间，而所有页目录表的内核部分（768~1023）相同，
+     * 故内核线程沿用上一个任务的页目录表（类似 linux 的 active_mm），不重新加载 
+     */
+    if(pthread->pgdir == NULL) {
+        return;
     }
-    /* 更新页目录寄存器 cr3 使新页表生效 */
+    /* 进程自己的页目录表 */
+    uint32_t phy_page_dir_addr = addr_v2p((uint32_t)pthread->pgdir);
+    struct cpu* pcpu = cpu_current();
+    if(pcpu->cr3 == phy_page_dir_addr && pthread->pgdir_cpu == pcpu) {
+        /* 切换回同一进程，或其间只运行了内核线程，且本任务上次就在本处理器上运行，TLB 仍然有效
+         * 单线程进程修改页表只刷新所在处理器的快表，在其他处理器上运行过后，本处理器的快表可能已过时；
+         * 多线程进程修改页表时通知所有处理器。
+         * 页目录由 page_dir_destroy 释放前各处理器都已换下它，相同的物理地址不会是被重用的另一个页目录 */
+        return;
+    }
+    /* 更新页目录寄存器 cr3 使新页表生效，内核映像为全局页，不会被刷出 */
     asm volatile("movl %0, %%cr3" : : "r" (phy_page_dir_addr) : "memory");
+    pcpu->cr3 = phy_page_dir_addr;
+    pthread->pgdir_cpu = pcpu;
 }
 
 /* 重新加载页目录项，激活页表，更新 tss 中的 esp0 为进程的特权级 0 的栈 */
@@ -72,7 +84,7 @@ void process_activate(struct task_struct* pthread) {
 }
 
 /* 创建页目录表，将当前页表的表示内核空间的 pde 赋值，成功则返回页目录的虚拟地址，否则返回NULL */
-uint32_t* page_dir_create(void) {
+uint32_t* page_dir_create(struct task_struct* pthread) {
     /* 用户进程页表不能让用户直接访问，需要在内核空间申请 */
     uint32_t* page_dir_vaddr = get_kernel_pages(1);  
     if (page_dir_vaddr == NULL) {
@@ -87,10 +99,69 @@ uint32_t* page_dir_create(void) {
     uint32_t new_phy_page_dir_addr = addr_v2p((uint32_t)page_dir_vaddr);
     /* 页目录项地址存在页目录的最后一项，更新为新的页目录物理地址 */
     page_dir_vaddr[1023] = new_phy_page_dir_addr | PG_US_U | PG_RW_W | PG_P_1;
-    
+
+    /* 3. 映射只读的 vdso 数据页 */
+    if(!vdso_map(page_dir_vaddr, pthread)) {
+        console_put_str("create_page_dir: vdso map failed !");
+        mfree_page(MPF_KERNEL, page_dir_vaddr, 1);
+        return NULL;
+    }
     return page_dir_vaddr;
 }
 
+/* 释放页目录表，进程已死亡且用户空间已释放；先让所有处理器换下该页目录，内核线程可能还沿用着它 */
+void page_dir_destroy(uint32_t* pgdir) {
+    smp_pgdir_release(addr_v2p((uint32_t)pgdir));
+    mfree_page(MPF_KERNEL, pgdir, 1);
+}
+
+/* 
+ * 在当前进程自己的地址空间中释放其用户空间：映射的页框、页表、vdso 页及虚拟地址位图，页目录由 page_dir_destroy 释放
+ * 私有页框可写，直接释放；只读的共享页框减少一个持有者
+ */
+void process_space_release(void) {
+    struct task_struct* leader = thread_running()->group_leader;
+    struct vaddr_mem_pool* vaddr_pool = &leader->userprog_vaddr_mem_pool;
+    uint32_t bit_idx;
+    for(bit_idx = 0; bit_idx < vaddr_pool->vaddr_bitmap.btmp_bytes_len * 8; bit_idx++) {
+        if(vaddr_pool->vaddr_bitmap.bits[bit_idx / 8] == 0) {
+            bit_idx += 7; /* 跳过整个空字节 */
+            continue;
+        }
+        if(!bitmap_scan_test(&vaddr_pool->vaddr_bitmap, bit_idx)) {
+            continue;
+        }
+        uint32_t vaddr = vaddr_pool->vaddr_start + bit_idx * PG_SIZE;
+        if(!(*pde_ptr(vaddr) & PG_P_1) || !(*pte_ptr(vaddr) & PG_P_1)) {
+            continue;
+        }
+        /* 本进程只有一个线程且即将死亡，只需刷新本处理器的快表 */
+        uint32_t* pte = pte_ptr(vaddr);
+        uint32_t pte_val = *pte;
+        *pte = 0;
+        asm volatile("invlpg %0" : : "m" (*(uint8_t*)vaddr) : "memory");
+        if(pte_val & PG_RW_W) {
+            pfree(pte_val & 0xfffff000);
+        } else {
+            page_frame_put(pte_val & 0xfffff000);
+        }
+    }
+    /* vdso 的页表由 vdso_unmap 释放 */
+    uint32_t pde_idx;
+    for(pde_idx = 0; pde_idx < 0x300; pde_idx++) {
+        uint32_t* pde = pde_ptr(pde_idx << 22);
+        if(pde_idx != (VDSO_DATA_VADDR >> 22) && (*pde & PG_P_1)) {
+            uint32_t pt_phy = *pde & 0xfffff000;
+            *pde = 0;
+            asm volatile("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax", "memory");
+            pfree(pt_phy);
+        }
+    }
+    vdso_unmap(leader);
+    mfree_page(MPF_KERNEL, vaddr_pool->vaddr_bitmap.bits, DIV_ROUND_UP(vaddr_pool->vaddr_bitmap.btmp_bytes_len, PG_SIZE));
+    vaddr_pool->vaddr_bitmap.bits = NULL;
+}
+
 /* 创建用户进程虚拟地址位图 */
 void user_vaddr_bitmap_create(struct task_struct* user_prog) {
     user_prog->userprog_vaddr_mem_pool.vaddr_start = USER_VADDR_START;
@@ -106,16 +177,8 @@ void process_execute(void* filename, char* name) {
     thread_attr_init(pthread, name, THREAD_PRIORITY_DEFAULT);
     user_vaddr_bitmap_create(pthread);
     thread_create(pthread, process_start, filename);
-    pthread->pgdir = page_dir_create();
+    pthread->pgdir = page_dir_create(pthread);
     bck_desc_init(pthread->u_bck_descs);
 
-    enum intr_status old_stat = intr_disable();
-
-    ASSERT(!elem_find(&__thread_ready_list, &pthread->general_tag));
-    list_push_back(&__thread_ready_list, &pthread->general_tag);
-
-    ASSERT(!elem_find(&__thread_all_list, &pthread->all_list_tag));
-    list_push_back(&__thread_all_list, &pthread->all_list_tag);
-
-    intr_status_set(old_stat);
+    thread_ready_new(pthread);
 }
@@ -19,8 +19,14 @@ void page_dir_activate(struct task_struct* pthread);
 /* 重新加载页目录项，激活页表，更新 tss 中的 esp0 为进程的特权级 0 的栈 */
 void process_activate(struct task_struct* pthread);
 
-/* 创建页目录表，将当前页表的表示内核空间的 pde 赋值，成功则返回页目录的虚拟地址，否则返回NULL */
-uint32_t* page_dir_create(void);
+/* 创建页目录表，将当前页表的表示内核空间的 pde 赋值，并映射 pthread 的 vdso 数据页，成功则返回页目录的虚拟地址，否则返回NULL */
+uint32_t* page_dir_create(struct task_struct* pthread);
+
+/* 释放页目录表，进程已死亡且用户空间已释放；先让所有处理器换下该页目录，内核线程可能还沿用着它 */
+void page_dir_destroy(uint32_t* pgdir);
+
+/* 在当前进程自己的地址空间中释放其用户空间，页目录由 page_dir_destroy 释放 */
+void process_space_release(void);
 
 /* 创建用户进程虚拟地址位图 */
 void user_vaddr_bitmap_create(struct task_struct* user_prog);
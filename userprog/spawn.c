@@ -0,0 +1,209 @@
+#include "spawn.h"
+#include "process.h"
+#include "userprog.h"
+#include "exec.h"
+#include "fork.h"
+#include "memory.h"
+#include "string.h"
+#include "sync.h"
+#include "debug.h"
+#include "fs.h"
+#include "file.h"
+
+extern void intr_exit(void);
+
+/* 父进程交给子进程的参数，位于内核页中，子进程加载完成后由父进程释放 */
+struct spawn_args {
+    sem_t done; /* 子进程加载完成或失败 */
+    int32_t ret;
+    struct spawn_file_actions actions;
+    char path[MAX_PATH_LEN];
+    uint32_t argc;
+    uint32_t argv_len; /* strs 中的字节数 */
+    char strs[SPAWN_ARGV_SIZE]; /* 依次存放各参数，以 0 分隔 */
+};
+
+/* 在子进程中执行文件描述符操作，失败返回 false */
+static bool spawn_actions_apply(const struct spawn_file_actions* actions) {
+    uint32_t idx;
+    for(idx = 0; idx < actions->cnt; idx++) {
+        const struct spawn_action* act = &actions->actions[idx];
+        if(act->op == SPAWN_DUP2) {
+            if(sys_dup2(act->fd, act->newfd) == -1) {
+                return false;
+            }
+        } else if(act->op == SPAWN_CLOSE) {
+            if(sys_close(act->fd) == -1) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 将参数复制到用户栈顶，返回用户空间的 argv，分配栈页失败返回 NULL */
+static char** spawn_argv_build(const struct spawn_args* args) {
+    void* stack_page = get_a_page(MPF_USER, USER_STACK3_VADDR);
+    if(stack_page == NULL) {
+        return NULL;
+    }
+    uint32_t stack_top = (uint32_t)stack_page + PG_SIZE;
+    char* strs = (char*)(stack_top - args->argv_len);
+    memcpy(strs, args->strs, args->argv_len);
+    char** argv = (char**)(((uint32_t)strs & ~3) - (args->argc + 1) * sizeof(char*));
+    uint32_t idx;
+    for(idx = 0; idx < args->argc; idx++) {
+        argv[idx] = strs;
+        strs += strlen(strs) + 1;
+    }
+    argv[args->argc] = NULL;
+    return argv;
+}
+
+/* 子进程的入口，在自己的地址空间中执行文件描述符操作并加载程序，与 execv 相同经 intr_exit 进入用户态 */
+static void spawn_start(void* arg) {
+    struct spawn_args* args = arg;
+    struct task_struct* cur_thread = thread_running();
+    kernel_lock();
+
+    int32_t entry_point = -1;
+    char** argv = NULL;
+    if(spawn_actions_apply(&args->actions)) {
+        entry_point = load(args->path);
+    }
+    if(entry_point != -1) {
+        argv = spawn_argv_build(args);
+    }
+    if(argv == NULL) {
+        /* 关闭继承来的文件并释放用户空间，随后死亡，页目录和 PCB 由父进程回收 */
+        int32_t lfd;
+        for(lfd = 0; lfd < MAX_FILES_OPEN_PER_PROC; lfd++) {
+            if(cur_thread->fd_table[lfd] > stderr_no) {
+                sys_close(lfd);
+            }
+        }
+        process_space_release();
+        args->ret = -1;
+        sem_post(&args->done);
+        intr_disable();
+        thread_block(TASK_DIED);
+        PANIC("spawn_start: dead thread was scheduled\n");
+    }
+
+    uint32_t argc = args->argc;
+    args->ret = 0;
+    sem_post(&args->done); /* 此后父进程会释放 args */
+
+    struct intr_stack* proc_stack = (struct intr_stack*)((uint32_t)cur_thread + PG_SIZE - sizeof(struct intr_stack));
+    memset(proc_stack, 0, sizeof(struct intr_stack));
+    proc_stack->ds = SELECTOR_U_DATA;
+    proc_stack->es = SELECTOR_U_DATA;
+    proc_stack->fs = SELECTOR_U_DATA;
+    proc_stack->ebx = (uint32_t)argv;
+    proc_stack->ecx = argc;
+    proc_stack->eip = (void*)entry_point;
+    proc_stack->cs = SELECTOR_U_CODE;
+    proc_stack->eflags = (EFLAGS_IOPL_0 | EFLAGS_MBS | EFLAGS_IF_1);
+    proc_stack->esp = (void*)argv;
+    proc_stack->ss = SELECTOR_U_DATA;
+
+    kernel_unlock();
+    asm volatile("movl %0, %%esp; jmp intr_exit" : : "g" (proc_stack) : "memory");
+}
+
+/* 复制路径、参数及文件描述符操作到 args，超出限制返回 false */
+static bool spawn_args_fill(struct spawn_args* args, const char* path, const char* argv[],
+                            const struct spawn_file_actions* actions) {
+    if(strlen(path) >= MAX_PATH_LEN) {
+        return false;
+    }
+    strcpy(args->path, path);
+    if(actions != NULL) {
+        if(actions->cnt > SPAWN_ACTIONS_MAX) {
+            return false;
+        }
+        memcpy(&args->actions, actions, sizeof(struct spawn_file_actions));
+    }
+    uint32_t len = 0;
+    for(args->argc = 0; argv != NULL && argv[args->argc] != NULL; args->argc++) {
+        uint32_t arg_len = strlen(argv[args->argc]) + 1;
+        if(args->argc == SPAWN_ARGV_MAX || len + arg_len > SPAWN_ARGV_SIZE) {
+            return false;
+        }
+        memcpy(args->strs + len, argv[args->argc], arg_len);
+        len += arg_len;
+    }
+    args->argv_len = len;
+    return true;
+}
+
+/* 
+ * 直接由 path 指向的程序创建新进程，不复制调用者的地址空间
+ * 新进程只有页目录、虚拟地址位图和继承的文件描述符表，程序在新进程中由 load 加载
+ * actions 可为 NULL，成功返回子进程 pid，失败返回 -1
+ */
+pid_t sys_spawn(const char* path, const char* argv[], const struct spawn_file_actions* actions) {
+    struct task_struct* leader = thread_running()->group_leader;
+    if(path == NULL || leader->pgdir == NULL) {
+        return -1;
+    }
+    /* 常见的失败在创建进程前发现 */
+    int32_t fd = sys_open(path, O_RDONLY);
+    if(fd == -1) {
+        return -1;
+    }
+    sys_close(fd);
+
+    ASSERT(sizeof(struct spawn_args) <= PG_SIZE);
+    struct spawn_args* args = get_kernel_pages(1);
+    if(args == NULL) {
+        return -1;
+    }
+    if(!spawn_args_fill(args, path, argv, actions)) {
+        mfree_page(MPF_KERNEL, args, 1);
+        return -1;
+    }
+    struct task_struct* child = get_kernel_pages(1);
+    if(child == NULL) {
+        mfree_page(MPF_KERNEL, args, 1);
+        return -1;
+    }
+    sem_init(&args->done, 0);
+
+    /* 进程名取路径的前缀，path 可能短于 TASK_NAME_LEN */
+    char name[TASK_NAME_LEN];
+    uint32_t name_len = 0;
+    while(name_len < TASK_NAME_LEN - 1 && args->path[name_len] != 0) {
+        name[name_len] = args->path[name_len];
+        name_len++;
+    }
+    name[name_len] = 0;
+    thread_attr_init(child, name, leader->base_priority);
+    child->ppid = leader->pid;
+    child->pgdir = page_dir_create(child);
+    if(child->pgdir == NULL) {
+        mfree_page(MPF_KERNEL, args, 1);
+        mfree_page(MPF_KERNEL, child, 1);
+        return -1;
+    }
+    user_vaddr_bitmap_create(child);
+    bck_desc_init(child->u_bck_descs);
+    child->cwd_inode_nr = leader->cwd_inode_nr;
+    memcpy(child->fd_table, leader->fd_table, sizeof(leader->fd_table));
+    inode_ref_update(child);
+    thread_create(child, spawn_start, args);
+    thread_ready_new(child);
+
+    sem_wait(&args->done);
+    int32_t ret = args->ret == 0 ? child->pid : -1;
+    mfree_page(MPF_KERNEL, args, 1);
+    if(ret == -1) {
+        /* 子进程已释放自己的用户空间 */
+        uint32_t* pgdir = child->pgdir;
+        thread_reap(child);
+        page_dir_destroy(pgdir);
+    }
+    return ret;
+}
@@ -0,0 +1,35 @@
+#ifndef __USERPROG_SPAWN_H
+#define __USERPROG_SPAWN_H
+
+#include "stdint.h"
+#include "thread.h"
+
+#define SPAWN_ACTIONS_MAX   8       /* 最多的文件描述符操作数 */
+#define SPAWN_ARGV_MAX      16      /* 最多的参数个数 */
+#define SPAWN_ARGV_SIZE     1024    /* 参数字符串的总长度上限，复制到新进程只有一页的用户栈上 */
+
+/* 新进程加载程序前对文件描述符的操作 */
+enum spawn_action_op {
+    SPAWN_DUP2, /* dup2(fd, newfd) */
+    SPAWN_CLOSE /* close(fd) */
+};
+
+struct spawn_action {
+    uint32_t op;
+    int32_t fd;
+    int32_t newfd;
+};
+
+/* 按顺序在新进程中执行，新进程开始时继承调用者全部打开的文件描述符 */
+struct spawn_file_actions {
+    uint32_t cnt;
+    struct spawn_action actions[SPAWN_ACTIONS_MAX];
+};
+
+/* 
+ * 直接由 path 指向的程序创建新进程，不复制调用者的地址空间
+ * actions 可为 NULL，成功返回子进程 pid，失败返回 -1
+ */
+pid_t sys_spawn(const char* path, const char* argv[], const struct spawn_file_actions* actions);
+
+#endif /* __USERPROG_SPAWN_H */
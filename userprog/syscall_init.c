@@ -8,15 +8,31 @@
 #include "fs.h"
 #include "fork.h"
 #include "exec.h"
+#include "sync.h"
+#include "futex.h"
+#include "uthread.h"
+#include "lockstat.h"
+#include "pipe.h"
+#include "poll.h"
+#include "mqueue.h"
+#include "sysstat.h"
+#include "spawn.h"
+#include "bcache.h"
 
-#define syscall_nr 32
 typedef void* syscall;
 
 syscall syscall_table[syscall_nr];
+const char* syscall_names[syscall_nr];
 
-/* get process pid */
+/* 登记系统调用，函数名即为系统调用名 */
+#define syscall_register(NR, FUNC) do {\
+    syscall_table[NR] = FUNC;\
+    syscall_names[NR] = #FUNC;\
+} while(0)
+
+/* get process pid，同一进程的线程返回相同的值，与 vdso 数据页一致 */
 uint32_t sys_getpid(void) {
-    return thread_running()->pid;
+    return thread_running()->group_leader->pid;
 }
 
 /* print single character */
@@ -25,31 +41,65 @@ int sys_putchar(int c) {
     return 0;
 }
 
+/* 系统调用分发，由 syscall_handler 调用，子功能在大内核锁保护下执行 */
+uint32_t syscall_dispatch(uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    kernel_lock();
+#ifdef SYSSTAT
+    uint64_t start = sysstat_clock();
+#endif
+    uint32_t ret = ((uint32_t (*)(uint32_t, uint32_t, uint32_t))syscall_table[nr])(arg1, arg2, arg3);
+#ifdef SYSSTAT
+    sysstat_record(nr, arg1, arg2, arg3, ret, start);
+#endif
+    kernel_unlock();
+    return ret;
+}
+
 /* init system call */
 void syscall_init(void) {
     put_str("syscall_init start\n");
-    syscall_table[SYS_GETPID] = sys_getpid;
-    syscall_table[SYS_MALLOC] = sys_malloc;
-    syscall_table[SYS_FREE] = sys_free;
-    syscall_table[SYS_WRITE] = sys_write;
-    syscall_table[SYS_READ] = sys_read;
-    syscall_table[SYS_PUTCHAR] = sys_putchar;
-    syscall_table[SYS_CLEAR] = cls_screen;
-    syscall_table[SYS_FORK] = sys_fork;
-    syscall_table[SYS_GETCWD] = sys_getcwd;
-    syscall_table[SYS_OPEN] = sys_open;
-    syscall_table[SYS_CLOSE] = sys_close;
-    syscall_table[SYS_LSEEK] = sys_lseek;
-    syscall_table[SYS_UNLINK] = sys_unlink;
-    syscall_table[SYS_MKDIR] = sys_mkdir;
-    syscall_table[SYS_OPENDIR] = sys_opendir;
-    syscall_table[SYS_CLOSEDIR] = sys_closedir;
-    syscall_table[SYS_CHDIR] = sys_chdir;
-    syscall_table[SYS_RMDIR] = sys_rmdir;
-    syscall_table[SYS_READDIR] = sys_readdir;
-    syscall_table[SYS_REWINDDIR] = sys_rewinddir;
-    syscall_table[SYS_STAT] = sys_stat;
-    syscall_table[SYS_PS] = sys_ps;
-    syscall_table[SYS_EXECV] = sys_execv;
+    syscall_register(SYS_GETPID, sys_getpid);
+    syscall_register(SYS_MALLOC, sys_malloc);
+    syscall_register(SYS_FREE, sys_free);
+    syscall_register(SYS_WRITE, sys_write);
+    syscall_register(SYS_READ, sys_read);
+    syscall_register(SYS_PUTCHAR, sys_putchar);
+    syscall_register(SYS_CLEAR, cls_screen);
+    syscall_register(SYS_FORK, sys_fork);
+    syscall_register(SYS_GETCWD, sys_getcwd);
+    syscall_register(SYS_OPEN, sys_open);
+    syscall_register(SYS_CLOSE, sys_close);
+    syscall_register(SYS_LSEEK, sys_lseek);
+    syscall_register(SYS_UNLINK, sys_unlink);
+    syscall_register(SYS_MKDIR, sys_mkdir);
+    syscall_register(SYS_OPENDIR, sys_opendir);
+    syscall_register(SYS_CLOSEDIR, sys_closedir);
+    syscall_register(SYS_CHDIR, sys_chdir);
+    syscall_register(SYS_RMDIR, sys_rmdir);
+    syscall_register(SYS_READDIR, sys_readdir);
+    syscall_register(SYS_REWINDDIR, sys_rewinddir);
+    syscall_register(SYS_STAT, sys_stat);
+    syscall_register(SYS_PS, sys_ps);
+    syscall_register(SYS_EXECV, sys_execv);
+    syscall_register(SYS_FUTEX, sys_futex);
+    syscall_register(SYS_THREAD_CREATE, sys_thread_create);
+    syscall_register(SYS_THREAD_JOIN, sys_thread_join);
+    syscall_register(SYS_THREAD_EXIT, sys_thread_exit);
+    syscall_register(SYS_LOCKSTAT, sys_lockstat);
+    syscall_register(SYS_PIPE, sys_pipe);
+    syscall_register(SYS_DUP2, sys_dup2);
+    syscall_register(SYS_POLL, sys_poll);
+    syscall_register(SYS_MQ_OPEN, sys_mq_open);
+    syscall_register(SYS_MQ_CLOSE, sys_mq_close);
+    syscall_register(SYS_MQ_SEND, sys_mq_send);
+    syscall_register(SYS_MQ_RECEIVE, sys_mq_receive);
+    syscall_register(SYS_URING_SETUP, sys_uring_setup);
+    syscall_register(SYS_URING_ENTER, sys_uring_enter);
+    syscall_register(SYS_SYSSTAT, sys_sysstat);
+    syscall_register(SYS_STRACE, sys_strace);
+    syscall_register(SYS_SPAWN, sys_spawn);
+    syscall_register(SYS_SYNC, sys_sync);
+    syscall_register(SYS_FSYNC, sys_fsync);
+    sysstat_init();
     put_str("syscall_init done\n");
 }
\ No newline at end of file
@@ -4,12 +4,20 @@
 #include "stdint.h"
 #include "file.h"
 
+#define syscall_nr 64 /* 系统调用表的容量 */
+
+/* 系统调用名，统计及跟踪输出使用 */
+extern const char* syscall_names[syscall_nr];
+
 /* get process pid */
 uint32_t sys_getpid(void);
 
 /* print single character */
 int sys_putchar(int c);
 
+/* 系统调用分发，由 syscall_handler 调用，子功能在大内核锁保护下执行 */
+uint32_t syscall_dispatch(uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
 /* init system call */
 void syscall_init(void);
 
@@ -0,0 +1,218 @@
+#include "sysstat.h"
+#include "memory.h"
+#include "stdio.h"
+#include "string.h"
+#include "fs.h"
+#include "file.h"
+
+#define CPUID_EDX_TSC       (1 << 4)
+#define SYSSTAT_LINE_MAX    (16 + 10 + 3 * 21 + 1) /* 一行的长度 */
+#define STRACE_LINE_MAX     (8 + 16 + 3 * 12 + 12 + 21 + 1)
+#define STRACE_BUF_PAGES    (DIV_ROUND_UP(STRACE_ENTRIES * STRACE_LINE_MAX, PG_SIZE) + 1)
+
+/* 一条跟踪记录 */
+struct strace_rec {
+    pid_t pid;
+    uint16_t nr;
+    uint32_t args[3];
+    uint32_t ret;
+    uint64_t cycles;
+};
+
+static bool tsc_enabled = false;
+static struct syscall_stat global_stat;
+
+/* 以下由大内核锁保护 */
+static pid_t strace_pid = 0; /* 0 表示不跟踪 */
+static struct strace_rec strace_buf[STRACE_ENTRIES];
+static uint32_t strace_head = 0, strace_tail = 0; /* 一直递增，对容量取模得到位置 */
+
+/* 检测 TSC */
+void sysstat_init(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    tsc_enabled = (edx & CPUID_EDX_TSC) != 0;
+}
+
+/* 当前的 TSC，不支持时为 0 */
+uint64_t sysstat_clock(void) {
+    uint64_t tsc = 0;
+    if(tsc_enabled) {
+        asm volatile("rdtsc" : "=A" (tsc));
+    }
+    return tsc;
+}
+
+/* 进程的统计，首次使用时分配，失败返回 NULL */
+static struct syscall_stat* proc_stat_get(struct task_struct* leader) {
+    if(leader->sc_stat == NULL) {
+        leader->sc_stat = get_kernel_pages(DIV_ROUND_UP(sizeof(struct syscall_stat), PG_SIZE));
+    }
+    return leader->sc_stat;
+}
+
+static void stat_entry_add(struct syscall_stat_entry* entry, uint64_t cycles) {
+    entry->calls++;
+    entry->cycles += cycles;
+    if(cycles > entry->max) {
+        entry->max = cycles;
+    }
+}
+
+/* 系统调用 nr 返回时记录统计，被跟踪的进程同时写入跟踪记录，调用者持有大内核锁 */
+void sysstat_record(uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t ret, uint64_t start) {
+    if(nr >= syscall_nr) {
+        return;
+    }
+    uint64_t cycles = sysstat_clock() - start;
+    struct task_struct* cur_thread = thread_running();
+    struct task_struct* leader = cur_thread->group_leader;
+
+    stat_entry_add(&global_stat.entries[nr], cycles);
+    struct syscall_stat* pstat = proc_stat_get(leader);
+    if(pstat != NULL) {
+        stat_entry_add(&pstat->entries[nr], cycles);
+    }
+
+    if(strace_pid != 0 && (strace_pid == leader->pid || strace_pid == cur_thread->pid)) {
+        if(strace_tail - strace_head == STRACE_ENTRIES) {
+            strace_head++; /* 覆盖最早的记录 */
+        }
+        struct strace_rec* rec = &strace_buf[strace_tail++ % STRACE_ENTRIES];
+        rec->pid = cur_thread->pid;
+        rec->nr = nr;
+        rec->args[0] = arg1;
+        rec->args[1] = arg2;
+        rec->args[2] = arg3;
+        rec->ret = ret;
+        rec->cycles = cycles;
+    }
+}
+
+/* 64 位数除以 32 位数，余数存入 *rem，不依赖 libgcc */
+static uint64_t u64_div(uint64_t n, uint32_t d, uint32_t* rem) {
+    uint32_t hi = (uint32_t)(n >> 32), lo = (uint32_t)n;
+    uint32_t q_hi = hi / d, r = hi % d, q_lo;
+    /* r < d，商不会超过 32 位 */
+    asm("divl %4" : "=a" (q_lo), "=d" (r) : "a" (lo), "d" (r), "r" (d));
+    if(rem != NULL) {
+        *rem = r;
+    }
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+/* 64 位数转换为十进制字符串 */
+static void u64_to_str(char* dst, uint64_t n) {
+    char tmp[21];
+    uint32_t len = 0, digit;
+    do {
+        n = u64_div(n, 10, &digit);
+        tmp[len++] = '0' + digit;
+    } while(n != 0);
+    while(len > 0) {
+        *dst++ = tmp[--len];
+    }
+    *dst = 0;
+}
+
+/* 将 str 左对齐写入 dst 的 width 个字符宽的栏，返回写入的字符数 */
+static uint32_t sysstat_field(char* dst, const char* str, uint32_t width) {
+    uint32_t len = strlen(str);
+    if(len >= width) {
+        len = width - 1; /* 至少保留一个空格分隔 */
+    }
+    memcpy(dst, str, len);
+    memset(dst + len, ' ', width - len);
+    return width;
+}
+
+/* 输出统计信息的一行 */
+static uint32_t sysstat_line(char* dst, uint32_t nr, struct syscall_stat_entry* entry) {
+    char num[21];
+    uint32_t len = sysstat_field(dst, syscall_names[nr], 16);
+    sprintf(num, "%d", entry->calls);
+    len += sysstat_field(dst + len, num, 10);
+    u64_to_str(num, entry->cycles);
+    len += sysstat_field(dst + len, num, 21);
+    u64_to_str(num, u64_div(entry->cycles, entry->calls, NULL));
+    len += sysstat_field(dst + len, num, 21);
+    u64_to_str(num, entry->max);
+    len += sysstat_field(dst + len, num, 21);
+    dst[len++] = '\n';
+    return len;
+}
+
+/* 输出进程 pid（0 为全局）的系统调用统计，clear 非 0 时随后清零 */
+void sys_sysstat(pid_t pid, uint32_t clear) {
+    struct syscall_stat* pstat = &global_stat;
+    if(pid != 0) {
+        struct task_struct* pthread = pid2thread(pid);
+        if(pthread == NULL || pthread->group_leader->sc_stat == NULL) {
+            return;
+        }
+        pstat = pthread->group_leader->sc_stat;
+    }
+    uint32_t buf_pages = DIV_ROUND_UP(SYSSTAT_LINE_MAX * (syscall_nr + 1), PG_SIZE);
+    char* buf = get_kernel_pages(buf_pages);
+    if(buf == NULL) {
+        return;
+    }
+    uint32_t len = sysstat_field(buf, "NAME", 16);
+    len += sysstat_field(buf + len, "CALLS", 10);
+    len += sysstat_field(buf + len, "CYCLES", 21);
+    len += sysstat_field(buf + len, "AVG", 21);
+    len += sysstat_field(buf + len, "MAX", 21);
+    buf[len++] = '\n';
+
+    uint32_t nr;
+    for(nr = 0; nr < syscall_nr; nr++) {
+        if(pstat->entries[nr].calls != 0 && syscall_names[nr] != NULL) {
+            len += sysstat_line(buf + len, nr, &pstat->entries[nr]);
+        }
+    }
+    if(clear) {
+        memset(pstat, 0, sizeof(struct syscall_stat));
+    }
+    sys_write(stdout_no, buf, len);
+    mfree_page(MPF_KERNEL, buf, buf_pages);
+}
+
+/* 输出跟踪缓冲中的记录：pid name(arg1, arg2, arg3) = ret cycles */
+static void strace_dump(void) {
+    char* buf = get_kernel_pages(STRACE_BUF_PAGES);
+    if(buf == NULL) {
+        return;
+    }
+    uint32_t len = 0;
+    char cycles[21];
+    while(strace_head != strace_tail) {
+        struct strace_rec* rec = &strace_buf[strace_head++ % STRACE_ENTRIES];
+        const char* name = syscall_names[rec->nr] == NULL ? "?" : syscall_names[rec->nr];
+        u64_to_str(cycles, rec->cycles);
+        len += sprintf(buf + len, "%d %s(0x%x, 0x%x, 0x%x) = %d %s\n",
+                        rec->pid, name, rec->args[0], rec->args[1], rec->args[2], rec->ret, cycles);
+    }
+    sys_write(stdout_no, buf, len);
+    mfree_page(MPF_KERNEL, buf, STRACE_BUF_PAGES);
+}
+
+/* 跟踪进程 pid 的系统调用，op 见 enum strace_op，成功返回 0，失败返回 -1 */
+int32_t sys_strace(uint32_t op, pid_t pid) {
+    switch(op) {
+        case STRACE_OFF:
+            strace_pid = 0;
+            return 0;
+        case STRACE_ON:
+            if(pid <= 0 || pid2thread(pid) == NULL) {
+                return -1;
+            }
+            strace_head = strace_tail = 0;
+            strace_pid = pid;
+            return 0;
+        case STRACE_DUMP:
+            strace_dump();
+            return 0;
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef __USERPROG_SYSSTAT_H
+#define __USERPROG_SYSSTAT_H
+
+#include "global.h"
+#include "thread.h"
+#include "syscall_init.h"
+
+/* 系统调用统计，去掉此定义即可去除全部统计开销 */
+#define SYSSTAT
+
+#define STRACE_ENTRIES 256 /* 跟踪记录环形缓冲的容量，满后覆盖最早的记录 */
+
+/* sys_strace 的操作 */
+enum strace_op {
+    STRACE_OFF,  /* 停止跟踪 */
+    STRACE_ON,   /* 跟踪进程 pid，清空缓冲 */
+    STRACE_DUMP  /* 输出并清空缓冲中的记录 */
+};
+
+/* 一个系统调用的统计，时间以 TSC 周期为单位，处理器不支持 TSC 时只计次数 */
+struct syscall_stat_entry {
+    uint32_t calls;
+    uint64_t cycles; /* 累计耗时，含阻塞的时间 */
+    uint64_t max; /* 单次最长耗时 */
+};
+
+/* 全局及每个进程各一份 */
+struct syscall_stat {
+    struct syscall_stat_entry entries[syscall_nr];
+};
+
+/* 检测 TSC */
+void sysstat_init(void);
+
+/* 当前的 TSC，不支持时为 0 */
+uint64_t sysstat_clock(void);
+
+/* 系统调用 nr 返回时记录统计，被跟踪的进程同时写入跟踪记录，调用者持有大内核锁 */
+void sysstat_record(uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t ret, uint64_t start);
+
+/* 输出进程 pid（0 为全局）的系统调用统计，clear 非 0 时随后清零 */
+void sys_sysstat(pid_t pid, uint32_t clear);
+
+/* 跟踪进程 pid 的系统调用，op 见 enum strace_op，成功返回 0，失败返回 -1 */
+int32_t sys_strace(uint32_t op, pid_t pid);
+
+#endif /* __USERPROG_SYSSTAT_H */
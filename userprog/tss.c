@@ -1,8 +1,23 @@
 #include "tss.h"
 #include "print.h"
+#include "smp.h"
 
 /* GDT base is 0xc0000900 */
 #define TSS_ADDR_BASE (GDT_ADDR_BASE + 4 * GDT_DESC_SIZE)
+/* AP 的 TSS 描述符放在用户代码段、数据段之后，第 7 + id 个 */
+#define TSS_AP_DESC_IDX(id) (7 + (id))
+#if SYSENTER_DESC_IDX != TSS_AP_DESC_IDX(NR_CPUS)
+#error "sysenter descriptors must follow AP's TSS"
+#endif
+/* 最后 4 个为 sysenter/sysexit 使用的段描述符 */
+#define GDT_DESC_CNT (SYSENTER_DESC_IDX + 4)
+
+#define CPUID_EDX_SEP       (1 << 11) /* 支持 sysenter/sysexit */
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+
+extern void sysenter_entry(void); /* kernel.S */
 
 /* tss struct */
 typedef struct {
@@ -34,11 +49,11 @@ typedef struct {
     uint32_t trace;
     uint32_t io_base;
 }tss_t;
-static tss_t tss;
+static tss_t tss[NR_CPUS]; /* 每个处理器一个 tss */
 
 /* update esp0 of tss to pthread's stack(level 0) */
 void tss_update_esp(struct task_struct* pthread) {
-    tss.esp0 = (uint32_t*)((uint32_t)pthread + PG_SIZE);
+    tss[cpu_current()->id].esp0 = (uint32_t*)((uint32_t)pthread + PG_SIZE);
 }
 
 /* create GDT Descriptor */
@@ -56,25 +71,74 @@ static gdt_desc_t gdt_desc_make(uint32_t* desc_addr, uint32_t limit, uint8_t att
     return desc;
 }
 
+static void wrmsr(uint32_t msr, uint32_t val) {
+    asm volatile("wrmsr" : : "c" (msr), "a" (val), "d" (0));
+}
+
+/* 当前处理器是否支持 sysenter，早期 Pentium Pro (family 6, model < 3, stepping < 3) 的 SEP 位不可信 */
+static bool sysenter_supported(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    if(!(edx & CPUID_EDX_SEP)) {
+        return false;
+    }
+    uint32_t family = (eax >> 8) & 0xf, model = (eax >> 4) & 0xf, stepping = eax & 0xf;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* 设置当前处理器 sysenter 的入口：SYSENTER_ESP 指向本处理器 tss 的 esp0，
+ * 入口处由此取出当前任务的 0 级栈，切换任务时无需再写 msr */
+static void sysenter_init(uint8_t cpu_id) {
+    if(!sysenter_supported()) {
+        return;
+    }
+    wrmsr(MSR_SYSENTER_CS, SELECTOR_SYSENTER_CS);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)&tss[cpu_id].esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+}
+
 /* create tss in GDT & reload gdt */
 void tss_init(void) {
     put_str("tss_init start\n");
-    uint32_t tss_size = sizeof(tss);
-    memset(&tss, 0, tss_size);
-    tss.ss0 = SELECTOR_K_STACK; /* level 0 stack */
-    tss.io_base = tss_size; /* no io bitmap */
+    uint32_t tss_size = sizeof(tss_t);
+    memset(tss, 0, sizeof(tss));
+    int cpu_idx;
+    for(cpu_idx = 0; cpu_idx < NR_CPUS; cpu_idx++) {
+        tss[cpu_idx].ss0 = SELECTOR_K_STACK; /* level 0 stack */
+        tss[cpu_idx].io_base = tss_size; /* no io bitmap */
+    }
     
     /* GDT base address is 0x900. tss is the 4.(0x900 + 0x20) */
     /* dpl0's TSS */
-    *((gdt_desc_t *)TSS_ADDR_BASE) = gdt_desc_make((uint32_t*)&tss, tss_size - 1, TSS_ATTR_LOW, TSS_ATTR_HIGH);
+    *((gdt_desc_t *)TSS_ADDR_BASE) = gdt_desc_make((uint32_t*)&tss[0], tss_size - 1, TSS_ATTR_LOW, TSS_ATTR_HIGH);
     /* dpl3's user data & code segment */
     *((gdt_desc_t *)(TSS_ADDR_BASE + GDT_DESC_SIZE)) = gdt_desc_make((uint32_t*)0, 0xfffff, GDT_CODE_ATTR_LOW_DPL3, GDT_ATTR_HIGH);
     *((gdt_desc_t *)(TSS_ADDR_BASE + 2 * GDT_DESC_SIZE))  = gdt_desc_make((uint32_t*)0, 0xfffff, GDT_DATA_ATTR_LOW_DPL3, GDT_ATTR_HIGH);
+    /* AP's TSS */
+    for(cpu_idx = 1; cpu_idx < NR_CPUS; cpu_idx++) {
+        *((gdt_desc_t *)(GDT_ADDR_BASE + TSS_AP_DESC_IDX(cpu_idx) * GDT_DESC_SIZE)) = 
+            gdt_desc_make((uint32_t*)&tss[cpu_idx], tss_size - 1, TSS_ATTR_LOW, TSS_ATTR_HIGH);
+    }
+    /* sysenter/sysexit : kernel code, kernel stack, user code, user stack */
+    gdt_desc_t* sysenter_desc = (gdt_desc_t*)(GDT_ADDR_BASE + SYSENTER_DESC_IDX * GDT_DESC_SIZE);
+    sysenter_desc[0] = gdt_desc_make((uint32_t*)0, 0xfffff, GDT_CODE_ATTR_LOW_DPL0, GDT_ATTR_HIGH);
+    sysenter_desc[1] = gdt_desc_make((uint32_t*)0, 0xfffff, GDT_DATA_ATTR_LOW_DPL0, GDT_ATTR_HIGH);
+    sysenter_desc[2] = gdt_desc_make((uint32_t*)0, 0xfffff, GDT_CODE_ATTR_LOW_DPL3, GDT_ATTR_HIGH);
+    sysenter_desc[3] = gdt_desc_make((uint32_t*)0, 0xfffff, GDT_DATA_ATTR_LOW_DPL3, GDT_ATTR_HIGH);
     
     /* gdt [16 bit's limit][32 bit's segment address] */
-    uint64_t gdt_operand = ((GDT_DESC_SIZE * 7 - 1) | ((uint64_t)(uint32_t)GDT_ADDR_BASE << 16));
+    uint64_t gdt_operand = ((GDT_DESC_SIZE * GDT_DESC_CNT - 1) | ((uint64_t)(uint32_t)GDT_ADDR_BASE << 16));
     /* reload gdt */
     asm volatile("lgdt %0": : "m" (gdt_operand));
     asm volatile("ltr %w0": : "r" (SELECTOR_TSS));
+    sysenter_init(0);
     put_str("tss_init end\n");
+}
+
+/* AP 加载内核 gdt 及自己的 tss */
+void tss_ap_init(uint8_t cpu_id) {
+    uint64_t gdt_operand = ((GDT_DESC_SIZE * GDT_DESC_CNT - 1) | ((uint64_t)(uint32_t)GDT_ADDR_BASE << 16));
+    asm volatile("lgdt %0": : "m" (gdt_operand));
+    asm volatile("ltr %w0": : "r" ((uint16_t)(TSS_AP_DESC_IDX(cpu_id) << 3)));
+    sysenter_init(cpu_id);
 }
\ No newline at end of file
@@ -11,4 +11,7 @@ void tss_update_esp(struct task_struct* pthread);
 /* create tss in GDT & reload gdt */
 void tss_init(void);
 
+/* AP 加载内核 gdt 及自己的 tss */
+void tss_ap_init(uint8_t cpu_id);
+
 #endif /* __USERPROG_TSS_H */
\ No newline at end of file
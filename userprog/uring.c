@@ -0,0 +1,192 @@
+#include "uring.h"
+#include "memory.h"
+#include "thread.h"
+#include "sync.h"
+#include "string.h"
+#include "debug.h"
+#include "timer.h"
+#include "fs.h"
+
+extern uint32_t ticks;
+
+/* 一个进程的 ring */
+struct uring_ctx {
+    bool used;
+    struct task_struct* owner; /* 所属进程的主线程 */
+    struct uring* ring; /* 用户空间地址，内核线程与进程共用页表，直接访问 */
+    struct task_struct* worker;
+    locker_t lock; /* 保护 ring 的下标 */
+    cond_t sq_ready; /* 有新的提交项 */
+    cond_t cq_ready; /* 有新的完成项 */
+    cond_t cq_space; /* 用户取走了完成项 */
+};
+
+static struct uring_ctx uring_table[URING_MAX];
+static locker_t uring_table_lock; /* 保护 ring 的创建 */
+
+/* 初始化 ring 表 */
+void uring_init(void) {
+    memset(uring_table, 0, sizeof(uring_table));
+    locker_init(&uring_table_lock, NULL);
+}
+
+/* ring 描述符对应的 ring，只有创建它的进程可以使用，无效返回 NULL */
+static struct uring_ctx* rd2ctx(int32_t rd) {
+    if(rd < 0 || rd >= URING_MAX || !uring_table[rd].used ||
+        uring_table[rd].owner != thread_running()->group_leader) {
+        return NULL;
+    }
+    return &uring_table[rd];
+}
+
+/* 执行一个提交项，返回对应系统调用的返回值 */
+static int32_t uring_op_exec(const struct uring_sqe* sqe) {
+    switch(sqe->opcode) {
+        case URING_OP_NOP:
+            return 0;
+        case URING_OP_READ:
+            return sys_read(sqe->fd, sqe->addr, sqe->len);
+        case URING_OP_WRITE:
+            return sys_write(sqe->fd, sqe->addr, sqe->len);
+        case URING_OP_LSEEK:
+            return sys_lseek(sqe->fd, sqe->off, (uint8_t)sqe->len);
+        case URING_OP_OPEN:
+            return sys_open(sqe->addr, (uint8_t)sqe->len);
+        case URING_OP_CLOSE:
+            return sys_close(sqe->fd);
+        case URING_OP_STAT:
+            return sys_stat(sqe->addr, sqe->addr2);
+        default:
+            return -1;
+    }
+}
+
+/* 
+ * 内核线程：按顺序执行提交项并写入完成项
+ * 与系统调用相同在大内核锁下执行，等待磁盘时由调度器释放，进程可继续运行
+ */
+static void uring_worker(void* arg) {
+    struct uring_ctx* ctx = arg;
+    struct uring* ring = ctx->ring;
+    kernel_lock();
+    while(1) {
+        locker_lock(&ctx->lock);
+        while(ring->sq_head == ring->sq_tail) {
+            cond_wait(&ctx->sq_ready, &ctx->lock);
+        }
+        if(ring->sq_tail - ring->sq_head > URING_SQ_ENTRIES) {
+            /* sq_tail 被写坏，丢弃全部提交项 */
+            ring->sq_head = ring->sq_tail;
+            locker_unlock(&ctx->lock);
+            continue;
+        }
+        /* 先复制出来，提交项所在位置随后可被用户重新使用 */
+        struct uring_sqe sqe = ring->sqes[ring->sq_head % URING_SQ_ENTRIES];
+        ring->sq_head++;
+        locker_unlock(&ctx->lock);
+
+        int32_t res = uring_op_exec(&sqe);
+
+        locker_lock(&ctx->lock);
+        while(ring->cq_tail - ring->cq_head >= URING_CQ_ENTRIES) {
+            cond_wait(&ctx->cq_space, &ctx->lock);
+        }
+        struct uring_cqe* cqe = &ring->cqes[ring->cq_tail % URING_CQ_ENTRIES];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        ring->cq_tail++;
+        cond_broadcast(&ctx->cq_ready);
+        locker_unlock(&ctx->lock);
+    }
+}
+
+/* 为当前进程创建 ring 及执行提交项的内核线程，ring 的用户空间地址存入 *ring，成功返回 ring 描述符，失败返回 -1 */
+int32_t sys_uring_setup(struct uring** ring) {
+    struct task_struct* leader = thread_running()->group_leader;
+    if(ring == NULL || leader->pgdir == NULL) {
+        return -1;
+    }
+
+    locker_lock(&uring_table_lock);
+    int32_t rd;
+    for(rd = 0; rd < URING_MAX && uring_table[rd].used; rd++);
+    if(rd == URING_MAX) {
+        locker_unlock(&uring_table_lock);
+        return -1;
+    }
+    struct uring_ctx* ctx = &uring_table[rd];
+    ctx->ring = get_user_pages(URING_PAGES);
+    if(ctx->ring == NULL) {
+        locker_unlock(&uring_table_lock);
+        return -1;
+    }
+    struct task_struct* worker = get_kernel_pages(1);
+    if(worker == NULL) {
+        mfree_page(MPF_USER, ctx->ring, URING_PAGES);
+        locker_unlock(&uring_table_lock);
+        return -1;
+    }
+    ctx->owner = leader;
+    locker_init(&ctx->lock, NULL);
+    cond_init(&ctx->sq_ready);
+    cond_init(&ctx->cq_ready);
+    cond_init(&ctx->cq_space);
+    ctx->used = true;
+    locker_unlock(&uring_table_lock);
+
+    /* 运行在内核态，但共用进程的页表、文件描述符表和堆，像线程一样执行提交项 */
+    thread_attr_init(worker, "uring", leader->base_priority);
+    thread_create(worker, uring_worker, ctx);
+    worker->pgdir = leader->pgdir;
+    worker->group_leader = leader;
+    worker->ppid = leader->pid;
+    /* 与用户线程一样计入进程的线程数：worker 可能在其他处理器上使用同一页表，
+     * 解除或修改用户空间映射时须通知其他处理器刷新 TLB。ring 与进程同生命周期，不会被撤销 */
+    leader->nr_threads++;
+    ctx->worker = worker;
+    thread_ready_new(worker);
+
+    *ring = ctx->ring;
+    return rd;
+}
+
+/* 
+ * 通知内核线程处理新的提交项，并等待至少 min_complete 个完成项，最多等待 timeout 毫秒，-1 表示一直等待
+ * 返回可取的完成项数，失败返回 -1
+ */
+int32_t sys_uring_enter(int32_t rd, uint32_t min_complete, int32_t timeout) {
+    struct uring_ctx* ctx = rd2ctx(rd);
+    if(ctx == NULL) {
+        return -1;
+    }
+    struct uring* ring = ctx->ring;
+    if(min_complete > URING_CQ_ENTRIES) {
+        min_complete = URING_CQ_ENTRIES;
+    }
+
+    uint32_t start = ticks;
+    locker_lock(&ctx->lock);
+    if(ring->sq_tail - ring->sq_head > URING_SQ_ENTRIES) {
+        locker_unlock(&ctx->lock);
+        return -1;
+    }
+    if(ring->sq_head != ring->sq_tail) {
+        cond_signal(&ctx->sq_ready);
+    }
+    /* 调用前用户可能已取走完成项 */
+    cond_signal(&ctx->cq_space);
+    while(ring->cq_tail - ring->cq_head < min_complete && timeout != 0) {
+        if(timeout < 0) {
+            cond_wait(&ctx->cq_ready, &ctx->lock);
+            continue;
+        }
+        uint32_t elapsed = ticks_to_mtime(ticks - start);
+        if(elapsed >= (uint32_t)timeout) {
+            break;
+        }
+        cond_timedwait(&ctx->cq_ready, &ctx->lock, (uint32_t)timeout - elapsed);
+    }
+    int32_t ret = ring->cq_tail - ring->cq_head;
+    locker_unlock(&ctx->lock);
+    return ret;
+}
@@ -0,0 +1,67 @@
+#ifndef __USERPROG_URING_H
+#define __USERPROG_URING_H
+
+#include "stdint.h"
+#include "global.h"
+
+#define URING_MAX           8   /* 系统中最多的 ring 数 */
+#define URING_SQ_ENTRIES    64  /* 提交队列长度 */
+#define URING_CQ_ENTRIES    128 /* 完成队列长度，为提交队列的两倍，减少内核等待用户取走完成项 */
+
+/* 提交项支持的操作，与同名系统调用的语义相同 */
+enum uring_op {
+    URING_OP_NOP,
+    URING_OP_READ,  /* sys_read(fd, addr, len) */
+    URING_OP_WRITE, /* sys_write(fd, addr, len) */
+    URING_OP_LSEEK, /* sys_lseek(fd, off, len) */
+    URING_OP_OPEN,  /* sys_open(addr, len) */
+    URING_OP_CLOSE, /* sys_close(fd) */
+    URING_OP_STAT   /* sys_stat(addr, addr2) */
+};
+
+/* 提交队列项 */
+struct uring_sqe {
+    uint8_t opcode;
+    int32_t fd;
+    void* addr; /* 缓冲区或路径 */
+    void* addr2;
+    uint32_t len; /* 字节数或标志 */
+    int32_t off;
+    uint32_t user_data; /* 原样带回完成项 */
+};
+
+/* 完成队列项 */
+struct uring_cqe {
+    uint32_t user_data;
+    int32_t res; /* 对应系统调用的返回值 */
+};
+
+/* 
+ * 映射在进程用户空间的共享 ring
+ * 提交队列由用户推进 sq_tail、内核推进 sq_head，完成队列由内核推进 cq_tail、用户推进 cq_head
+ * 下标一直递增，对队列长度取模得到位置
+ */
+struct uring {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    struct uring_sqe sqes[URING_SQ_ENTRIES];
+    struct uring_cqe cqes[URING_CQ_ENTRIES];
+};
+
+#define URING_PAGES DIV_ROUND_UP(sizeof(struct uring), PG_SIZE)
+
+/* 初始化 ring 表 */
+void uring_init(void);
+
+/* 为当前进程创建 ring 及执行提交项的内核线程，ring 的用户空间地址存入 *ring，成功返回 ring 描述符，失败返回 -1 */
+int32_t sys_uring_setup(struct uring** ring);
+
+/* 
+ * 通知内核线程处理新的提交项，并等待至少 min_complete 个完成项，最多等待 timeout 毫秒，-1 表示一直等待
+ * 返回可取的完成项数，失败返回 -1
+ */
+int32_t sys_uring_enter(int32_t rd, uint32_t min_complete, int32_t timeout);
+
+#endif /* __USERPROG_URING_H */
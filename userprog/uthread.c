@@ -0,0 +1,118 @@
+#include "uthread.h"
+#include "memory.h"
+#include "interrupt.h"
+#include "debug.h"
+#include "sync.h"
+#include "global.h"
+
+extern void intr_exit(void); /* 中断返回地址 */
+
+/* 保护所有线程的 exited 与 joiner */
+static spinlock_t uthread_lock = { 0 };
+
+/* 构建新线程的中断栈及 thread_stack，首次被调度时经 intr_exit 进入用户态的 entry */
+static void uthread_stk_build(struct task_struct* pthread, void* entry, uint32_t* ustack_top) {
+    struct intr_stack* intr_stk0 = (struct intr_stack*)((uint32_t)pthread + PG_SIZE - sizeof(struct intr_stack));
+    memset(intr_stk0, 0, sizeof(struct intr_stack));
+    intr_stk0->ds = SELECTOR_U_DATA;
+    intr_stk0->es = SELECTOR_U_DATA;
+    intr_stk0->fs = SELECTOR_U_DATA;
+    intr_stk0->eip = entry;
+    intr_stk0->cs = SELECTOR_U_CODE;
+    intr_stk0->eflags = (EFLAGS_IOPL_0 | EFLAGS_MBS | EFLAGS_IF_1);
+    intr_stk0->esp = ustack_top;
+    intr_stk0->ss = SELECTOR_U_DATA;
+
+    /* 与 fork 的子进程相同，switch_to 返回到 intr_exit */
+    struct thread_stack* thread_stk = (struct thread_stack*)((uint32_t)intr_stk0 - 5 * 4);
+    thread_stk->ebp = thread_stk->ebx = thread_stk->edi = thread_stk->esi = 0;
+    thread_stk->eip = (void (*)(thread_func*, void*))intr_exit;
+    pthread->self_kstack = (uint32_t*)thread_stk;
+}
+
+/* 在当前进程中创建用户线程，成功返回线程 id，失败返回 -1 */
+pid_t sys_thread_create(void* entry, void* func, void* arg) {
+    struct task_struct* cur_thread = thread_running();
+    struct task_struct* leader = cur_thread->group_leader;
+    ASSERT(cur_thread->pgdir != NULL);
+
+    struct task_struct* pthread = get_kernel_pages(1);
+    if(pthread == NULL) {
+        return -1;
+    }
+    /* 栈从共享的虚拟地址池中分配，映射在共享的页表中 */
+    uint32_t* ustack = malloc_page(MPF_USER, UTHREAD_STACK_PAGES);
+    if(ustack == NULL) {
+        mfree_page(MPF_KERNEL, pthread, 1);
+        return -1;
+    }
+
+    thread_attr_init(pthread, leader->name, leader->base_priority);
+    pthread->ppid = leader->pid;
+    pthread->pgdir = leader->pgdir;
+    pthread->group_leader = leader;
+    pthread->ustack = ustack;
+    leader->nr_threads++;
+
+    /* entry(func, arg) 的参数及假的返回地址，entry 不会返回 */
+    uint32_t* ustack_top = (uint32_t*)((uint32_t)ustack + UTHREAD_STACK_PAGES * PG_SIZE) - 3;
+    ustack_top[0] = 0;
+    ustack_top[1] = (uint32_t)func;
+    ustack_top[2] = (uint32_t)arg;
+    uthread_stk_build(pthread, entry, ustack_top);
+
+    thread_ready_new(pthread);
+    return pthread->pid;
+}
+
+/* 等待同一进程中的线程 tid 退出并回收，成功返回 0，失败返回 -1 */
+int32_t sys_thread_join(pid_t tid, void** retval) {
+    struct task_struct* cur_thread = thread_running();
+    struct task_struct* leader = cur_thread->group_leader;
+    struct task_struct* pthread = pid2thread(tid);
+    if(pthread == NULL || pthread == cur_thread || pthread == leader || pthread->group_leader != leader) {
+        return -1;
+    }
+
+    enum intr_status old_stat = spin_lock_intr(&uthread_lock);
+    if(pthread->joiner != NULL) {
+        /* 已有其他线程在等待 */
+        spin_unlock_intr(&uthread_lock, old_stat);
+        return -1;
+    }
+    pthread->joiner = cur_thread;
+    while(!pthread->exited) {
+        thread_block_timeout(&uthread_lock, 0);
+        spin_lock(&uthread_lock);
+    }
+    spin_unlock_intr(&uthread_lock, old_stat);
+
+    if(retval != NULL) {
+        *retval = pthread->exit_retval;
+    }
+    mfree_page(MPF_USER, pthread->ustack, UTHREAD_STACK_PAGES);
+    thread_reap(pthread);
+    leader->nr_threads--;
+    return 0;
+}
+
+/* 结束当前线程，返回值 retval 交给 join 者 */
+int32_t sys_thread_exit(void* retval) {
+    struct task_struct* cur_thread = thread_running();
+    if(cur_thread->group_leader == cur_thread) {
+        return -1;
+    }
+    cur_thread->exit_retval = retval;
+
+    intr_disable();
+    spin_lock(&uthread_lock);
+    cur_thread->exited = true;
+    if(cur_thread->joiner != NULL) {
+        thread_wakeup(cur_thread->joiner);
+    }
+    spin_unlock(&uthread_lock);
+    /* 换下处理器时释放大内核锁，此后不会再被调度，PCB 由 join 者释放 */
+    thread_block(TASK_DIED);
+    PANIC("sys_thread_exit: dead thread was scheduled\n");
+    return -1;
+}
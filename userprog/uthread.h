@@ -0,0 +1,20 @@
+#ifndef __USERPROG_UTHREAD_H
+#define __USERPROG_UTHREAD_H
+
+#include "thread.h"
+
+#define UTHREAD_STACK_PAGES 2 /* 用户线程 3 级栈的页数 */
+
+/* 
+ * 在当前进程中创建用户线程，与进程共享页表、虚拟地址池、堆及文件描述符表
+ * 新线程从用户态的 entry(func, arg) 开始执行，成功返回线程 id，失败返回 -1
+ */
+pid_t sys_thread_create(void* entry, void* func, void* arg);
+
+/* 等待同一进程中的线程 tid 退出并回收，retval 非 NULL 时存放其返回值，成功返回 0，失败返回 -1 */
+int32_t sys_thread_join(pid_t tid, void** retval);
+
+/* 结束当前线程，返回值 retval 交给 join 者，进程的初始线程不能调用 */
+int32_t sys_thread_exit(void* retval);
+
+#endif /* __USERPROG_UTHREAD_H */
@@ -0,0 +1,44 @@
+#include "vdso.h"
+#include "memory.h"
+#include "print.h"
+#include "debug.h"
+
+struct vdso_data* vdso_data = NULL;
+
+/* 分配全局数据页 */
+void vdso_init(void) {
+    put_str("vdso_init start\n");
+    vdso_data = get_kernel_pages(1);
+    ASSERT(vdso_data != NULL);
+    put_str("vdso_init done\n");
+}
+
+/* 在页目录 pgdir 中映射全局数据页及进程 pthread 的进程数据页，成功返回 true
+ * pgdir 还未加载，无法通过 page_table_map 映射，直接填写页表 */
+bool vdso_map(uint32_t* pgdir, struct task_struct* pthread) {
+    ASSERT((VDSO_DATA_VADDR >> 22) == (VDSO_PROC_VADDR >> 22));
+    /* 第一页为页表，第二页为进程数据页 */
+    uint32_t* pt = get_kernel_pages(2);
+    if(pt == NULL) {
+        return false;
+    }
+    struct vdso_proc* proc = (struct vdso_proc*)((uint32_t)pt + PG_SIZE);
+    pthread->vdso_pages = pt;
+    proc->pid = pthread->pid;
+    proc->ppid = pthread->ppid;
+
+    /* 页表本身可写，加载程序时会在其中继续映射 USER_VADDR_START 开始的页 */
+    pgdir[VDSO_DATA_VADDR >> 22] = addr_v2p((uint32_t)pt) | PG_US_U | PG_RW_W | PG_P_1;
+    pt[(VDSO_DATA_VADDR >> 12) & 0x3ff] = addr_v2p((uint32_t)vdso_data) | PG_US_U | PG_RW_R | PG_P_1;
+    pt[(VDSO_PROC_VADDR >> 12) & 0x3ff] = addr_v2p((uint32_t)proc) | PG_US_U | PG_RW_R | PG_P_1;
+    return true;
+}
+
+/* 取消当前进程 pthread 的 vdso 映射并释放页表及进程数据页，页表中的用户页须已释放 */
+void vdso_unmap(struct task_struct* pthread) {
+    ASSERT(pthread->vdso_pages != NULL);
+    *pde_ptr(VDSO_DATA_VADDR) = 0;
+    asm volatile("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax", "memory");
+    mfree_page(MPF_KERNEL, pthread->vdso_pages, 2);
+    pthread->vdso_pages = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef __USERPROG_VDSO_H
+#define __USERPROG_VDSO_H
+
+#include "global.h"
+#include "thread.h"
+
+/* 映射到每个用户进程的只读数据页，紧挨在程序加载地址 USER_VADDR_START 之前，不占用用户虚拟地址池 */
+#define VDSO_DATA_VADDR 0x8046000 /* 所有进程共享：时钟 */
+#define VDSO_PROC_VADDR 0x8047000 /* 每个进程一页：进程信息 */
+
+/* 全局数据，由内核维护 */
+struct vdso_data {
+    volatile uint32_t ticks; /* 开中断以来的时钟中断数 */
+    uint32_t hz; /* 时钟中断频率 */
+    uint32_t mtime_per_tick; /* 每个时钟中断的毫秒数 */
+    uint32_t pit_input_freq; /* PIT 输入时钟频率 */
+    uint32_t pit_counter0; /* PIT 计数器 0 的初值，每个时钟中断周期的 PIT 计数 */
+    uint32_t lapic_timer_count; /* 每个时钟中断周期 local apic 时钟的计数值，单处理器时为 0 */
+};
+
+/* 进程数据，同一进程的线程共享 */
+struct vdso_proc {
+    pid_t pid;
+    pid_t ppid;
+};
+
+/* 全局数据页在内核中的地址 */
+extern struct vdso_data* vdso_data;
+
+/* 分配全局数据页 */
+void vdso_init(void);
+
+/* 在页目录 pgdir 中映射全局数据页及进程 pthread 的进程数据页，成功返回 true */
+bool vdso_map(uint32_t* pgdir, struct task_struct* pthread);
+
+/* 取消当前进程 pthread 的 vdso 映射并释放页表及进程数据页，页表中的用户页须已释放 */
+void vdso_unmap(struct task_struct* pthread);
+
+#endif /* __USERPROG_VDSO_H */